@@ -0,0 +1,1034 @@
+#include <string_view>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <map>
+
+#ifdef FZ_WINDOWS
+#	include <windows.h>
+#else
+#	include <sys/resource.h>
+#endif
+
+#include <libfilezilla/socket.hpp>
+#include <libfilezilla/thread_pool.hpp>
+#include <libfilezilla/rate_limiter.hpp>
+#include <libfilezilla/recursive_remove.hpp>
+#include <libfilezilla/tls_layer.hpp>
+#include <libfilezilla/util.hpp>
+#include <libfilezilla/encode.hpp>
+
+#include "../../src/filezilla/ftp/server.hpp"
+#include "../../src/filezilla/authentication/file_based_authenticator.hpp"
+#include "../../src/filezilla/authentication/autobanner.hpp"
+#include "../../src/filezilla/tcp/binary_address_list.hpp"
+#include "../../src/filezilla/event_loop_pool.hpp"
+#include "../../src/filezilla/port_randomizer.hpp"
+#include "../../src/filezilla/securable_socket.hpp"
+#include "../../src/filezilla/logger/null.hpp"
+#include "../../src/filezilla/logger/stdio.hpp"
+#include "../../src/filezilla/util/filesystem.hpp"
+#include "../../src/filezilla/util/small_object_pool.hpp"
+
+/*
+Drives an in-process FTP server, listening on the loopback interface and serving a temporary directory,
+with a number of concurrent synthetic clients, each performing the operations of the chosen scenario
+over and over until the given time has elapsed. Then reports throughput, latencies, CPU time and allocations,
+either in human readable form or as a JSON object, which is meant to be compared across runs.
+
+Scenarios:
+	login  - each operation connects, logs in and quits.
+	mlsd   - each operation lists a directory with many entries.
+	small  - each operation either downloads or uploads a small file.
+	large  - each operation either downloads or uploads a large file.
+	mixed  - a random mix of the above, except login.
+
+The CPU time and the allocations are those of the whole process, hence they include the clients' too.
+*/
+
+namespace {
+
+[[noreturn]] void die(std::string_view msg) {
+	std::cerr << "Error: " << msg << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+std::atomic<std::uint64_t> allocations_counter{};
+
+}
+
+// Counting allocations is the whole point of replacing these.
+void *operator new(std::size_t size)
+{
+	allocations_counter.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+
+	std::abort();
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace {
+
+struct config
+{
+	std::string scenario = "small";
+	unsigned int clients = 16;
+	unsigned int client_threads = 4;
+	unsigned int server_threads = 0;
+	unsigned int seconds = 10;
+	unsigned int port = 21210;
+	bool tls = false;
+	bool json = false;
+	bool verbose = false;
+	bool keep = false;
+
+	std::size_t tree_entries = 2000;
+	std::size_t small_files = 100;
+	std::size_t small_size = 4*1024;
+	std::size_t large_size = 64*1024*1024;
+};
+
+enum op_kind: std::size_t {
+	login,
+	mlsd,
+	retr_small,
+	stor_small,
+	retr_large,
+	stor_large,
+	control,
+
+	num_op_kinds
+};
+
+constexpr std::string_view op_names[num_op_kinds] = {
+	"login", "mlsd", "retr_small", "stor_small", "retr_large", "stor_large", "control"
+};
+
+struct stats
+{
+	std::vector<std::uint32_t> latencies_us[num_op_kinds];
+	std::uint64_t operations{};
+	std::uint64_t errors{};
+	std::uint64_t bytes_down{};
+	std::uint64_t bytes_up{};
+
+	void merge(const stats &rhs)
+	{
+		for (std::size_t i = 0; i < num_op_kinds; ++i)
+			latencies_us[i].insert(latencies_us[i].end(), rhs.latencies_us[i].begin(), rhs.latencies_us[i].end());
+
+		operations += rhs.operations;
+		errors += rhs.errors;
+		bytes_down += rhs.bytes_down;
+		bytes_up += rhs.bytes_up;
+	}
+};
+
+double cpu_seconds()
+{
+#ifdef FZ_WINDOWS
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	auto to_100ns = [](const FILETIME &ft) {
+		return (std::uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	};
+
+	return double(to_100ns(kernel) + to_100ns(user)) / 1e7;
+#else
+	rusage ru{};
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+
+	auto to_seconds = [](const timeval &tv) {
+		return double(tv.tv_sec) + double(tv.tv_usec) / 1e6;
+	};
+
+	return to_seconds(ru.ru_utime) + to_seconds(ru.ru_stime);
+#endif
+}
+
+class client final: public fz::event_handler
+{
+	struct start_event_tag{};
+	using start_event = fz::simple_event<start_event_tag>;
+
+public:
+	client(fz::event_loop &loop, fz::thread_pool &pool, const config &cfg, std::atomic<bool> &stop, std::atomic<unsigned int> &running, unsigned int id)
+		: fz::event_handler(loop)
+		, pool_(pool)
+		, cfg_(cfg)
+		, stop_(stop)
+		, running_(running)
+		, id_(id)
+		, rng_(id)
+		, upload_chunk_(64*1024, 'x')
+	{
+		running_ += 1;
+		send_event<start_event>();
+	}
+
+	~client() override
+	{
+		remove_handler();
+	}
+
+	const stats &get_stats() const
+	{
+		return stats_;
+	}
+
+private:
+	using reply_handler = void (client::*)(int code, std::string_view text);
+
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::dispatch<
+			start_event,
+			fz::socket_event,
+			fz::certificate_verification_event
+		>(ev, this,
+			&client::connect,
+			&client::on_socket_event,
+			&client::on_certificate_verification_event
+		);
+	}
+
+	/*** Control connection ***/
+
+	void connect()
+	{
+		data_.reset();
+		control_.reset();
+
+		reply_buffer_.clear();
+		write_buffer_.clear();
+		multiline_code_ = 0;
+		logged_in_ = false;
+
+		op_start_ = fz::monotonic_clock::now();
+		expect(&client::on_welcome);
+
+		control_ = std::make_unique<fz::securable_socket>(event_loop_, this, std::make_unique<fz::socket>(pool_, this), fz::logger::null);
+		if (int error = control_->connect(fzT("127.0.0.1"), cfg_.port))
+			return fail(error);
+	}
+
+	void on_welcome(int code, std::string_view)
+	{
+		if (code != 220)
+			return fail(EPROTO);
+
+		if (cfg_.tls)
+			return command("AUTH TLS", &client::on_auth_tls);
+
+		command("USER bench", &client::on_user);
+	}
+
+	void on_auth_tls(int code, std::string_view)
+	{
+		if (code != 234)
+			return fail(EPROTO);
+
+		// The reply to the next command only comes once the handshake is over.
+		if (!control_->make_secure_client(fz::tls_ver::v1_2))
+			return fail(EPROTO);
+
+		command("PBSZ 0", &client::on_pbsz);
+	}
+
+	void on_pbsz(int code, std::string_view)
+	{
+		if (code != 200)
+			return fail(EPROTO);
+
+		command("PROT P", &client::on_prot);
+	}
+
+	void on_prot(int code, std::string_view)
+	{
+		if (code != 200)
+			return fail(EPROTO);
+
+		command("USER bench", &client::on_user);
+	}
+
+	void on_user(int code, std::string_view)
+	{
+		if (code == 230)
+			return on_pass(code, {});
+
+		if (code != 331)
+			return fail(EPROTO);
+
+		command("PASS bench", &client::on_pass);
+	}
+
+	void on_pass(int code, std::string_view)
+	{
+		if (code != 230)
+			return fail(EPROTO);
+
+		command("TYPE I", &client::on_type);
+	}
+
+	void on_type(int code, std::string_view)
+	{
+		if (code != 200)
+			return fail(EPROTO);
+
+		logged_in_ = true;
+
+		if (cfg_.scenario == "login")
+			return complete(login, true);
+
+		record(login);
+		next_operation();
+	}
+
+	void on_quit(int, std::string_view)
+	{
+		control_.reset();
+
+		if (stop_)
+			return finish();
+
+		connect();
+	}
+
+	void expect(reply_handler handler)
+	{
+		reply_handler_ = handler;
+	}
+
+	void command(std::string_view cmd, reply_handler handler)
+	{
+		command_start_ = fz::monotonic_clock::now();
+		expect(handler);
+
+		write_buffer_.append(cmd);
+		write_buffer_.append("\r\n");
+
+		flush_control();
+	}
+
+	void flush_control()
+	{
+		while (!write_buffer_.empty()) {
+			int error;
+			int written = control_->write(write_buffer_.data(), static_cast<unsigned int>(write_buffer_.size()), error);
+			if (written < 0) {
+				if (error != EAGAIN)
+					fail(error);
+
+				return;
+			}
+
+			write_buffer_.erase(0, std::size_t(written));
+		}
+	}
+
+	void read_control()
+	{
+		char buf[4096];
+
+		while (control_) {
+			int error;
+			int read = control_->read(buf, sizeof(buf), error);
+			if (read < 0) {
+				if (error != EAGAIN)
+					fail(error);
+
+				return;
+			}
+
+			if (read == 0)
+				return fail(ECONNRESET);
+
+			reply_buffer_.append(buf, std::size_t(read));
+			process_replies();
+		}
+	}
+
+	void process_replies()
+	{
+		std::size_t begin = 0;
+
+		for (auto end = reply_buffer_.find("\r\n"); end != std::string::npos; end = reply_buffer_.find("\r\n", begin)) {
+			std::string_view line(reply_buffer_.data() + begin, end - begin);
+			begin = end + 2;
+
+			if (line.size() < 4)
+				continue;
+
+			int code = fz::to_integral<int>(line.substr(0, 3));
+
+			if (multiline_code_) {
+				// Only the line starting with the same code followed by a space ends a multiline reply.
+				if (code != multiline_code_ || line[3] != ' ')
+					continue;
+
+				multiline_code_ = 0;
+			}
+			else
+			if (line[3] == '-') {
+				multiline_code_ = code;
+				continue;
+			}
+
+			// Preliminary replies are of no interest.
+			if (code < 200)
+				continue;
+
+			if (command_start_) {
+				record(control, command_start_);
+				command_start_ = {};
+			}
+
+			if (auto handler = reply_handler_) {
+				reply_handler_ = nullptr;
+				(this->*handler)(code, line.substr(4));
+			}
+
+			// The handler might have reset the connection.
+			if (!control_)
+				return;
+		}
+
+		reply_buffer_.erase(0, begin);
+	}
+
+	/*** Operations ***/
+
+	void next_operation()
+	{
+		if (stop_)
+			return command("QUIT", &client::on_quit);
+
+		auto kind = [&] {
+			if (cfg_.scenario == "mlsd")
+				return mlsd;
+
+			if (cfg_.scenario == "small")
+				return (stats_.operations % 2) ? stor_small : retr_small;
+
+			if (cfg_.scenario == "large")
+				return (stats_.operations % 2) ? stor_large : retr_large;
+
+			auto n = std::uniform_int_distribution<int>(0, 99)(rng_);
+			return n < 10 ? mlsd : n < 50 ? retr_small : n < 80 ? stor_small : n < 90 ? retr_large : stor_large;
+		}();
+
+		current_op_ = kind;
+		op_start_ = fz::monotonic_clock::now();
+
+		switch (kind) {
+			case mlsd:
+				data_command_ = "MLSD /tree";
+				break;
+
+			case retr_small:
+				data_command_ = fz::sprintf("RETR /small/%d", std::uniform_int_distribution<std::size_t>(0, cfg_.small_files-1)(rng_));
+				break;
+
+			case stor_small:
+				data_command_ = fz::sprintf("STOR /upload/%d-small-%d", id_, stats_.operations % 8);
+				to_upload_ = cfg_.small_size;
+				break;
+
+			case retr_large:
+				data_command_ = "RETR /large";
+				break;
+
+			case stor_large:
+				data_command_ = fz::sprintf("STOR /upload/%d-large", id_);
+				to_upload_ = cfg_.large_size;
+				break;
+
+			default:
+				break;
+		}
+
+		data_done_ = false;
+		reply_done_ = false;
+		op_failed_ = false;
+
+		command("EPSV", &client::on_epsv);
+	}
+
+	void on_epsv(int code, std::string_view text)
+	{
+		if (code != 229)
+			return fail_operation();
+
+		// 229 Entering Extended Passive Mode (|||port|)
+		auto pos = text.find("(|||");
+		if (pos == std::string_view::npos)
+			return fail_operation();
+
+		auto port = fz::to_integral<unsigned int>(text.substr(pos + 4, text.find('|', pos + 4) - pos - 4));
+		if (!port)
+			return fail_operation();
+
+		data_secured_ = false;
+
+		data_ = std::make_unique<fz::securable_socket>(event_loop_, this, std::make_unique<fz::socket>(pool_, this), fz::logger::null);
+		if (int error = data_->connect(fzT("127.0.0.1"), port))
+			return fail_operation(error);
+
+		command(data_command_, &client::on_data_command_reply);
+	}
+
+	void on_data_command_reply(int code, std::string_view)
+	{
+		reply_done_ = true;
+
+		if (code != 226)
+			op_failed_ = true;
+
+		if (op_failed_) {
+			data_.reset();
+			data_done_ = true;
+		}
+
+		maybe_complete_operation();
+	}
+
+	void on_data_connected()
+	{
+		if (cfg_.tls && !data_secured_) {
+			data_secured_ = true;
+
+			// Resume the TLS session of the control connection, as the server requires.
+			if (!data_->make_secure_client(fz::tls_ver::v1_2, nullptr, nullptr, control_.get()))
+				return fail_operation();
+
+			return;
+		}
+
+		if (current_op_ == stor_small || current_op_ == stor_large)
+			return write_data();
+
+		read_data();
+	}
+
+	void read_data()
+	{
+		static thread_local char buf[256*1024];
+
+		while (data_ && !data_done_) {
+			int error;
+			int read = data_->read(buf, sizeof(buf), error);
+			if (read < 0) {
+				if (error != EAGAIN)
+					fail_operation(error);
+
+				return;
+			}
+
+			if (read == 0) {
+				data_done_ = true;
+				data_.reset();
+				return maybe_complete_operation();
+			}
+
+			stats_.bytes_down += std::uint64_t(read);
+		}
+	}
+
+	void write_data()
+	{
+		while (data_ && !data_done_) {
+			if (to_upload_ == 0) {
+				int res = data_->shutdown();
+				if (res == EAGAIN)
+					return;
+
+				if (res)
+					return fail_operation(res);
+
+				data_done_ = true;
+				data_.reset();
+				return maybe_complete_operation();
+			}
+
+			int error;
+			auto amount = static_cast<unsigned int>(std::min(to_upload_, upload_chunk_.size()));
+			int written = data_->write(upload_chunk_.data(), amount, error);
+			if (written < 0) {
+				if (error != EAGAIN)
+					fail_operation(error);
+
+				return;
+			}
+
+			to_upload_ -= std::size_t(written);
+			stats_.bytes_up += std::uint64_t(written);
+		}
+	}
+
+	void fail_operation(int = 0)
+	{
+		op_failed_ = true;
+		data_.reset();
+		data_done_ = true;
+
+		// If the command has been sent, its reply is awaited anyway, otherwise there's nothing more to wait for.
+		if (!reply_handler_)
+			reply_done_ = true;
+
+		maybe_complete_operation();
+	}
+
+	void maybe_complete_operation()
+	{
+		if (data_done_ && reply_done_) {
+			reply_done_ = false;
+			complete(current_op_, !op_failed_);
+		}
+	}
+
+	void complete(op_kind kind, bool success)
+	{
+		stats_.operations += 1;
+
+		if (success)
+			record(kind);
+		else
+			stats_.errors += 1;
+
+		if (kind == login)
+			return command("QUIT", &client::on_quit);
+
+		next_operation();
+	}
+
+	void record(op_kind kind, fz::monotonic_clock start = {})
+	{
+		if (!start)
+			start = op_start_;
+
+		stats_.latencies_us[kind].push_back(std::uint32_t((fz::monotonic_clock::now() - start).get_microseconds()));
+	}
+
+	void fail(int)
+	{
+		stats_.errors += 1;
+
+		data_.reset();
+		control_.reset();
+		reply_handler_ = nullptr;
+
+		if (stop_)
+			return finish();
+
+		// Give the server a breath, in case it's refusing connections.
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		connect();
+	}
+
+	void finish()
+	{
+		if (finished_)
+			return;
+
+		finished_ = true;
+		data_.reset();
+		control_.reset();
+		running_ -= 1;
+	}
+
+	/*** Events ***/
+
+	void on_socket_event(fz::socket_event_source *source, fz::socket_event_flag type, int error)
+	{
+		bool is_control = control_ && source->root() == control_->root();
+		bool is_data = !is_control && data_ && source->root() == data_->root();
+
+		if (!is_control && !is_data)
+			return;
+
+		if (error) {
+			if (is_control)
+				return fail(error);
+
+			return fail_operation(error);
+		}
+
+		if (is_control) {
+			if (type == fz::socket_event_flag::read)
+				return read_control();
+
+			return flush_control();
+		}
+
+		if (type == fz::socket_event_flag::connection)
+			return on_data_connected();
+
+		if (type == fz::socket_event_flag::read)
+			return read_data();
+
+		if (type == fz::socket_event_flag::write && (current_op_ == stor_small || current_op_ == stor_large))
+			return write_data();
+	}
+
+	void on_certificate_verification_event(fz::tls_layer *layer, fz::tls_session_info &)
+	{
+		// The certificate is a self-signed one made up for the occasion.
+		layer->set_verification_result(true);
+	}
+
+	fz::thread_pool &pool_;
+	const config &cfg_;
+	std::atomic<bool> &stop_;
+	std::atomic<unsigned int> &running_;
+	unsigned int id_;
+	std::mt19937 rng_;
+
+	std::unique_ptr<fz::securable_socket> control_;
+	std::unique_ptr<fz::securable_socket> data_;
+
+	std::string reply_buffer_;
+	std::string write_buffer_;
+	int multiline_code_{};
+	reply_handler reply_handler_{};
+	bool logged_in_{};
+	bool finished_{};
+
+	op_kind current_op_{};
+	std::string data_command_;
+	std::size_t to_upload_{};
+	bool data_secured_{};
+	bool data_done_{};
+	bool reply_done_{};
+	bool op_failed_{};
+
+	std::string upload_chunk_;
+
+	fz::monotonic_clock op_start_{};
+	fz::monotonic_clock command_start_{};
+
+	stats stats_;
+};
+
+void parse_args(config &cfg, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string_view a = argv[i];
+
+		auto value = [&](std::string_view name) -> std::optional<std::string_view> {
+			if (a.substr(0, name.size()) == name && a.size() > name.size() && a[name.size()] == '=')
+				return a.substr(name.size() + 1);
+
+			return std::nullopt;
+		};
+
+		auto number = [&](std::string_view name, auto &out) {
+			if (auto v = value(name)) {
+				out = fz::to_integral<std::decay_t<decltype(out)>>(*v);
+				if (!out)
+					die(fz::sprintf("invalid value for %s", name));
+
+				return true;
+			}
+
+			return false;
+		};
+
+		if (auto v = value("--scenario")) {
+			cfg.scenario = std::string(*v);
+			if (cfg.scenario != "login" && cfg.scenario != "mlsd" && cfg.scenario != "small" && cfg.scenario != "large" && cfg.scenario != "mixed")
+				die("unknown scenario");
+		}
+		else
+		if (number("--clients", cfg.clients) ||
+			number("--client-threads", cfg.client_threads) ||
+			number("--server-threads", cfg.server_threads) ||
+			number("--seconds", cfg.seconds) ||
+			number("--port", cfg.port) ||
+			number("--tree-entries", cfg.tree_entries) ||
+			number("--small-files", cfg.small_files) ||
+			number("--small-size", cfg.small_size) ||
+			number("--large-size", cfg.large_size))
+		{}
+		else
+		if (a == "--tls")
+			cfg.tls = true;
+		else
+		if (a == "--json")
+			cfg.json = true;
+		else
+		if (a == "--verbose")
+			cfg.verbose = true;
+		else
+		if (a == "--keep")
+			cfg.keep = true;
+		else {
+			std::cerr <<
+				"Usage: " << argv[0] << " [options]\n"
+				"  --scenario=login|mlsd|small|large|mixed  (default: small)\n"
+				"  --clients=N          number of concurrent clients (default: 16)\n"
+				"  --client-threads=N   number of event loops running the clients (default: 4)\n"
+				"  --server-threads=N   number of event loops running the sessions (default: as many as the CPUs)\n"
+				"  --seconds=N          duration of the run (default: 10)\n"
+				"  --port=N             loopback port to listen on (default: 21210)\n"
+				"  --tls                use explicit FTP over TLS, with protected data connections\n"
+				"  --tree-entries=N     entries in the directory listed by MLSD (default: 2000)\n"
+				"  --small-files=N      number of small files (default: 100)\n"
+				"  --small-size=N       size of the small files (default: 4096)\n"
+				"  --large-size=N       size of the large file (default: 67108864)\n"
+				"  --json               output the results as a JSON object\n"
+				"  --verbose            log the server's errors to stderr\n"
+				"  --keep               don't remove the temporary directory\n";
+			exit(a == "--help" ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+}
+
+void write_file(const fz::util::fs::native_path &path, std::size_t size)
+{
+	auto f = path.open(fz::file::writing, fz::file::empty);
+	if (!f)
+		die(fz::sprintf("couldn't create %s", fz::to_utf8(path.str())));
+
+	std::string chunk(std::min<std::size_t>(size, 1024*1024), 'y');
+
+	while (size > 0) {
+		auto amount = std::min(size, chunk.size());
+		if (f.write(chunk.data(), std::int64_t(amount)) != std::int64_t(amount))
+			die(fz::sprintf("couldn't write %s", fz::to_utf8(path.str())));
+
+		size -= amount;
+	}
+}
+
+fz::util::fs::native_path make_tree(const config &cfg)
+{
+	fz::native_string base;
+
+#ifdef FZ_WINDOWS
+	if (auto tmp = _wgetenv(L"TEMP"))
+		base = tmp;
+#else
+	if (auto tmp = std::getenv("TMPDIR"))
+		base = tmp;
+	else
+		base = "/tmp";
+#endif
+
+	auto root = fz::util::fs::native_path(base) / fz::to_native(fz::sprintf("fz-ftp-benchmark-%s", fz::hex_encode<std::string>(fz::random_bytes(8))));
+
+	for (auto dir: { fzT(""), fzT("tree"), fzT("small"), fzT("upload"), fzT("certs") }) {
+		if (!(root / dir).mkdir(true))
+			die("couldn't create the temporary directory");
+	}
+
+	for (std::size_t i = 0; i < cfg.tree_entries; ++i)
+		write_file(root / fzT("tree") / fz::to_native(fz::sprintf("entry-%d", i)), 0);
+
+	for (std::size_t i = 0; i < cfg.small_files; ++i)
+		write_file(root / fzT("small") / fz::to_native(fz::sprintf("%d", i)), cfg.small_size);
+
+	write_file(root / fzT("large"), cfg.large_size);
+
+	return root;
+}
+
+std::uint32_t percentile(const std::vector<std::uint32_t> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+
+	return sorted[std::min(sorted.size() - 1, std::size_t(p * double(sorted.size())))];
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	parse_args(cfg, argc, argv);
+
+	auto root = make_tree(cfg);
+
+	fz::logger::stdio stderr_logger(stderr, fz::logmsg::error);
+	fz::logger_interface &logger = cfg.verbose ? static_cast<fz::logger_interface &>(stderr_logger) : fz::logger::null;
+
+	fz::thread_pool pool;
+	fz::event_loop server_loop;
+	fz::event_loop_pool loop_pool(server_loop, pool, cfg.server_threads);
+	fz::rate_limit_manager rate_limit_manager(server_loop);
+	fz::port_manager port_manager;
+	fz::tcp::binary_address_list disallowed_ips, allowed_ips;
+	fz::authentication::autobanner autobanner(server_loop);
+	fz::tcp::server_context context(pool, server_loop);
+
+	fz::authentication::file_based_authenticator::users users;
+	auto &user = users["bench"];
+	user.mount_table.push_back({"/", root.str()});
+	user.credentials.password = fz::authentication::password::with_impersonation(fz::authentication::password::default_password("bench"));
+
+	fz::authentication::file_based_authenticator authenticator(
+		pool, server_loop, logger, rate_limit_manager,
+		root / fzT("groups.xml"), {},
+		root / fzT("users.xml"), std::move(users)
+	);
+
+	fz::ftp::server::options opts;
+	opts.listeners_info().push_back({{"127.0.0.1", cfg.port}, cfg.tls ? fz::ftp::session::tls_mode::require_tls : fz::ftp::session::tls_mode::allow_tls});
+
+	if (cfg.tls) {
+		opts.sessions().tls.cert = fz::securable_socket::cert_info::generate_selfsigned(root / fzT("certs"), &logger);
+		if (!opts.sessions().tls.cert)
+			die("couldn't generate the TLS certificate");
+	}
+
+	fz::ftp::server server(
+		context, loop_pool, logger, logger,
+		authenticator,
+		rate_limit_manager,
+		disallowed_ips, allowed_ips,
+		autobanner,
+		port_manager,
+		opts
+	);
+
+	server.start();
+
+	// Let the listener come up.
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	std::vector<std::unique_ptr<fz::event_loop>> client_loops;
+	for (unsigned int i = 0; i < std::max(cfg.client_threads, 1u); ++i)
+		client_loops.push_back(std::make_unique<fz::event_loop>());
+
+	std::atomic<bool> stop{};
+	std::atomic<unsigned int> running{};
+
+	auto cpu_start = cpu_seconds();
+	auto allocations_start = allocations_counter.load();
+	auto pooled_start = fz::util::small_object_pool::get_stats();
+	auto start = fz::monotonic_clock::now();
+
+	std::vector<std::unique_ptr<client>> clients;
+	for (unsigned int i = 0; i < cfg.clients; ++i)
+		clients.push_back(std::make_unique<client>(*client_loops[i % client_loops.size()], pool, cfg, stop, running, i));
+
+	std::this_thread::sleep_for(std::chrono::seconds(cfg.seconds));
+	stop = true;
+
+	// Let the operations in progress complete.
+	for (int i = 0; i < 600 && running > 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	auto elapsed = double((fz::monotonic_clock::now() - start).get_milliseconds()) / 1000;
+	auto cpu = cpu_seconds() - cpu_start;
+	auto allocations = allocations_counter.load() - allocations_start;
+
+	std::uint64_t pooled_allocations = 0;
+	for (auto &s: fz::util::small_object_pool::get_stats())
+		pooled_allocations += s.allocations;
+	for (auto &s: pooled_start)
+		pooled_allocations -= s.allocations;
+
+	if (running > 0)
+		std::cerr << "Warning: " << running << " clients didn't complete their last operation in time." << std::endl;
+
+	// Clients still mid-operation keep updating their stats from their loops, so stop them before looking.
+	stats total;
+	for (auto &c: clients) {
+		c->remove_handler();
+		total.merge(c->get_stats());
+	}
+
+	clients.clear();
+	client_loops.clear();
+
+	server.stop();
+
+	for (auto &l: total.latencies_us)
+		std::sort(l.begin(), l.end());
+
+	auto bytes = total.bytes_down + total.bytes_up;
+	auto gb = double(bytes) / (1024.0*1024.0*1024.0);
+	auto ops = std::max<std::uint64_t>(total.operations, 1);
+
+	if (cfg.json) {
+		std::cout << "{"
+			<< "\"scenario\":\"" << cfg.scenario << "\","
+			<< "\"tls\":" << (cfg.tls ? "true" : "false") << ","
+			<< "\"clients\":" << cfg.clients << ","
+			<< "\"seconds\":" << elapsed << ","
+			<< "\"operations\":" << total.operations << ","
+			<< "\"errors\":" << total.errors << ","
+			<< "\"operations_per_second\":" << double(total.operations) / elapsed << ","
+			<< "\"bytes_down\":" << total.bytes_down << ","
+			<< "\"bytes_up\":" << total.bytes_up << ","
+			<< "\"megabytes_per_second\":" << double(bytes) / (1024.0*1024.0) / elapsed << ","
+			<< "\"cpu_seconds\":" << cpu << ","
+			<< "\"cpu_seconds_per_gigabyte\":" << (gb > 0 ? cpu / gb : 0) << ","
+			<< "\"allocations\":" << allocations << ","
+			<< "\"allocations_per_operation\":" << double(allocations) / double(ops) << ","
+			<< "\"pooled_allocations_per_operation\":" << double(pooled_allocations) / double(ops) << ","
+			<< "\"latency_us\":{";
+
+		bool first = true;
+		for (std::size_t i = 0; i < num_op_kinds; ++i) {
+			auto &l = total.latencies_us[i];
+			if (l.empty())
+				continue;
+
+			std::cout << (first ? "" : ",") << "\"" << op_names[i] << "\":{"
+				<< "\"count\":" << l.size() << ","
+				<< "\"p50\":" << percentile(l, 0.50) << ","
+				<< "\"p99\":" << percentile(l, 0.99) << ","
+				<< "\"p999\":" << percentile(l, 0.999) << ","
+				<< "\"max\":" << l.back() << "}";
+
+			first = false;
+		}
+
+		std::cout << "}}" << std::endl;
+	}
+	else {
+		std::cout
+			<< "Scenario:            " << cfg.scenario << (cfg.tls ? " (TLS)" : "") << ", " << cfg.clients << " clients, " << elapsed << " s\n"
+			<< "Operations:          " << total.operations << " (" << total.errors << " errors), " << double(total.operations) / elapsed << " per second\n"
+			<< "Throughput:          " << double(bytes) / (1024.0*1024.0) / elapsed << " MiB/s (" << total.bytes_down << " bytes down, " << total.bytes_up << " up)\n"
+			<< "CPU:                 " << cpu << " s" << (gb > 0 ? fz::sprintf(", %f s per GiB", cpu / gb) : std::string()) << "\n"
+			<< "Allocations:         " << double(allocations) / double(ops) << " per operation, plus " << double(pooled_allocations) / double(ops) << " pooled ones\n"
+			<< "Latencies (us):      count / p50 / p99 / p999 / max\n";
+
+		for (std::size_t i = 0; i < num_op_kinds; ++i) {
+			auto &l = total.latencies_us[i];
+			if (l.empty())
+				continue;
+
+			std::cout << "  " << op_names[i] << std::string(19 - op_names[i].size(), ' ')
+				<< l.size() << " / " << percentile(l, 0.50) << " / " << percentile(l, 0.99) << " / " << percentile(l, 0.999) << " / " << l.back() << "\n";
+		}
+
+		std::cout << std::flush;
+	}
+
+	if (!cfg.keep)
+		fz::recursive_remove().remove(root.str());
+
+	return total.errors && !total.operations ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,582 @@
+#include <string_view>
+#include <iostream>
+#include <functional>
+#include <vector>
+#include <random>
+#include <regex>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+
+#include <libfilezilla/buffer.hpp>
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/socket.hpp>
+
+#include "../../src/filezilla/tcp/binary_address_list.hpp"
+#include "../../src/filezilla/hostaddress.hpp"
+#include "../../src/filezilla/tvfs/canonicalized_path_elements.hpp"
+#include "../../src/filezilla/tvfs/mount.hpp"
+#include "../../src/filezilla/buffer_operator/line_consumer.hpp"
+#include "../../src/filezilla/ftp/ascii_layer.hpp"
+#include "../../src/filezilla/util/buffer_streamer.hpp"
+#include "../../src/filezilla/serialization/archives/binary.hpp"
+#include "../../src/filezilla/serialization/archives/xml.hpp"
+#include "../../src/filezilla/authentication/file_based_authenticator.hpp"
+
+/*
+Microbenchmarks for the primitives that dominate the server's profiles.
+
+Each benchmark is a function taking a state, whose keep_running() loop is the part being timed,
+much like with Google Benchmark, which the tree doesn't depend upon. The number of iterations
+is calibrated so that each benchmark runs for about --min-time seconds.
+
+Usage: microbenchmarks [--filter=<regex>] [--min-time=<seconds>] [--json]
+*/
+
+namespace {
+
+template <typename T>
+void do_not_optimize(T &&v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(v) : "memory");
+#else
+	static volatile const void *sink;
+	sink = &v;
+#endif
+}
+
+class state
+{
+public:
+	state(std::int64_t arg, std::uint64_t iterations)
+		: arg_(arg)
+		, iterations_(iterations)
+	{}
+
+	//! Drives the timed loop: while (s.keep_running()) { ... }
+	bool keep_running()
+	{
+		if (done_ == 0)
+			start_ = std::chrono::steady_clock::now();
+
+		if (done_ == iterations_) {
+			elapsed_ = std::chrono::steady_clock::now() - start_ - excluded_;
+			return false;
+		}
+
+		done_ += 1;
+		return true;
+	}
+
+	std::int64_t arg() const { return arg_; }
+	std::uint64_t iterations() const { return iterations_; }
+
+	//! Excludes from the timing whatever happens between pause() and resume().
+	void pause() { paused_at_ = std::chrono::steady_clock::now(); }
+	void resume() { excluded_ += std::chrono::steady_clock::now() - paused_at_; }
+
+	void set_items_processed(std::uint64_t n) { items_ = n; }
+	void set_bytes_processed(std::uint64_t n) { bytes_ = n; }
+
+	double seconds() const { return std::chrono::duration<double>(elapsed_).count(); }
+	std::uint64_t items() const { return items_; }
+	std::uint64_t bytes() const { return bytes_; }
+
+private:
+	std::int64_t arg_;
+	std::uint64_t iterations_;
+	std::uint64_t done_{};
+
+	std::chrono::steady_clock::time_point start_{};
+	std::chrono::steady_clock::time_point paused_at_{};
+	std::chrono::steady_clock::duration excluded_{};
+	std::chrono::steady_clock::duration elapsed_{};
+
+	std::uint64_t items_{};
+	std::uint64_t bytes_{};
+};
+
+struct benchmark
+{
+	std::string name;
+	std::function<void(state &)> function;
+	std::vector<std::int64_t> args;
+};
+
+std::vector<benchmark> &registry()
+{
+	static std::vector<benchmark> benchmarks;
+	return benchmarks;
+}
+
+struct registrar
+{
+	registrar(std::string name, std::function<void(state &)> function, std::vector<std::int64_t> args = {})
+	{
+		registry().push_back({std::move(name), std::move(function), std::move(args)});
+	}
+};
+
+/*** binary_address_list ***/
+
+std::string ipv4_range(std::uint32_t i)
+{
+	// Disjoint ranges of two addresses, so that they don't get merged.
+	std::uint32_t ip = 0x0A000000 + i*4;
+
+	auto to_str = [](std::uint32_t ip) {
+		return fz::sprintf("%d.%d.%d.%d", ip >> 24, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+	};
+
+	return to_str(ip) + "-" + to_str(ip + 1);
+}
+
+const registrar address_list_add("binary_address_list::add", [](state &s) {
+	std::vector<std::string> ranges;
+	for (std::int64_t i = 0; i < s.arg(); ++i)
+		ranges.push_back(ipv4_range(std::uint32_t(i)));
+
+	std::shuffle(ranges.begin(), ranges.end(), std::mt19937(0));
+
+	while (s.keep_running()) {
+		fz::tcp::binary_address_list list;
+
+		for (auto &r: ranges)
+			list.add(r, fz::address_type::ipv4);
+
+		do_not_optimize(list);
+	}
+
+	s.set_items_processed(s.iterations() * std::uint64_t(s.arg()));
+}, {1000, 10000, 100000, 1000000});
+
+const registrar address_list_contains("binary_address_list::contains", [](state &s) {
+	fz::tcp::binary_address_list list;
+	for (std::int64_t i = 0; i < s.arg(); ++i)
+		list.add(ipv4_range(std::uint32_t(i)), fz::address_type::ipv4);
+
+	// Half of them are in the list, half of them aren't.
+	std::vector<std::string> addresses;
+	std::mt19937 rng(0);
+	for (int i = 0; i < 1024; ++i) {
+		std::uint32_t ip = 0x0A000000 + std::uniform_int_distribution<std::uint32_t>(0, std::uint32_t(s.arg()*4))(rng);
+		addresses.push_back(fz::sprintf("%d.%d.%d.%d", ip >> 24, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF));
+	}
+
+	std::size_t i = 0;
+	while (s.keep_running())
+		do_not_optimize(list.contains(addresses[i++ & 1023], fz::address_type::ipv4));
+
+	s.set_items_processed(s.iterations());
+}, {1000, 10000, 100000, 1000000});
+
+/*** hostaddress ***/
+
+const registrar hostaddress_parse_ipv4("hostaddress::parse/ipv4", [](state &s) {
+	std::string_view addresses[] = { "127.0.0.1", "192.168.100.200", "10.0.0.254", "255.255.255.255" };
+
+	std::size_t i = 0;
+	while (s.keep_running())
+		do_not_optimize(fz::hostaddress(addresses[i++ & 3], fz::hostaddress::format::ipvx));
+
+	s.set_items_processed(s.iterations());
+});
+
+const registrar hostaddress_parse_ipv6("hostaddress::parse/ipv6", [](state &s) {
+	std::string_view addresses[] = { "::1", "fe80::1ff:fe23:4567:890a", "2001:db8:85a3:8d3:1319:8a2e:370:7348", "::ffff:192.168.1.1" };
+
+	std::size_t i = 0;
+	while (s.keep_running())
+		do_not_optimize(fz::hostaddress(addresses[i++ & 3], fz::hostaddress::format::ipvx));
+
+	s.set_items_processed(s.iterations());
+});
+
+/*** tvfs ***/
+
+const registrar canonicalized_path_elements("tvfs::canonicalized_path_elements", [](state &s) {
+	std::string_view paths[] = {
+		"/",
+		"/home/user/documents/report.pdf",
+		"/a/./b/../c//d/e/../../f/g.txt",
+		"relative/path/with/quite/a/number/of/elements/in/it.tar.gz"
+	};
+
+	std::size_t i = 0;
+	while (s.keep_running())
+		do_not_optimize(fz::tvfs::canonicalized_path_elements(paths[i++ & 3]));
+
+	s.set_items_processed(s.iterations());
+});
+
+// engine::resolve_path() is private: the mount tree lookup it boils down to is measured instead.
+const registrar mount_tree_find_node("tvfs::mount_tree::find_node", [](state &s) {
+	fz::tvfs::mount_table mt;
+	for (std::int64_t i = 0; i < s.arg(); ++i)
+		mt.push_back({fz::sprintf("/dir%d/sub%d", i / 16, i % 16), fz::to_native(fz::sprintf("/srv/ftp/%d", i))});
+
+	fz::tvfs::mount_tree tree(mt);
+
+	std::vector<std::string> paths;
+	std::mt19937 rng(0);
+	for (int i = 0; i < 256; ++i) {
+		auto n = std::uniform_int_distribution<std::int64_t>(0, s.arg()-1)(rng);
+		paths.push_back(fz::sprintf("/dir%d/sub%d/some/file/below/the/mount/point-%d.bin", n / 16, n % 16, i));
+	}
+
+	std::size_t i = 0;
+	while (s.keep_running()) {
+		fz::tvfs::canonicalized_path_elements elements(paths[i++ & 255]);
+		do_not_optimize(tree.find_node(elements));
+	}
+
+	s.set_items_processed(s.iterations());
+}, {16, 256, 4096});
+
+/*** line_consumer ***/
+
+class command_line_consumer: public fz::buffer_operator::line_consumer<fz::buffer_line_eol::cr_lf>
+{
+public:
+	using line_consumer::line_consumer;
+	using line_consumer::consume_buffer;
+
+	std::size_t lines{};
+
+private:
+	int process_buffer_line(buffer_string_view line, bool) override
+	{
+		do_not_optimize(line);
+		lines += 1;
+		return 0;
+	}
+};
+
+const registrar line_consumer_commands("buffer_operator::line_consumer/commands", [](state &s) {
+	std::string_view commands[] = {
+		"USER someone\r\n", "PASS a rather long password\r\n", "TYPE I\r\n", "EPSV\r\n",
+		"RETR /some/directory/and/a/file.bin\r\n", "MLSD /some/directory\r\n", "NOOP\r\n", "CWD ..\r\n"
+	};
+
+	fz::buffer_operator::unsafe_locking_buffer buffer;
+
+	command_line_consumer consumer(4096);
+	consumer.set_buffer(&buffer);
+
+	std::uint64_t bytes = 0;
+
+	while (s.keep_running()) {
+		s.pause();
+		{
+			auto b = buffer.lock();
+			for (int i = 0; i < 128; ++i) {
+				auto &c = commands[i & 7];
+				b->append(c);
+				bytes += c.size();
+			}
+		}
+		s.resume();
+
+		while (consumer.consume_buffer() == 0);
+	}
+
+	s.set_items_processed(consumer.lines);
+	s.set_bytes_processed(bytes);
+});
+
+/*** ascii_layer ***/
+
+// Produces endlessly the same text on read, swallows everything on write.
+class memory_socket: public fz::socket_interface
+{
+public:
+	memory_socket(std::string text)
+		: fz::socket_interface(this)
+		, text_(std::move(text))
+	{}
+
+	int read(void *buffer, unsigned int size, int &) override
+	{
+		auto amount = std::min<std::size_t>(size, text_.size() - pos_);
+		std::memcpy(buffer, text_.data() + pos_, amount);
+		pos_ = (pos_ + amount) % text_.size();
+		return int(amount);
+	}
+
+	int write(const void *buffer, unsigned int size, int &) override
+	{
+		do_not_optimize(buffer);
+		return int(size);
+	}
+
+	void set_event_handler(fz::event_handler *, fz::socket_event_flag = {}) override {}
+	fz::native_string peer_host() const override { return {}; }
+	int peer_port(int &error) const override { error = ENOTCONN; return -1; }
+	int connect(const fz::native_string &, unsigned int, fz::address_type = fz::address_type::unknown) override { return EINVAL; }
+	fz::socket_state get_state() const override { return fz::socket_state::connected; }
+	int shutdown() override { return 0; }
+	int shutdown_read() override { return 0; }
+	int set_buffer_sizes(int, int) override { return 0; }
+
+private:
+	std::string text_;
+	std::size_t pos_{};
+};
+
+std::string make_text(std::string_view eol)
+{
+	std::string text;
+
+	for (int i = 0; text.size() < 1024*1024; ++i) {
+		text.append(std::size_t(20 + i % 60), char('a' + i % 26));
+		text.append(eol);
+	}
+
+	return text;
+}
+
+const registrar ascii_layer_read("ftp::ascii_layer::read", [](state &s) {
+	memory_socket socket(make_text("\r\n"));
+	fz::ftp::ascii_layer layer(nullptr, socket);
+
+	std::vector<char> buf(std::size_t(s.arg()));
+	std::uint64_t bytes = 0;
+
+	while (s.keep_running()) {
+		int error;
+		int read = layer.read(buf.data(), unsigned(buf.size()), error);
+		do_not_optimize(buf.data());
+		bytes += std::uint64_t(std::max(read, 0));
+	}
+
+	s.set_bytes_processed(bytes);
+}, {4096, 65536});
+
+const registrar ascii_layer_write("ftp::ascii_layer::write", [](state &s) {
+	memory_socket socket({});
+	fz::ftp::ascii_layer layer(nullptr, socket);
+
+	auto text = make_text("\n");
+	std::size_t pos = 0;
+	std::uint64_t bytes = 0;
+
+	while (s.keep_running()) {
+		auto amount = std::min(std::size_t(s.arg()), text.size() - pos);
+
+		int error;
+		int written = layer.write(text.data() + pos, unsigned(amount), error);
+		bytes += std::uint64_t(std::max(written, 0));
+
+		pos = (pos + amount) % text.size();
+	}
+
+	s.set_bytes_processed(bytes);
+}, {4096, 65536});
+
+/*** buffer_streamer ***/
+
+const registrar buffer_streamer_integers("util::buffer_streamer/integers", [](state &s) {
+	fz::buffer buffer;
+	std::uint64_t value = 1;
+
+	while (s.keep_running()) {
+		{
+			fz::util::buffer_streamer bs(buffer);
+			bs << value << ' ' << fz::util::buffer_streamer::dec(std::uint32_t(value), 10, '0') << '\n';
+		}
+
+		value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+
+		if (buffer.size() > 1024*1024)
+			buffer.clear();
+	}
+
+	s.set_items_processed(s.iterations() * 2);
+});
+
+/*** serialization ***/
+
+fz::authentication::file_based_authenticator::users make_users(std::int64_t n)
+{
+	fz::authentication::file_based_authenticator::users users;
+
+	for (std::int64_t i = 0; i < n; ++i) {
+		auto &u = users[fz::sprintf("user%d", i)];
+		u.description = fz::sprintf("User number %d", i);
+		u.groups = { "group1", "group2" };
+		u.mount_table.push_back({"/", fz::to_native(fz::sprintf("/srv/ftp/user%d", i))});
+		u.mount_table.push_back({"/shared", fzT("/srv/ftp/shared"), fz::tvfs::mount_point::read_only});
+	}
+
+	return users;
+}
+
+const registrar serialization_binary("serialization::binary_archive/users", [](state &s) {
+	auto users = make_users(s.arg());
+	std::uint64_t bytes = 0;
+
+	while (s.keep_running()) {
+		fz::buffer buffer;
+
+		if (fz::serialization::binary_output_archive{buffer}(users).error())
+			std::abort();
+
+		bytes += buffer.size();
+
+		decltype(users) loaded;
+		if (fz::serialization::binary_input_archive{buffer}(loaded).error())
+			std::abort();
+
+		do_not_optimize(loaded);
+	}
+
+	s.set_items_processed(s.iterations() * std::uint64_t(s.arg()));
+	s.set_bytes_processed(bytes);
+}, {10, 1000});
+
+const registrar serialization_xml("serialization::xml_archive/users", [](state &s) {
+	using namespace fz::serialization;
+
+	auto users = make_users(s.arg());
+	std::uint64_t bytes = 0;
+
+	while (s.keep_running()) {
+		fz::buffer buffer;
+
+		{
+			xml_output_archive::buffer_saver saver(buffer);
+			if (xml_output_archive{saver}(nvp{users, "users"}).error())
+				std::abort();
+		}
+
+		bytes += buffer.size();
+
+		decltype(users) loaded;
+		xml_input_archive::buffer_loader loader(buffer, true);
+		if (xml_input_archive{loader}(nvp{loaded, "users"}).error())
+			std::abort();
+
+		do_not_optimize(loaded);
+	}
+
+	s.set_items_processed(s.iterations() * std::uint64_t(s.arg()));
+	s.set_bytes_processed(bytes);
+}, {10, 1000});
+
+/*** password ***/
+
+const registrar password_verify("authentication::password::verify", [](state &s) {
+	fz::authentication::password::default_password password("a password");
+
+	while (s.keep_running())
+		do_not_optimize(password.verify("a password"));
+
+	s.set_items_processed(s.iterations());
+});
+
+/*** Runner ***/
+
+struct result
+{
+	std::string name;
+	std::uint64_t iterations;
+	double seconds;
+	std::uint64_t items;
+	std::uint64_t bytes;
+};
+
+result run(const benchmark &b, std::optional<std::int64_t> arg, double min_time)
+{
+	std::uint64_t iterations = 1;
+
+	for (;;) {
+		state s(arg.value_or(0), iterations);
+		b.function(s);
+
+		// Good enough, or hopeless to go any further.
+		if (s.seconds() >= min_time || iterations >= (std::uint64_t(1) << 40))
+			return { arg ? fz::sprintf("%s/%d", b.name, *arg) : b.name, iterations, s.seconds(), s.items(), s.bytes() };
+
+		// Aim a bit past the minimum time, so that the next run is most likely the last one.
+		auto factor = s.seconds() > 0 ? min_time * 1.4 / s.seconds() : 100;
+		iterations = std::max(iterations + 1, std::uint64_t(double(iterations) * std::min(factor, 100.0)));
+	}
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	std::regex filter(".*");
+	double min_time = 0.5;
+	bool json = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string_view a = argv[i];
+
+		if (a.substr(0, 9) == "--filter=")
+			filter = std::regex(std::string(a.substr(9)));
+		else
+		if (a.substr(0, 11) == "--min-time=")
+			min_time = std::atof(argv[i] + 11);
+		else
+		if (a == "--json")
+			json = true;
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--filter=<regex>] [--min-time=<seconds>] [--json]" << std::endl;
+			return a == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	std::vector<result> results;
+
+	auto report = [&](const result &r) {
+		auto ns_per_op = r.seconds * 1e9 / double(r.iterations);
+
+		if (json) {
+			std::cout << (results.empty() ? "[\n" : ",\n")
+				<< "  {\"name\":\"" << r.name << "\",\"iterations\":" << r.iterations
+				<< ",\"ns_per_iteration\":" << ns_per_op
+				<< ",\"items_per_second\":" << (r.items ? double(r.items) / r.seconds : 0)
+				<< ",\"bytes_per_second\":" << (r.bytes ? double(r.bytes) / r.seconds : 0)
+				<< "}";
+		}
+		else {
+			std::cout << fz::sprintf("%-52s %14.1f ns %12d", r.name, ns_per_op, r.iterations);
+
+			if (r.items)
+				std::cout << fz::sprintf("  %10.3f M items/s", double(r.items) / r.seconds / 1e6);
+
+			if (r.bytes)
+				std::cout << fz::sprintf("  %10.1f MiB/s", double(r.bytes) / r.seconds / (1024*1024));
+
+			std::cout << std::endl;
+		}
+
+		results.push_back(r);
+	};
+
+	if (!json)
+		std::cout << fz::sprintf("%-52s %17s %12s\n", "Benchmark", "Time", "Iterations");
+
+	for (auto &b: registry()) {
+		if (b.args.empty()) {
+			if (std::regex_search(b.name, filter))
+				report(run(b, std::nullopt, min_time));
+
+			continue;
+		}
+
+		for (auto arg: b.args) {
+			if (std::regex_search(fz::sprintf("%s/%d", b.name, arg), filter))
+				report(run(b, arg, min_time));
+		}
+	}
+
+	if (json)
+		std::cout << (results.empty() ? "[]" : "\n]") << std::endl;
+
+	return EXIT_SUCCESS;
+}
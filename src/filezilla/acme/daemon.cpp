@@ -215,6 +215,8 @@ void daemon::on_certificate(acme::client::opid_t id, fz::uri &, std::string &kid
 		return;
 	}
 
+	securable_socket::credentials::reload_all();
+
 	if (ch)
 		ch(std::move(ci));
 
@@ -0,0 +1,156 @@
+#include <algorithm>
+
+#include "adaptive_buffer_size.hpp"
+
+namespace fz {
+
+namespace {
+
+// How often the throughput is sampled.
+const duration sampling_period = duration::from_milliseconds(250);
+
+}
+
+buffer_budget::buffer_budget(std::size_t max_total)
+	: max_total_(max_total)
+{
+}
+
+void buffer_budget::set_max_total(std::size_t max_total)
+{
+	max_total_.store(max_total, std::memory_order_relaxed);
+}
+
+std::size_t buffer_budget::get_max_total() const
+{
+	return max_total_.load(std::memory_order_relaxed);
+}
+
+std::size_t buffer_budget::get_used() const
+{
+	return used_.load(std::memory_order_relaxed);
+}
+
+std::size_t buffer_budget::reserve(std::size_t amount)
+{
+	auto max_total = max_total_.load(std::memory_order_relaxed);
+
+	if (max_total == 0) {
+		used_.fetch_add(amount, std::memory_order_relaxed);
+		return amount;
+	}
+
+	auto used = used_.load(std::memory_order_relaxed);
+	std::size_t reserved;
+
+	do {
+		reserved = used < max_total ? std::min(amount, max_total - used) : 0;
+
+		if (reserved == 0)
+			break;
+	} while (!used_.compare_exchange_weak(used, used + reserved, std::memory_order_relaxed));
+
+	return reserved;
+}
+
+void buffer_budget::force_reserve(std::size_t amount)
+{
+	used_.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void buffer_budget::release(std::size_t amount)
+{
+	used_.fetch_sub(amount, std::memory_order_relaxed);
+}
+
+adaptive_buffer_size::adaptive_buffer_size(buffer_budget &budget, options opts)
+	: budget_(budget)
+	, opts_(opts)
+	, next_opts_(opts)
+{
+}
+
+adaptive_buffer_size::~adaptive_buffer_size()
+{
+	reset();
+}
+
+void adaptive_buffer_size::set_options(const options &opts)
+{
+	next_opts_ = opts;
+}
+
+std::size_t adaptive_buffer_size::start()
+{
+	reset();
+
+	opts_ = next_opts_;
+	opts_.max_size = std::max(opts_.min_size, opts_.max_size);
+
+	size_ = opts_.min_size;
+	budget_.force_reserve(size_);
+
+	sample_start_ = {};
+	sample_start_amount_ = 0;
+
+	return size_;
+}
+
+bool adaptive_buffer_size::update(const monotonic_clock &now, std::int64_t total_amount)
+{
+	if (!size_)
+		return false;
+
+	if (!sample_start_) {
+		sample_start_ = now;
+		sample_start_amount_ = total_amount;
+		return false;
+	}
+
+	auto elapsed = now - sample_start_;
+	if (elapsed < sampling_period)
+		return false;
+
+	auto amount = std::max<std::int64_t>(total_amount - sample_start_amount_, 0);
+
+	sample_start_ = now;
+	sample_start_amount_ = total_amount;
+
+	// The amount of data the transfer moves in the target latency, twice as much to leave some headroom.
+	auto target = std::size_t(2 * amount * opts_.target_latency.get_milliseconds() / std::max<std::int64_t>(elapsed.get_milliseconds(), 1));
+	target = std::clamp(target, opts_.min_size, opts_.max_size);
+
+	if (target > size_)
+		return resize(std::min(target, size_ * 2));
+
+	// Some hysteresis, not to keep flipping between two sizes.
+	if (target < size_ / 2)
+		return resize(target);
+
+	return false;
+}
+
+void adaptive_buffer_size::reset()
+{
+	budget_.release(size_);
+	size_ = 0;
+}
+
+bool adaptive_buffer_size::resize(std::size_t new_size)
+{
+	if (new_size > size_) {
+		auto reserved = budget_.reserve(new_size - size_);
+		if (reserved == 0)
+			return false;
+
+		size_ += reserved;
+	}
+	else {
+		budget_.release(size_ - new_size);
+		size_ = new_size;
+	}
+
+	return true;
+}
+
+}
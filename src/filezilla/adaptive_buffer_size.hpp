@@ -0,0 +1,100 @@
+#ifndef FZ_ADAPTIVE_BUFFER_SIZE_HPP
+#define FZ_ADAPTIVE_BUFFER_SIZE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include <libfilezilla/time.hpp>
+
+namespace fz {
+
+//! Server-wide accounting of the memory devoted to the transfer buffers.
+class buffer_budget
+{
+public:
+	//! \param max_total the maximum amount of memory that can be reserved. 0 means no limit.
+	explicit buffer_budget(std::size_t max_total = 0);
+
+	void set_max_total(std::size_t max_total);
+	std::size_t get_max_total() const;
+
+	//! \returns the amount of memory currently reserved.
+	std::size_t get_used() const;
+
+	//! Reserves up to \ref amount bytes, within the limits of the budget.
+	//! \returns the amount actually reserved, which might be less than the requested one, or even 0.
+	std::size_t reserve(std::size_t amount);
+
+	//! Reserves \ref amount bytes regardless of the limits of the budget.
+	void force_reserve(std::size_t amount);
+
+	void release(std::size_t amount);
+
+private:
+	std::atomic<std::size_t> used_{};
+	std::atomic<std::size_t> max_total_{};
+};
+
+/*
+Computes the size of the buffers of a transfer from the observed throughput.
+
+The size starts at the minimum and grows, at most doubling each time, toward the amount of data
+that the transfer moves in the configured target latency, which stands in for the round trip time
+of the connection, so that the buffers can hold the bandwidth-delay product.
+If the throughput drops, the size shrinks back. Growing is subject to the server-wide budget,
+the minimum size is always granted, though.
+*/
+class adaptive_buffer_size
+{
+public:
+	struct options
+	{
+		std::size_t min_size = 64*1024;
+		std::size_t max_size = 4*1024*1024;
+		duration target_latency = duration::from_milliseconds(100);
+
+		options(){}
+	};
+
+	adaptive_buffer_size(buffer_budget &budget, options opts = {});
+	~adaptive_buffer_size();
+
+	adaptive_buffer_size(const adaptive_buffer_size &) = delete;
+	adaptive_buffer_size &operator=(const adaptive_buffer_size &) = delete;
+
+	//! Takes effect at the next reset()
+	void set_options(const options &opts);
+
+	//! \returns the current size, 0 if the size hasn't been computed yet.
+	std::size_t get() const
+	{
+		return size_;
+	}
+
+	//! Starts a new transfer: the size goes back to the minimum.
+	//! \returns the size.
+	std::size_t start();
+
+	//! Feeds the total amount of data the transfer has moved so far.
+	//! \returns true if the size has changed.
+	bool update(const monotonic_clock &now, std::int64_t total_amount);
+
+	//! Ends the transfer, giving the memory back to the budget.
+	void reset();
+
+private:
+	bool resize(std::size_t new_size);
+
+	buffer_budget &budget_;
+	options opts_;
+	options next_opts_;
+
+	std::size_t size_{};
+
+	monotonic_clock sample_start_{};
+	std::int64_t sample_start_amount_{};
+};
+
+}
+
+#endif // FZ_ADAPTIVE_BUFFER_SIZE_HPP
@@ -305,6 +305,8 @@ void file_based_authenticator::set_groups_and_users(file_based_authenticator::gr
 
 	sanitize(groups_, users_, &logger_);
 
+	disallowed_ips_.clear();
+
 	for (auto l_it = group_limiters_.begin(); l_it != group_limiters_.end();) {
 		if (auto g_it = groups_.find(l_it->first); g_it == groups_.end())
 			l_it = group_limiters_.erase(l_it);
@@ -359,6 +361,8 @@ void file_based_authenticator::set_groups_and_users(file_based_authenticator::gr
 			});
 		}
 	}
+
+	forget_unused_mount_trees();
 }
 
 void file_based_authenticator::get_groups_and_users(file_based_authenticator::groups &groups, file_based_authenticator::users &users)
@@ -395,14 +399,21 @@ void file_based_authenticator::stop_ongoing_authentications(event_handler &targe
 
 void file_based_authenticator::update_shared_user(user &user, const user_entry &entry)
 {
-	auto placeholders = user.mount_tree ? std::move(user.mount_tree->get_placeholders()) : tvfs::mount_tree::placeholders();
+	user.mount_tree = get_or_make_mount_tree(entry, user.mount_placeholders);
 
-	user.mount_tree = std::make_shared<tvfs::mount_tree>(entry.mount_table, std::move(placeholders));
+	// Sessions only attach the limiters that do limit something, so that unlimited ones don't cost anything at each refill tick.
+	static const auto is_limited = [](const rate_limits &l) {
+		return l.inbound != rate::unlimited || l.outbound != rate::unlimited;
+	};
 
-	if (!user.limiter)
-		user.limiter = std::make_shared<rate_limiter>(&rlm_);
+	if (!is_limited(entry.rate_limits))
+		user.limiter.reset();
+	else {
+		if (!user.limiter)
+			user.limiter = std::make_shared<rate_limiter>(&rlm_);
 
-	user.limiter->set_limits(entry.rate_limits.inbound, entry.rate_limits.outbound);
+		user.limiter->set_limits(entry.rate_limits.inbound, entry.rate_limits.outbound);
+	}
 
 	user.session_inbound_limit = entry.rate_limits.session_inbound;
 	user.session_outbound_limit = entry.rate_limits.session_outbound;
@@ -413,9 +424,8 @@ void file_based_authenticator::update_shared_user(user &user, const user_entry &
 	for (auto git = entry.groups.crbegin(), gend = entry.groups.crend(); git != gend; ++git) {
 		auto g = groups_.find(*git);
 		if (g != groups_.end()) {
-			user.mount_tree->merge_with(g->second.mount_table);
-
-			user.extra_limiters.push_back(get_or_make_group_limiter(*g));
+			if (is_limited(g->second.rate_limits))
+				user.extra_limiters.push_back(get_or_make_group_limiter(*g));
 
 			if (g->second.rate_limits.session_inbound < user.session_inbound_limit)
 				user.session_inbound_limit = g->second.rate_limits.session_inbound;
@@ -428,6 +438,88 @@ void file_based_authenticator::update_shared_user(user &user, const user_entry &
 	std::sort(user.extra_limiters.begin(), user.extra_limiters.end());
 }
 
+std::shared_ptr<tvfs::mount_tree> file_based_authenticator::get_or_make_mount_tree(const user_entry &entry, const tvfs::mount_tree::placeholders &placeholders)
+{
+	// The user's own mount table first, then the ones of its groups in reverse order, as that's the order they get merged in.
+	std::vector<tvfs::mount_table> tables;
+	tables.reserve(entry.groups.size() + 1);
+	tables.push_back(entry.mount_table);
+
+	for (auto git = entry.groups.crbegin(), gend = entry.groups.crend(); git != gend; ++git) {
+		if (auto g = groups_.find(*git); g != groups_.end())
+			tables.push_back(g->second.mount_table);
+	}
+
+	// Once the placeholders are expanded, the tree only depends on the mount points, hence they make up the key.
+	std::string key;
+
+	for (auto &t: tables) {
+		for (auto &mp: t) {
+			for (const auto &p: placeholders)
+				fz::replace_substrings(mp.native_path, p.first, p.second);
+
+			key.append(mp.tvfs_path).append(1, '\0');
+			key.append(fz::to_utf8(mp.native_path)).append(1, '\0');
+			key.append({char('0' + mp.access), char('0' + mp.recursive), char('0' + mp.flags), '\n'});
+		}
+
+		key.append(1, '\0');
+	}
+
+	auto &weak_tree = mount_trees_[std::move(key)];
+	if (auto tree = weak_tree.lock())
+		return tree;
+
+	auto tree = std::make_shared<tvfs::mount_tree>(tables.front());
+	for (auto it = std::next(tables.begin()); it != tables.end(); ++it)
+		tree->merge_with(std::move(*it));
+
+	weak_tree = tree;
+
+	// The cost of forgetting the trees nobody uses anymore is amortized over the insertions.
+	if (mount_trees_.size() >= mount_trees_sweep_size_)
+		forget_unused_mount_trees();
+
+	return tree;
+}
+
+void file_based_authenticator::forget_unused_mount_trees()
+{
+	for (auto it = mount_trees_.begin(); it != mount_trees_.end();) {
+		if (it->second.expired())
+			it = mount_trees_.erase(it);
+		else
+			++it;
+	}
+
+	mount_trees_sweep_size_ = std::max(mount_trees_.size() * 2, std::size_t(64));
+}
+
+const tcp::binary_address_list &file_based_authenticator::get_disallowed_ips(const users::value_type &u)
+{
+	auto [it, inserted] = disallowed_ips_.try_emplace(u.first);
+	auto &disallowed = it->second;
+
+	if (inserted) {
+		tcp::binary_address_list allowed;
+
+		disallowed.merge_with(u.second.disallowed_ips);
+		allowed.merge_with(u.second.allowed_ips);
+
+		for (const auto &n: u.second.groups) {
+			if (const auto git = groups_.find(n); git != groups_.end()) {
+				disallowed.merge_with(git->second.disallowed_ips);
+				allowed.merge_with(git->second.allowed_ips);
+			}
+		}
+
+		// An address allowed by the user or by any of its groups is an exception to all of the disallowed ones.
+		disallowed.subtract(allowed);
+	}
+
+	return disallowed;
+}
+
 void file_based_authenticator::update_group_limiter(rate_limiter &limiter, const file_based_authenticator::groups::value_type &g)
 {
 	limiter.set_limits(g.second.rate_limits.inbound, g.second.rate_limits.outbound);
@@ -451,14 +543,12 @@ shared_user file_based_authenticator::get_or_make_shared_user(const std::string
 
 	if (!shared_user_in_map) {
 		authentication::user user(is_from_system ? users::system_user_name : name);
-		user.mount_tree = std::make_shared<tvfs::mount_tree>();
 
-		tvfs::mount_tree::placeholders placeholders = {
+		user.mount_placeholders = {
 			{ fzT(":u"), fz::to_native(name) },
 			{ fzT(":h"), std::move(user_home) }
 		};
 
-		user.mount_tree->set_placeholders(std::move(placeholders));
 		if (token)
 			user.impersonator = std::make_shared<impersonator::client>(thread_pool_, logger_, std::move(token), impersonator_exe_);
 
@@ -535,61 +625,30 @@ void file_based_authenticator::worker::authenticate(const methods_list &methods,
 	if (logger_.should_log(logmsg::debug_debug))
 		logger_.log_u(logmsg::debug_debug, "Invoked authenticate(%s) on worker %p, with available methods = [%s]", methods, this, available_methods);
 
+	users::value_type *entry{};
 	user_entry *u{};
 	bool is_from_system{};
 	shared_user shared_user;
 
 	if (auto it = owner_.users_.find(name_); it != owner_.users_.end())
-		u = &it->second;
+		entry = &*it;
 	else
 	if (it = owner_.users_.find(owner_.users_.system_user_name); it != owner_.users_.end())  {
-		u = &it->second;
+		entry = &*it;
 		is_from_system = true;
 	}
 
+	if (entry)
+		u = &entry->second;
+
 	if (!u)
 		error = error::user_nonexisting;
 
 	if (!error && !u->enabled)
 		error = error::user_disabled;
 
-	if (!error) {
-		// Check whether user's ip is disallowed
-		if (u->disallowed_ips.contains(ip_, family_))
-			error = error::ip_disallowed;
-
-		if (!error) {
-			for (const auto &n: u->groups) {
-				if (const auto git = owner_.groups_.find(n); git != owner_.groups_.end()) {
-					const auto &g = git->second;
-
-					if (g.disallowed_ips.contains(ip_, family_)) {
-						error = error::ip_disallowed;
-						break;
-					}
-				}
-			}
-		}
-
-		// If it is, check whether there are exceptions
-		if (error) {
-			if (u->allowed_ips.contains(ip_, family_))
-				error = error::none;
-
-			if (error) {
-				for (const auto &n: u->groups) {
-					if (const auto git = owner_.groups_.find(n); git != owner_.groups_.end()) {
-						const auto &g = git->second;
-
-						if (g.allowed_ips.contains(ip_, family_)) {
-							error = error::none;
-							break;
-						}
-					}
-				}
-			}
-		}
-	}
+	if (!error && owner_.get_disallowed_ips(*entry).contains(ip_, family_))
+		error = error::ip_disallowed;
 
 	if (!error && !available_methods.is_auth_possible())
 		available_methods = u->methods;
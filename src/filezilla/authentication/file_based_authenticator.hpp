@@ -211,6 +211,9 @@ private:
 	static void sanitize(groups &groups, users &users, logger_interface *logger = nullptr);
 
 	void update_shared_user(authentication::user &user, const user_entry &entry);
+	std::shared_ptr<tvfs::mount_tree> get_or_make_mount_tree(const user_entry &entry, const tvfs::mount_tree::placeholders &placeholders);
+	void forget_unused_mount_trees();
+	const tcp::binary_address_list &get_disallowed_ips(const users::value_type &u);
 	void update_group_limiter(rate_limiter &limiter, const groups::value_type &g);
 	shared_user get_or_make_shared_user(const std::string &name, const user_entry &entry, bool is_from_system, impersonation_token &&token, native_string user_home);
 	shared_limiter get_or_make_group_limiter(const groups::value_type &g);
@@ -232,6 +235,14 @@ private:
 	std::unordered_map<std::string, shared_limiter> group_limiters_;
 	users_map<weak_user> weak_users_map_;
 
+	// Keyed by the mount points the trees are made of, with the placeholders expanded, so that users ending up with the same ones share the same tree.
+	std::unordered_map<std::string, std::weak_ptr<tvfs::mount_tree>> mount_trees_;
+	std::size_t mount_trees_sweep_size_{};
+
+	// Computed at the first login attempt of each user since the groups and users were last set: the addresses the user can't log in from,
+	// with those of its groups merged in and the allowed ones taken out, so that a login only needs one lookup.
+	users_map<tcp::binary_address_list> disallowed_ips_;
+
 	native_string impersonator_exe_;
 
 	std::unique_ptr<util::xml_archiver_base> xml_archiver_;
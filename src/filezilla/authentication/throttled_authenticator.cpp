@@ -3,9 +3,27 @@
 #include "throttled_authenticator.hpp"
 #include "../remove_event.hpp"
 #include "../hostaddress.hpp"
+#include "../metrics/registry.hpp"
 
 namespace fz::authentication {
 
+namespace {
+
+struct auth_metrics
+{
+	metrics::gauge &pending = metrics::registry::global().get_gauge("fz_auth_pending", "Number of authentications in progress, delayed ones included.");
+	metrics::gauge &delayed = metrics::registry::global().get_gauge("fz_auth_delayed", "Number of authentications being delayed because of too many failures.");
+	metrics::histogram &latency = metrics::registry::global().get_histogram("fz_auth_duration_seconds", "Time taken by the authentication backend to come up with a result.");
+
+	static auth_metrics &get()
+	{
+		static auth_metrics m;
+		return m;
+	}
+};
+
+}
+
 class throttled_authenticator::worker: private event_handler {
 	class operation;
 
@@ -19,6 +37,7 @@ public:
 		, owner_(owner)
 		, meta_for_logging_(std::move(meta_for_logging))
 		, logger_(owner.logger_, {}, meta_for_logging_)
+		, pending_(auth_metrics::get().pending)
 	{
 	}
 
@@ -74,6 +93,10 @@ private:
 
 	workers_t::iterator self_in_workers_;
 	std::optional<waiting_workers_t::iterator> self_in_waiting_;
+
+	metrics::gauge::holder pending_;
+	metrics::gauge::holder delayed_;
+	monotonic_clock authentication_start_;
 };
 
 class throttled_authenticator::worker::operation: public authenticator::operation {
@@ -206,6 +229,7 @@ void throttled_authenticator::worker::on_operation_result(authenticator &, std::
 	fz::scoped_lock lock(owner_.mutex_);
 
 	authenticating_ = false;
+	auth_metrics::get().latency.record_since(authentication_start_);
 
 	bool is_none = methods_.size() == 1 && methods_[0].is<method::none>();
 
@@ -279,6 +303,7 @@ bool throttled_authenticator::worker::try_to_authenticate(const methods_list &me
 
 	logger_.log_u(logmsg::debug_warning, L"Authentication for user %s from IP %s will be delayed %ds.", name_, ip_, delta.get_seconds());
 	self_in_waiting_ = owner_.waiting_workers_.emplace(next_try, self_in_workers_);
+	delayed_ = metrics::gauge::holder(auth_metrics::get().delayed);
 
 	if (owner_.auth_timer_id_ == 0)
 		owner_.auth_timer_id_ = owner_.add_timer(delta, true);
@@ -288,6 +313,8 @@ bool throttled_authenticator::worker::try_to_authenticate(const methods_list &me
 
 bool throttled_authenticator::worker::authenticate()
 {
+	authentication_start_ = monotonic_clock::now();
+
 	if (next_op_) {
 		if (!authentication::next(std::move(next_op_), methods_))
 			return false;
@@ -411,6 +438,7 @@ void throttled_authenticator::operator()(const event_base &ev)
 				}
 
 				it->second->self_in_waiting_ = {};
+				it->second->delayed_ = {};
 				it->second->authenticate();
 				waiting_workers_.erase(it);
 			}
@@ -22,6 +22,7 @@ class user {
 public:
 	std::string name{};
 	std::shared_ptr<tvfs::mount_tree> mount_tree{};
+	tvfs::mount_tree::placeholders mount_placeholders{}; ///< expanded in the native paths of the mount points the mount_tree is made of
 	std::shared_ptr<impersonator::client> impersonator{};
 	std::shared_ptr<rate_limiter> limiter;
 	std::vector<std::shared_ptr<rate_limiter>> extra_limiters{}; ///< sorted in ascending order
@@ -0,0 +1,55 @@
+#ifndef FZ_BUFFER_OPERATOR_CACHED_FILE_READER_HPP
+#define FZ_BUFFER_OPERATOR_CACHED_FILE_READER_HPP
+
+#include "../small_file_cache.hpp"
+#include "adder.hpp"
+
+namespace fz::buffer_operator {
+
+	//! Serves a file's content straight from the memory the small file cache holds it in, without reading from the file at all.
+	class cached_file_reader: public adder {
+	public:
+		cached_file_reader(std::size_t max_buffer_size): max_buffer_size_{max_buffer_size} {}
+
+		//! Takes effect from the next call to add_to_buffer() on. Data already in the buffer is not affected.
+		void set_max_buffer_size(std::size_t max_buffer_size) {
+			max_buffer_size_ = max_buffer_size;
+		}
+
+		//! Makes the reader serve \param data, from \param offset on.
+		void set_data(std::shared_ptr<const small_file_cache::region> data, std::size_t offset) {
+			data_ = std::move(data);
+			offset_ = offset;
+		}
+
+		int add_to_buffer() override {
+			auto buffer = get_buffer();
+			if (!buffer)
+				return EINVAL;
+
+			if (!data_ || offset_ >= data_->size()) {
+				// The region is of no use anymore, no reason to keep it alive.
+				data_.reset();
+				return ENODATA;
+			}
+
+			if (buffer->size() >= max_buffer_size_)
+				return ENOBUFS;
+
+			auto to_add = std::min(max_buffer_size_ - buffer->size(), data_->size() - offset_);
+
+			buffer->append(data_->data() + offset_, to_add);
+			offset_ += to_add;
+
+			return 0;
+		}
+
+	private:
+		std::size_t max_buffer_size_;
+		std::shared_ptr<const small_file_cache::region> data_;
+		std::size_t offset_{};
+	};
+
+}
+
+#endif // FZ_BUFFER_OPERATOR_CACHED_FILE_READER_HPP
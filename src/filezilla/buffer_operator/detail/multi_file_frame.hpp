@@ -0,0 +1,81 @@
+#ifndef FZ_BUFFER_OPERATOR_DETAIL_MULTI_FILE_FRAME_HPP
+#define FZ_BUFFER_OPERATOR_DETAIL_MULTI_FILE_FRAME_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <libfilezilla/buffer.hpp>
+
+namespace fz::buffer_operator::detail::multi_file_frame {
+
+/*
+The container used to transfer several files over a single data connection is a plain sequence of frames,
+one per file, each made of a header immediately followed by the file's data. All integers are big endian.
+
+    status     1 byte   0 if the file's data follows, anything else if the file couldn't be opened
+    name_size  2 bytes
+    name       name_size bytes, the path of the file, UTF-8 encoded
+    data_size  8 bytes  only if status is 0
+    data       data_size bytes
+
+The end of the container is signalled by the end of the data connection itself.
+*/
+
+enum status: std::uint8_t
+{
+	ok     = 0,
+	failed = 1
+};
+
+inline constexpr std::size_t max_name_size = 0xFFFF;
+
+inline void add_header(buffer &b, status s, std::string_view name, std::uint64_t data_size)
+{
+	if (name.size() > max_name_size)
+		name = name.substr(0, max_name_size);
+
+	b.append(std::uint8_t(s));
+	b.append(std::uint8_t(name.size() >> 8));
+	b.append(std::uint8_t(name.size()));
+	b.append(name);
+
+	if (s == ok) {
+		for (int shift = 56; shift >= 0; shift -= 8)
+			b.append(std::uint8_t(data_size >> shift));
+	}
+}
+
+//! \returns 0 if a whole header has been parsed, ENODATA if more data is needed to complete it, EINVAL if it's malformed.
+inline int parse_header(const buffer &b, status &s, std::string &name, std::uint64_t &data_size, std::size_t &header_size)
+{
+	if (b.size() < 3)
+		return ENODATA;
+
+	auto p = b.get();
+
+	if (p[0] != ok && p[0] != failed)
+		return EINVAL;
+
+	s = status(p[0]);
+	std::size_t name_size = std::size_t(p[1]) << 8 | p[2];
+
+	header_size = 3 + name_size + (s == ok ? 8 : 0);
+	if (b.size() < header_size)
+		return ENODATA;
+
+	name.assign(reinterpret_cast<const char *>(p + 3), name_size);
+
+	data_size = 0;
+	if (s == ok) {
+		for (std::size_t i = 0; i < 8; ++i)
+			data_size = data_size << 8 | p[3 + name_size + i];
+	}
+
+	return 0;
+}
+
+}
+
+#endif // FZ_BUFFER_OPERATOR_DETAIL_MULTI_FILE_FRAME_HPP
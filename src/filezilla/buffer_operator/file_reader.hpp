@@ -4,18 +4,65 @@
 #include <libfilezilla/file.hpp>
 
 #include "adder.hpp"
+#include "../metrics/registry.hpp"
+#include "../util/io.hpp"
 
 namespace fz::buffer_operator {
 
 	class file_reader: public adder {
 	public:
-		file_reader(file &file, unsigned int max_buffer_size): file_{file}, max_buffer_size_{max_buffer_size} {}
+		struct options
+		{
+			//! In streaming mode, the system is asked to read ahead this much data at first,
+			//! then twice as much each time the reader catches up with it, up to max_read_ahead.
+			std::size_t min_read_ahead = 256*1024;
+			std::size_t max_read_ahead = 16*1024*1024;
+
+			//! In streaming mode, files at least this big are dropped from the system's cache as they're read,
+			//! so that a few big downloads don't evict everything else from it.
+			int64_t drop_behind_threshold = 256*1024*1024;
+		};
+
+		file_reader(file &file, std::size_t max_buffer_size, options opts = {})
+			: file_{file}
+			, max_buffer_size_{max_buffer_size}
+			, opts_{opts}
+		{}
+
+		//! Takes effect from the next read on. Data already in the buffer is not affected.
+		void set_max_buffer_size(std::size_t max_buffer_size) {
+			max_buffer_size_ = max_buffer_size;
+		}
+
+		//! Takes effect from the next call to set_streaming() on.
+		void set_options(options opts) {
+			opts_ = opts;
+		}
+
+		//! To be invoked once the file has been opened, before the transfer starts.
+		//! In streaming mode the file is expected to be read sequentially till the end, and the system's cache is managed accordingly.
+		void set_streaming(bool streaming) {
+			streaming_ = streaming;
+			probe_cache_ = streaming;
+
+			if (!streaming_)
+				return;
+
+			offset_ = read_ahead_end_ = dropped_until_ = file_.seek(0, file::current);
+			window_ = std::max(opts_.min_read_ahead, std::size_t(1));
+			drop_behind_ = file_.size() >= opts_.drop_behind_threshold;
+
+			util::io::advise_sequential(file_);
+		}
 
 		int add_to_buffer() override {
 			auto buffer = get_buffer();
 			if (!buffer)
 				return EINVAL;
 
+			if (buffer->size() >= max_buffer_size_)
+				return ENOBUFS;
+
 			int64_t to_read;
 
 			if constexpr (sizeof(std::size_t) >= sizeof(int64_t))
@@ -26,7 +73,10 @@ namespace fz::buffer_operator {
 			if (!to_read)
 				return ENOBUFS;
 
-			auto read = file_.read(buffer->get(std::size_t(to_read)), to_read);
+			if (streaming_)
+				manage_cache();
+
+			auto read = read_file(buffer->get(std::size_t(to_read)), to_read);
 			if (read < 0)
 				return EIO;
 
@@ -34,12 +84,75 @@ namespace fz::buffer_operator {
 				return ENODATA;
 
 			buffer->add(size_t(read));
+			offset_ += read;
+
 			return 0;
 		}
 
 	private:
+		struct counters
+		{
+			metrics::counter &from_cache = metrics::registry::global().get_counter("fz_file_read_bytes_total", "Bytes read from files for downloads, by where they were found.", {{"source", "cache"}});
+			metrics::counter &from_disk = metrics::registry::global().get_counter("fz_file_read_bytes_total", "Bytes read from files for downloads, by where they were found.", {{"source", "disk"}});
+		};
+
+		static counters &get_counters() {
+			static counters c;
+			return c;
+		}
+
+		// Tells apart the data that was in the system's cache from the data that had to come from disk, where that can be found out.
+		// Probing costs an extra system call whenever the data isn't cached, hence it's only done in streaming mode,
+		// where the reads are big and the figures are worth having.
+		int64_t read_file(void *data, int64_t size) {
+			if (probe_cache_) {
+				auto read = util::io::read_cached(file_, data, size);
+
+				if (read > 0) {
+					get_counters().from_cache.add(std::uint64_t(read));
+					return read;
+				}
+
+				if (read < 0)
+					probe_cache_ = false;
+			}
+
+			auto read = file_.read(data, size);
+
+			if (read > 0 && probe_cache_)
+				get_counters().from_disk.add(std::uint64_t(read));
+
+			return read;
+		}
+
+		void manage_cache() {
+			// Once the reader gets halfway through the data being read ahead, more is requested, and the window grows.
+			if (offset_ + int64_t(window_/2) >= read_ahead_end_) {
+				auto end = offset_ + int64_t(window_);
+
+				util::io::prefetch(file_, std::max(read_ahead_end_, offset_), end - std::max(read_ahead_end_, offset_));
+				read_ahead_end_ = end;
+
+				window_ = std::min(window_*2, std::max(opts_.max_read_ahead, opts_.min_read_ahead));
+			}
+
+			if (drop_behind_ && offset_ - dropped_until_ >= int64_t(opts_.max_read_ahead)) {
+				util::io::drop_from_cache(file_, dropped_until_, offset_ - dropped_until_);
+				dropped_until_ = offset_;
+			}
+		}
+
 		file &file_;
-		unsigned int max_buffer_size_;
+		std::size_t max_buffer_size_;
+		options opts_;
+
+		bool streaming_{};
+		bool probe_cache_{};
+		bool drop_behind_{};
+		std::size_t window_{};
+		int64_t offset_{};
+		int64_t read_ahead_end_{};
+		int64_t dropped_until_{};
 	};
 
 }
@@ -1,38 +1,156 @@
 #ifndef FZ_BUFFER_OPERATOR_FILE_WRITER_HPP
 #define FZ_BUFFER_OPERATOR_FILE_WRITER_HPP
 
+#include <optional>
+
 #include <libfilezilla/file.hpp>
 
 #include "../buffer_operator/consumer.hpp"
+#include "../util/io.hpp"
 
 namespace fz::buffer_operator {
 
 	class file_writer: public consumer {
 	public:
-		explicit file_writer(file &file): file_{file} {}
+		struct options
+		{
+			//! Data is written to the file in chunks of this size, only the last one of which can be smaller,
+			//! so that the file doesn't get fragmented by the many small writes a slow connection would cause.
+			//! 0 means data is written as soon as it's received.
+			std::size_t chunk_size = 1024*1024;
+
+			//! Whether to start writing back each chunk as soon as it's written, and let the previous one be dropped from the cache,
+			//! so that big uploads don't fill the memory with dirty pages that would then be written back all at once.
+			bool flush_behind = false;
+		};
+
+		explicit file_writer(file &file, options opts = {})
+			: file_{file}
+			, opts_{opts}
+		{}
+
+		//! Changing the chunk size while data is held back would write it out of order,
+		//! hence during a transfer the new options only take effect once it's been finalized.
+		void set_options(options opts) {
+			if (is_transferring())
+				next_opts_ = opts;
+			else
+				opts_ = opts;
+		}
+
+		//! Reserves space on disk for the given amount of data, to be written from the current position on.
+		//! Best effort: nothing happens if the platform or the filesystem don't support it.
+		void preallocate(int64_t size) {
+			if (size <= 0 || !file_.opened())
+				return;
+
+			offset_ = file_.seek(0, file::current);
+			preallocated_ = util::io::preallocate(file_, offset_, size);
+		}
+
+		//! Writes the data still held back, if any, and, if space had been preallocated, truncates the file where the data ends.
+		//! Must be invoked once the transfer is over, whether it succeeded or not.
+		//! \returns 0 on success, or EIO.
+		int finalize() {
+			int err = 0;
+
+			if (file_.opened()) {
+				if (!pending_.empty())
+					err = write(pending_.get(), pending_.size());
+
+				if (preallocated_ && !file_.truncate())
+					err = EIO;
+			}
+
+			pending_.clear();
+			preallocated_ = false;
+			offset_ = -1;
+			last_chunk_ = {};
+
+			if (next_opts_) {
+				opts_ = *next_opts_;
+				next_opts_.reset();
+			}
+
+			return err;
+		}
 
 		int consume_buffer() override {
 			auto buffer = get_buffer();
 			if (!buffer)
 				return EINVAL;
 
-			int64_t to_write = 0;
+			if (opts_.chunk_size == 0)
+				return consume(*buffer, buffer->size());
 
-			if constexpr (sizeof(std::size_t) >= sizeof(int64_t))
-				to_write = int64_t(std::min(buffer->size(), std::size_t(std::numeric_limits<int64_t>::max())));
-			else
-				to_write = int64_t(buffer->size());
+			// As long as there are whole chunks in the buffer, write them straight from there.
+			if (pending_.empty() && buffer->size() >= opts_.chunk_size)
+				return consume(*buffer, buffer->size() - buffer->size() % opts_.chunk_size);
 
-			auto written = file_.write(buffer->get(), to_write);
-			if (written < 0)
-				return EIO;
+			auto to_hold = std::min(buffer->size(), opts_.chunk_size - pending_.size());
+			pending_.append(buffer->get(), to_hold);
+			buffer->consume(to_hold);
 
-			buffer->consume(size_t(written));
-			return 0;
+			if (pending_.size() < opts_.chunk_size)
+				return 0;
+
+			return consume(pending_, pending_.size());
 		}
 
 	private:
+		bool is_transferring() const {
+			return offset_ >= 0 || preallocated_ || !pending_.empty();
+		}
+
+		int consume(buffer &b, std::size_t size) {
+			int err = write(b.get(), size);
+			if (err)
+				return err;
+
+			b.consume(size);
+			return 0;
+		}
+
+		int write(const unsigned char *data, std::size_t size) {
+			if (offset_ < 0)
+				offset_ = file_.seek(0, file::current);
+
+			auto start = offset_;
+
+			while (size > 0) {
+				int64_t to_write = 0;
+				if constexpr (sizeof(std::size_t) >= sizeof(int64_t))
+					to_write = int64_t(std::min(size, std::size_t(std::numeric_limits<int64_t>::max())));
+				else
+					to_write = int64_t(size);
+
+				auto written = file_.write(data, to_write);
+				if (written <= 0)
+					return EIO;
+
+				data += written;
+				size -= std::size_t(written);
+				offset_ += written;
+			}
+
+			if (opts_.flush_behind) {
+				util::io::drop_from_cache(file_, last_chunk_.first, last_chunk_.second);
+				util::io::start_writeback(file_, start, offset_ - start);
+
+				last_chunk_ = { start, offset_ - start };
+			}
+
+			return 0;
+		}
+
 		file &file_;
+		options opts_;
+		std::optional<options> next_opts_;
+
+		buffer pending_;
+		int64_t offset_{-1};
+		bool preallocated_{};
+		std::pair<int64_t, int64_t> last_chunk_{};
 	};
 
 }
@@ -0,0 +1,158 @@
+#ifndef FZ_BUFFER_OPERATOR_MULTI_FILE_READER_HPP
+#define FZ_BUFFER_OPERATOR_MULTI_FILE_READER_HPP
+
+#include <vector>
+
+#include <libfilezilla/file.hpp>
+
+#include "../tvfs/engine.hpp"
+#include "../tcp/session.hpp"
+#include "../receiver/async.hpp"
+#include "adder.hpp"
+#include "detail/multi_file_frame.hpp"
+
+namespace fz::buffer_operator {
+
+	//! Sends the given files, one after the other, in the container format described in detail/multi_file_frame.hpp.
+	//! Each file is opened through the tvfs, hence undergoes the usual permission checks.
+	class multi_file_reader: public adder {
+	public:
+		multi_file_reader(event_loop &loop, tvfs::engine &tvfs, tcp::session::notifier &notifier, std::size_t max_buffer_size)
+			: h_(loop)
+			, tvfs_(tvfs)
+			, notifier_(notifier)
+			, max_buffer_size_(max_buffer_size)
+		{}
+
+		//! Makes the reader start over, with the given files.
+		void set_paths(std::vector<std::string> paths) {
+			h_.stop_receiving();
+			file_.close();
+
+			paths_ = std::move(paths);
+			next_path_ = 0;
+			remaining_ = 0;
+			opening_ = false;
+			num_sent_ = 0;
+			num_failed_ = 0;
+		}
+
+		std::size_t num_sent() const {
+			return num_sent_;
+		}
+
+		std::size_t num_failed() const {
+			return num_failed_;
+		}
+
+		//! Stops the transfer, closing the file being sent, if any, with the given error.
+		//! The file's entry is closed exactly once, whether or not the reader has already given up on it.
+		void abort(int error) {
+			h_.stop_receiving();
+
+			if (opening_) {
+				// The entry hasn't been opened yet.
+				file_.close();
+				opening_ = false;
+			}
+			else
+			if (file_)
+				close_current(error);
+
+			next_path_ = paths_.size();
+		}
+
+		int add_to_buffer() override {
+			if (opening_)
+				return EAGAIN;
+
+			if (file_ && remaining_ == 0)
+				close_current(0);
+
+			if (!file_) {
+				if (next_path_ == paths_.size())
+					return ENODATA;
+
+				open_next();
+				return EAGAIN;
+			}
+
+			auto buffer = get_buffer();
+			if (!buffer)
+				return EINVAL;
+
+			if (buffer->size() >= max_buffer_size_)
+				return ENOBUFS;
+
+			auto to_read = std::int64_t(std::min<std::uint64_t>(max_buffer_size_ - buffer->size(), remaining_));
+
+			auto read = file_.read(buffer->get(std::size_t(to_read)), to_read);
+			if (read <= 0) {
+				// The file shrank in the meanwhile: the size in the header can't be honored anymore, the container is broken.
+				close_current(EIO);
+				return EIO;
+			}
+
+			buffer->add(std::size_t(read));
+			remaining_ -= std::uint64_t(read);
+
+			return 0;
+		}
+
+	private:
+		void open_next() {
+			opening_ = true;
+
+			auto &path = paths_[next_path_++];
+
+			tvfs_.async_open_file(file_, path, file::mode::reading, 0, async_receive(h_) >> [this, &path](result res, const std::string &tvfs_path) {
+				opening_ = false;
+
+				auto buffer = get_buffer();
+				if (!buffer) {
+					adder::send_event(EINVAL);
+					return;
+				}
+
+				if (!res) {
+					file_.close();
+					num_failed_ += 1;
+					detail::multi_file_frame::add_header(*buffer, detail::multi_file_frame::failed, path, 0);
+				}
+				else {
+					remaining_ = std::uint64_t(std::max<std::int64_t>(file_.size(), 0));
+					notifier_.notify_entry_open(1, tvfs_path, file_.size());
+					detail::multi_file_frame::add_header(*buffer, detail::multi_file_frame::ok, path, remaining_);
+				}
+
+				adder::send_event(0);
+			});
+		}
+
+		void close_current(int error) {
+			file_.close();
+			notifier_.notify_entry_close(1, error);
+
+			if (!error)
+				num_sent_ += 1;
+		}
+
+		async_handler h_;
+		tvfs::engine &tvfs_;
+		tcp::session::notifier &notifier_;
+		std::size_t max_buffer_size_;
+
+		std::vector<std::string> paths_;
+		std::size_t next_path_{};
+
+		file file_;
+		std::uint64_t remaining_{};
+		bool opening_{};
+
+		std::size_t num_sent_{};
+		std::size_t num_failed_{};
+	};
+
+}
+
+#endif // FZ_BUFFER_OPERATOR_MULTI_FILE_READER_HPP
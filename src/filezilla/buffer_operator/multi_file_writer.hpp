@@ -0,0 +1,167 @@
+#ifndef FZ_BUFFER_OPERATOR_MULTI_FILE_WRITER_HPP
+#define FZ_BUFFER_OPERATOR_MULTI_FILE_WRITER_HPP
+
+#include <vector>
+
+#include <libfilezilla/file.hpp>
+
+#include "../tvfs/engine.hpp"
+#include "../tcp/session.hpp"
+#include "../receiver/async.hpp"
+#include "consumer.hpp"
+#include "detail/multi_file_frame.hpp"
+
+namespace fz::buffer_operator {
+
+	//! Stores the files received in the container format described in detail/multi_file_frame.hpp.
+	//! Each file is opened through the tvfs, hence undergoes the usual permission checks.
+	//! The data of the files that can't be opened is discarded, and their names are made available through failed().
+	class multi_file_writer: public consumer {
+	public:
+		multi_file_writer(event_loop &loop, tvfs::engine &tvfs, tcp::session::notifier &notifier)
+			: h_(loop)
+			, tvfs_(tvfs)
+			, notifier_(notifier)
+		{}
+
+		//! Makes the writer ready to receive a new container.
+		void reset() {
+			h_.stop_receiving();
+			file_.close();
+
+			state_ = expecting_header;
+			remaining_ = 0;
+			num_stored_ = 0;
+			failed_.clear();
+		}
+
+		std::size_t num_stored() const {
+			return num_stored_;
+		}
+
+		const std::vector<std::string> &failed() const {
+			return failed_;
+		}
+
+		//! \returns whether the container received so far ends with a whole file.
+		bool is_complete() const {
+			return state_ == expecting_header;
+		}
+
+		//! Stops the transfer, closing the file being stored, if any, with the given error.
+		//! The file's entry is closed exactly once, whether or not the writer has already given up on it.
+		void abort(int error) {
+			h_.stop_receiving();
+
+			if (state_ == opening) {
+				// The entry hasn't been opened yet.
+				file_.close();
+				state_ = expecting_header;
+			}
+			else
+				close_current(error);
+		}
+
+		int consume_buffer() override {
+			if (state_ == opening)
+				return EAGAIN;
+
+			auto buffer = get_buffer();
+			if (!buffer)
+				return EINVAL;
+
+			if (state_ == expecting_header) {
+				detail::multi_file_frame::status status;
+				std::size_t header_size;
+
+				if (int err = detail::multi_file_frame::parse_header(*buffer, status, name_, remaining_, header_size))
+					return err;
+
+				// Clients have no business sending frames for the files they couldn't read.
+				if (status != detail::multi_file_frame::ok)
+					return EINVAL;
+
+				buffer->consume(header_size);
+				open_current();
+
+				return EAGAIN;
+			}
+
+			auto to_consume = std::size_t(std::min<std::uint64_t>(buffer->size(), remaining_));
+
+			if (state_ == writing) {
+				auto written = file_.write(buffer->get(), std::int64_t(to_consume));
+				if (written < 0) {
+					close_current(EIO);
+					return EIO;
+				}
+
+				to_consume = std::size_t(written);
+			}
+
+			buffer->consume(to_consume);
+			remaining_ -= to_consume;
+
+			if (remaining_ == 0)
+				close_current(0);
+
+			return 0;
+		}
+
+	private:
+		enum state {
+			expecting_header,
+			opening,
+			writing,
+			skipping
+		};
+
+		void open_current() {
+			state_ = opening;
+
+			tvfs_.async_open_file(file_, name_, file::mode::writing, 0, async_receive(h_) >> [this](result res, const std::string &tvfs_path) {
+				if (!res) {
+					file_.close();
+					failed_.push_back(name_);
+					state_ = skipping;
+				}
+				else {
+					notifier_.notify_entry_open(1, tvfs_path, 0);
+					state_ = writing;
+				}
+
+				if (remaining_ == 0)
+					close_current(0);
+
+				consumer::send_event(0);
+			});
+		}
+
+		void close_current(int error) {
+			if (state_ == writing) {
+				file_.close();
+				notifier_.notify_entry_close(1, error);
+
+				if (!error)
+					num_stored_ += 1;
+			}
+
+			state_ = expecting_header;
+		}
+
+		async_handler h_;
+		tvfs::engine &tvfs_;
+		tcp::session::notifier &notifier_;
+
+		file file_;
+		std::string name_;
+		std::uint64_t remaining_{};
+		state state_{expecting_header};
+
+		std::size_t num_stored_{};
+		std::vector<std::string> failed_;
+	};
+
+}
+
+#endif // FZ_BUFFER_OPERATOR_MULTI_FILE_WRITER_HPP
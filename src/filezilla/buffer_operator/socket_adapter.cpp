@@ -100,7 +100,9 @@ int fz::buffer_operator::socket_adapter::add_to_buffer() {
 		return EINVAL;
 
 	int error = 0;
-	auto amount_to_read = max_readable_amount_-buffer->size();
+
+	// The max readable amount might have been lowered below the amount already in the buffer.
+	auto amount_to_read = max_readable_amount_ > buffer->size() ? max_readable_amount_-buffer->size() : 0;
 
 	if (amount_to_read > 0) {
 		int read = si_->read(buffer->get(amount_to_read), static_cast<unsigned int>(amount_to_read), error);
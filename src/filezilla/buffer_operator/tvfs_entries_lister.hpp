@@ -29,32 +29,50 @@ namespace fz::buffer_operator {
 			if (!it_.has_next())
 				return ENODATA;
 
+			add_next_entry();
+
+			return EAGAIN;
+		}
+
+	private:
+		// Entries are cheap to format, compared to the cost of waking up the consumer of the buffer:
+		// keep adding them, as long as there are more, until the buffer holds a good chunk of data.
+		static constexpr std::size_t batch_size = 32*1024;
+
+		void add_next_entry()
+		{
 			it_.async_next(async_receive(h_) >> [this](auto result, tvfs::entry &entry) {
 				if (!result) {
 					adder::send_event(EINVAL);
 					return;
 				}
 
-				std::apply([&](auto& ...args) {
+				bool buffer_is_full;
+
+				{
 					auto buffer = get_buffer();
 					if (!buffer) {
 						adder::send_event(EINVAL);
 						return;
 					}
 
-					auto out = util::buffer_streamer(*buffer);
-					if (prepend_space_)
-						out << ' ';
-					out << EntryStreamer(entry, args...) << "\r\n";
+					std::apply([&](auto& ...args) {
+						auto out = util::buffer_streamer(*buffer);
+						if (prepend_space_)
+							out << ' ';
+						out << EntryStreamer(entry, args...) << "\r\n";
+					}, args_);
 
-					adder::send_event(0);
-				}, args_);
-			});
+					buffer_is_full = buffer->size() >= batch_size;
+				}
 
-			return EAGAIN;
+				if (!buffer_is_full && it_.has_next())
+					return add_next_entry();
+
+				adder::send_event(0);
+			});
 		}
 
-	private:
 		async_handler h_;
 		tvfs::entries_iterator &it_;
 		std::tuple<Args...> args_;
@@ -83,12 +83,12 @@ void channel::set_buffer_consumer(buffer_operator::consumer_interface *consumer)
 	in_.set_consumer(consumer);
 }
 
-void channel::clear()
+void channel::clear(std::size_t max_retained_capacity)
 {
 	scoped_lock lock(mutex_);
 
-	out_.clear();
-	in_.clear();
+	out_.clear(max_retained_capacity);
+	in_.clear(max_retained_capacity);
 	sa_.set_socket(nullptr);
 }
 
@@ -62,7 +62,8 @@ namespace fz {
 		void set_buffer_adder(buffer_operator::adder_interface *adder, bool wait_for_empty_buffer_on_eof = true);
 		void set_buffer_consumer(buffer_operator::consumer_interface *consumer);
 
-		void clear();
+		//! Clears the buffers, releasing their memory if their capacity exceeds the given one.
+		void clear(std::size_t max_retained_capacity = std::numeric_limits<std::size_t>::max());
 
 		void shutdown(int err = 0);
 
@@ -7,6 +7,8 @@ namespace fz {
 event_loop_pool::event_loop_pool(fz::event_loop &main_loop, fz::thread_pool &pool, uint32_t max_num_of_loops)
 	: main_loop_(main_loop)
 	, pool_(pool)
+	, main_loop_timer_wheel_(main_loop)
+	, main_loop_rate_limit_manager_(main_loop)
 {
 	set_max_num_of_loops(max_num_of_loops);
 }
@@ -22,6 +24,9 @@ void event_loop_pool::set_max_num_of_loops(std::uint32_t max)
 
 		while (loops_.size() < max_num_of_loops_) {
 			loops_.push_back(std::make_unique<event_loop>(pool_));
+			sessions_gauges_.push_back(&metrics::registry::global().get_gauge("fz_event_loop_sessions", "Number of sessions running in each event loop.", {{"loop", std::to_string(loops_.size())}}));
+			timer_wheels_.push_back(std::make_unique<timer_wheel>(*loops_.back()));
+			rate_limit_managers_.push_back(std::make_unique<rate_limit_manager>(*loops_.back()));
 		}
 	}
 }
@@ -34,9 +39,41 @@ event_loop &event_loop_pool::get_loop()
 	return main_loop_;
 }
 
+metrics::gauge &event_loop_pool::get_sessions_gauge(const event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	for (std::size_t i = 0; i < loops_.size(); ++i) {
+		if (loops_[i].get() == &loop)
+			return *sessions_gauges_[i];
+	}
+
+	static auto &main_loop_gauge = metrics::registry::global().get_gauge("fz_event_loop_sessions", "Number of sessions running in each event loop.", {{"loop", "main"}});
+	return main_loop_gauge;
 }
 
+timer_wheel &event_loop_pool::get_timer_wheel(const event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	for (std::size_t i = 0; i < loops_.size(); ++i) {
+		if (loops_[i].get() == &loop)
+			return *timer_wheels_[i];
+	}
+
+	return main_loop_timer_wheel_;
+}
 
+rate_limit_manager &event_loop_pool::get_rate_limit_manager(const event_loop &loop)
+{
+	scoped_lock lock(mutex_);
 
+	for (std::size_t i = 0; i < loops_.size(); ++i) {
+		if (loops_[i].get() == &loop)
+			return *rate_limit_managers_[i];
+	}
 
+	return main_loop_rate_limit_manager_;
+}
 
+}
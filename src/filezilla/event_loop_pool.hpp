@@ -2,8 +2,12 @@
 #define FZ_EVENT_LOOP_POOL_HPP
 
 #include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/rate_limiter.hpp>
 #include <libfilezilla/thread_pool.hpp>
 
+#include "metrics/registry.hpp"
+#include "timer_wheel.hpp"
+
 namespace fz {
 
 class event_loop_pool
@@ -14,6 +18,16 @@ public:
 	void set_max_num_of_loops(std::uint32_t max);
 	event_loop &get_loop();
 
+	//! \returns the gauge that counts the sessions running in the given loop, which must belong to the pool.
+	metrics::gauge &get_sessions_gauge(const event_loop &loop);
+
+	//! \returns the timer wheel the sessions running in the given loop, which must belong to the pool, share for their timeouts.
+	timer_wheel &get_timer_wheel(const event_loop &loop);
+
+	//! \returns the manager of the rate limiters that belong to single sessions running in the given loop, which must belong to the pool,
+	//! so that those limiters are refilled, and their sockets woken up, in the loop the sessions run in.
+	rate_limit_manager &get_rate_limit_manager(const event_loop &loop);
+
 private:
 	fz::mutex mutex_;
 
@@ -21,6 +35,13 @@ private:
 	thread_pool &pool_;
 	std::uint32_t max_num_of_loops_;
 	std::vector<std::unique_ptr<event_loop>> loops_;
+	std::vector<metrics::gauge *> sessions_gauges_;
+
+	// Must be destroyed before the loops they belong to.
+	timer_wheel main_loop_timer_wheel_;
+	std::vector<std::unique_ptr<timer_wheel>> timer_wheels_;
+	rate_limit_manager main_loop_rate_limit_manager_;
+	std::vector<std::unique_ptr<rate_limit_manager>> rate_limit_managers_;
 };
 
 }
@@ -1,149 +1,234 @@
+#include <cstring>
+
 #include <libfilezilla/util.hpp>
 
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
 #include "ascii_layer.hpp"
+#include "../util/bits.hpp"
 
 namespace fz::ftp {
 
-ascii_layer::ascii_layer(event_handler *handler, socket_interface &next_layer)
-	: socket_layer{handler, next_layer, true}
-{}
+namespace {
 
-int ascii_layer::read(void *buffer, unsigned int size, int &error)
+// Returns a pointer to the first occurrence of ch in [begin, end), or end if there's none.
+// Line endings are rather sparse in the data, hence most of the time is spent here: look at the data in vectors, where available.
+const char *find_char(const char *begin, const char *end, char ch)
 {
-#if 1
-	static constexpr const char crlf_begin[] = { '\r', '\n' };
-	static constexpr const char *crlf_end = crlf_begin + 2;
+#if defined(__AVX2__)
+	auto needle32 = _mm256_set1_epi8(ch);
 
-	char *begin = reinterpret_cast<char*>(buffer);
-	char *end;
-	int read;
+	for (; end - begin >= 32; begin += 32) {
+		auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
 
-	do {
-		if (tmp_read_.has_value() && size > 0) {
-			*begin = *tmp_read_;
+		if (auto mask = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32))))
+			return begin + util::count_trailing_zeros(mask);
+	}
+#endif
 
-			if (size > 1) {
-				read = next_layer_.read(begin + 1, size - 1, error);
+#if defined(__SSE2__)
+	auto needle16 = _mm_set1_epi8(ch);
 
-				if (read < 0)
-					return read;
+	for (; end - begin >= 16; begin += 16) {
+		auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
 
-				if (read == 0) {
-					tmp_read_.reset();
-					return 1;
-				}
+		if (auto mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16))))
+			return begin + util::count_trailing_zeros(mask);
+	}
+#elif defined(__ARM_NEON)
+	auto needle16 = vdupq_n_u8(std::uint8_t(ch));
 
-				read += 1;
-			}
-			else {
-				char ch;
-				read = next_layer_.read(&ch, 1, error);
+	for (; end - begin >= 16; begin += 16) {
+		auto eq = vceqq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t *>(begin)), needle16);
 
-				if (read < 0)
-					return read;
+		// Narrows the comparison result down to 4 bits per byte.
+		auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
 
-				if (read == 0) {
-					tmp_read_.reset();
-				}
-				else
-				if (ch == '\n' && *begin == '\r') {
-					*begin = '\n';
+		if (mask)
+			return begin + util::count_trailing_zeros(std::uint64_t(mask)) / 4;
+	}
+#endif
 
-					tmp_read_.reset();
-				}
-				else
-					tmp_read_.emplace(ch);
+	while (begin != end && *begin != ch)
+		++begin;
 
-				return 1;
-			}
+	return begin;
+}
 
-		}
-		else {
-			read = next_layer_.read(begin, size, error);
+// Removes, in place, the CR's that precede a LF. A CR at the very end of the data is removed too, and reported via trailing_cr,
+// for it's not known yet whether a LF follows it.
+// Returns the new size of the data.
+std::size_t strip_crs(char *data, std::size_t size, bool &trailing_cr)
+{
+	const char *end = data + size;
+	const char *in = data;
+	char *out = data;
 
-			if (read <= 0)
-				return read;
+	trailing_cr = false;
+
+	while (true) {
+		auto cr = find_char(in, end, '\r');
+
+		if (out != in)
+			std::memmove(out, in, std::size_t(cr - in));
+
+		out += cr - in;
+
+		if (cr == end)
+			break;
+
+		if (cr + 1 == end) {
+			trailing_cr = true;
+			break;
 		}
 
-		// Invariant: read > 0
+		if (cr[1] != '\n')
+			*out++ = '\r';
 
-		end = begin + read;
+		in = cr + 1;
+	}
 
-		// Use std algos to eliminate the excess CR's.
+	return std::size_t(out - data);
+}
 
-		int crlf_count = 0;
-		if (auto crlf_it1 = std::search(begin, end, crlf_begin, crlf_end); crlf_it1 != end) {
-			do {
-				auto crlf_it2 = std::search(crlf_it1+2, end, crlf_begin, crlf_end);
-				std::copy(crlf_it1+1, crlf_it2, crlf_it1-crlf_count++);
-				crlf_it1 = crlf_it2;
-			} while (crlf_it1 != end);
+// Copies the data from in to out, putting a CR before each LF that isn't already preceded by one.
+// last_ch is the last character copied by the previous invocation, and gets updated.
+// out must be able to hold twice as many bytes as there are in the input.
+// Returns the number of bytes written to out.
+std::size_t add_crs(const char *in, std::size_t size, char *out, char &last_ch)
+{
+	const char *end = in + size;
+	char *out_begin = out;
+
+	while (in != end) {
+		auto lf = find_char(in, end, '\n');
+
+		if (lf != in) {
+			std::memcpy(out, in, std::size_t(lf - in));
+			out += lf - in;
+			last_ch = lf[-1];
 		}
 
-		read -= crlf_count;
+		if (lf == end)
+			break;
+
+		if (last_ch != '\r')
+			*out++ = '\r';
+
+		*out++ = last_ch = '\n';
+		in = lf + 1;
+	}
+
+	return std::size_t(out - out_begin);
+}
+
+// Returns how many bytes of the input to add_crs() make up the first written bytes of its output.
+std::size_t count_consumed(const char *in, std::size_t size, std::size_t written, char last_ch)
+{
+	const char *end = in + size;
+	std::size_t added_crs = 0;
+
+	for (auto lf = find_char(in, end, '\n'); lf != end; lf = find_char(lf + 1, end, '\n')) {
+		auto pos = std::size_t(lf - in);
+
+		if (pos + added_crs >= written)
+			break;
+
+		if ((pos == 0 ? last_ch : lf[-1]) != '\r') {
+			if (pos + added_crs + 1 >= written) {
+				// Only the added CR has been written out, not the LF.
+				added_crs += 1;
+				break;
+			}
+
+			added_crs += 1;
+		}
+	}
 
-		// Invariant: read > 0, still, because crlf_count is *at most* equal to integer read/2.
+	return written - added_crs;
+}
 
-		read -= 1;
-		tmp_read_.emplace(begin[read]);
+}
 
-		// If the only byte we've produced ended up in the side buffer tmp_read_, then we ought to put it back into
-		// the user buffer and try to get more data from next_layer_, or an EOF. Either way, read will be >= 1 and we won't repeat this cycle yet again.
-	}  while (read == 0);
+ascii_layer::ascii_layer(event_handler *handler, socket_interface &next_layer)
+	: socket_layer{handler, next_layer, true}
+{}
 
-	return signed(read);
-#else
-	int res;
-	do {
-		res = next_layer_.read(buffer, size, error);
-		if (res < 0)
-			return res;
+int ascii_layer::read(void *buffer, unsigned int size, int &error)
+{
+	if (size == 0)
+		return next_layer_.read(buffer, size, error);
 
-		auto begin = static_cast<char *>(buffer);
-		auto end = begin+res;
+	char *begin = reinterpret_cast<char*>(buffer);
 
-		auto write_cur = begin;
-		auto read_cur = begin;
+	while (true) {
+		// tmp_read_ holds a byte that's been read but not yet delivered: a CR that might be followed by a LF, usually.
+		unsigned int prefix = tmp_read_.has_value() ? 1 : 0;
 
-		if (tmp_read_) {
-			if (res == 0 && size > 0) {
-				// EOF was reached while having something in tmp_read_
-				*write_cur = *tmp_read_;
-				tmp_read_ = std::nullopt;
+		if (prefix && size == 1) {
+			if (*tmp_read_ != '\r') {
+				*begin = *tmp_read_;
+				tmp_read_.reset();
 				return 1;
 			}
 
-			has_tmp_read:
-			while (read_cur < end) {
-				auto &ch = *write_cur++ = *read_cur++;
+			char ch;
+			int read = next_layer_.read(&ch, 1, error);
+
+			if (read < 0)
+				return read;
 
-				if (ch == '\n' && *tmp_read_ == '\r') {
-					tmp_read_ = std::nullopt;
-					goto hasnt_tmp_read;
-				}
+			if (read == 0 || ch != '\n') {
+				*begin = '\r';
 
-				std::swap(*tmp_read_, ch);
+				if (read == 0)
+					tmp_read_.reset();
+				else
+					tmp_read_.emplace(ch);
 			}
+			else {
+				*begin = '\n';
+				tmp_read_.reset();
+			}
+
+			return 1;
 		}
-		else {
-			hasnt_tmp_read:
-			while (read_cur < end) {
-				auto ch = *read_cur++;
 
-				if (ch == '\r') {
-					tmp_read_ = '\r';
-					goto has_tmp_read;
-				}
+		int read = next_layer_.read(begin + prefix, size - prefix, error);
 
-				*write_cur++ = ch;
-			}
+		if (read < 0)
+			return read;
+
+		if (prefix) {
+			*begin = *tmp_read_;
+			tmp_read_.reset();
 		}
 
-		res = signed(write_cur - begin);
-	} while (res == 0 && tmp_read_);
+		if (read == 0)
+			// EOF: whatever was held back is delivered as it is.
+			return signed(prefix);
 
-	return res;
-#endif
+		bool trailing_cr;
+		auto converted = strip_crs(begin, prefix + unsigned(read), trailing_cr);
+
+		if (trailing_cr)
+			tmp_read_.emplace('\r');
+
+		// If the only byte produced has ended up in tmp_read_, try to get more data from next_layer_, or an EOF.
+		// Either way, the next round will produce at least one byte.
+		if (converted > 0)
+			return signed(converted);
+	}
 }
 
 int ascii_layer::write(const void *from, unsigned int size, int &error)
@@ -159,47 +244,34 @@ int ascii_layer::write(const void *from, unsigned int size, int &error)
 	if (size > size_cap)
 		size = size_cap;
 
-	auto read_begin = reinterpret_cast<const unsigned char *>(from);
-	auto read_end = read_begin+size;
-	auto read_cur = read_begin;
-
-	auto write_begin = tmp_write_.get(size*2);
-	auto write_cur = write_begin;
+	auto in = reinterpret_cast<const char *>(from);
 
-	crpos_.clear();
+	// The buffer's capacity is retained across invocations, hence this doesn't allocate in the steady state.
+	auto out = reinterpret_cast<char *>(tmp_write_.get(std::size_t(size)*2));
 
-	while (read_cur != read_end) {
-		auto ch = *read_cur++;
+	char last_ch = char(last_written_ch_);
+	auto size_w = add_crs(in, size, out, last_ch);
 
-		if (ch == '\n' && last_written_ch_ != '\r') {
-			crpos_.emplace_back(write_cur-write_begin);
-			*write_cur++ = '\r';
-		}
-
-		last_written_ch_ = *write_cur++ = ch;
-	}
-
-	auto size_w = write_cur-write_begin;
-
-	int written = next_layer_.write(tmp_write_.get(), unsigned(size_w), error);
+	int written = next_layer_.write(out, unsigned(size_w), error);
 	if (written <= 0)
 		return written;
 
 	// If the number of bytes written from the buffer is less than the number of bytes in the buffer, then
-	// we need to report back to the caller an amount of bytes written which is less than what the caller asked us to write.
-	// Since we might have written out more CR's than there were in the initial data, the amount we need to report back to the caller is:
-	// the number of bytes written minus the number of CR's written.
-	if (written < size_w) {
-		last_written_ch_ = *--write_cur;
-
-		// Find the largest element in crpos whose value <= written. This element's index+1 will be equal to the number of CR's written out.
-		auto it = std::upper_bound(crpos_.crbegin(), crpos_.crend(), written, [](int a, int b) { return a >= b; });
-
-		// the distance between the begin of the vector and the base of a reverse iterator into the vector already contains the +1.
-		written -= std::distance(crpos_.cbegin(), it.base());
-
-		size = unsigned(written);
+	// we need to report back to the caller an amount of bytes written which is less than what the caller asked us to write:
+	// the number of bytes written minus the number of CR's we've added to them.
+	if (std::size_t(written) < size_w) {
+		auto consumed = unsigned(count_consumed(in, size, std::size_t(written), char(last_written_ch_)));
+		last_written_ch_ = static_cast<unsigned char>(out[written-1]);
+
+		// Only the CR added before a LF has been written out. Returning 0 would signal a closed connection:
+		// try again, now that the CR is accounted for, the LF goes out alone.
+		if (consumed == 0)
+			return write(from, size, error);
+
+		size = consumed;
 	}
+	else
+		last_written_ch_ = static_cast<unsigned char>(last_ch);
 
 	return signed(size);
 }
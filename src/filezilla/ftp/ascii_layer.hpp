@@ -24,7 +24,6 @@ private:
 	std::optional<char> tmp_read_{};
 	unsigned char last_written_ch_{};
 	buffer tmp_write_{};
-	std::vector<int> crpos_{};
 };
 
 }
@@ -25,6 +25,104 @@ namespace {
 		return {'"', fz::replaced_substrings(str, "\"", "\"\""), '"'};
 	}
 
+	// Paths are separated by spaces. Paths containing spaces must be enclosed in double quotes,
+	// the double quotes within them being doubled, the same way quote() does.
+	bool parse_path_list(std::string_view arg, std::vector<std::string> &paths)
+	{
+		for (std::size_t i = 0; i < arg.size();) {
+			if (arg[i] == ' ') {
+				++i;
+				continue;
+			}
+
+			std::string path;
+
+			if (arg[i] == '"') {
+				for (++i;; ++i) {
+					if (i == arg.size())
+						return false;
+
+					if (arg[i] == '"') {
+						if (i+1 < arg.size() && arg[i+1] == '"')
+							++i;
+						else
+							break;
+					}
+
+					path.push_back(arg[i]);
+				}
+
+				++i;
+
+				if (i < arg.size() && arg[i] != ' ')
+					return false;
+			}
+			else {
+				auto end = std::min(arg.find(' ', i), arg.size());
+				path = arg.substr(i, end-i);
+				i = end;
+			}
+
+			paths.push_back(std::move(path));
+		}
+
+		return !paths.empty();
+	}
+
+	// Lists the supported algorithms, the selected one marked with an asterisk.
+	std::string hash_feat(hash_engine::algorithm selected)
+	{
+		std::string feat;
+
+		for (auto algo: { hash_engine::algorithm::sha1, hash_engine::algorithm::sha256, hash_engine::algorithm::sha512, hash_engine::algorithm::md5, hash_engine::algorithm::crc32 }) {
+			if (!feat.empty())
+				feat.append(1, ';');
+
+			feat.append(hash_engine::to_string(algo));
+
+			if (algo == selected)
+				feat.append(1, '*');
+		}
+
+		return feat;
+	}
+
+	// The X* hashing commands take the path, optionally followed by the start and the end offsets of the range to hash.
+	bool parse_hash_arg(std::string_view arg, std::string &path, std::int64_t &begin, std::int64_t &end)
+	{
+		std::int64_t offsets[2];
+		std::size_t num_offsets = 0;
+
+		while (num_offsets < 2) {
+			auto pos = arg.rfind(' ');
+			if (pos == std::string_view::npos)
+				break;
+
+			auto v = fz::to_integral<std::int64_t>(arg.substr(pos+1), -1);
+			if (v < 0)
+				break;
+
+			offsets[num_offsets++] = v;
+			arg = fz::trimmed(arg.substr(0, pos));
+		}
+
+		begin = num_offsets == 2 ? offsets[1] : num_offsets == 1 ? offsets[0] : 0;
+		end = num_offsets == 2 ? offsets[0] : -1;
+
+		if (!arg.empty() && arg[0] == '"') {
+			std::vector<std::string> paths;
+
+			if (!parse_path_list(arg, paths) || paths.size() != 1)
+				return false;
+
+			path = std::move(paths[0]);
+		}
+		else
+			path = arg;
+
+		return !path.empty() && (end < 0 || begin <= end);
+	}
+
 	struct line_ender{};
 	static constexpr line_ender endl{};
 
@@ -96,7 +194,7 @@ public:
 
 		out_ << eol;
 
-		commander_.act_upon_command_reply(static_cast<command_reply>(xyz_[0]-'0'));
+		commander_.act_upon_command_reply(static_cast<command_reply>(xyz_[0]-'0'), (xyz_[0]-'0')*100 + (xyz_[1]-'0')*10 + (xyz_[2]-'0'));
 	}
 
 	responder(const responder &) = delete;
@@ -142,11 +240,14 @@ bool commander::async_abortable_receive::is_pending() const
 }
 
 template <typename F>
-auto commander::async_abortable_receive::operator >>(F && f)
+auto commander::async_abortable_receive::wrap(F && f)
 {
 	state_ = pending;
+	owner_.trace_.phase("filesystem");
+
+	return [this, f=std::forward<F>(f)](auto &&... args) {
+		owner_.trace_.phase({});
 
-	return async_receive::operator>>([this, f=std::forward<F>(f)](auto &&... args) {
 		if (state_ == pending_abort)
 			owner_.consumer::send_event(0);
 		else {
@@ -157,10 +258,17 @@ auto commander::async_abortable_receive::operator >>(F && f)
 		}
 
 		state_ = idle;
-	});
+	};
+}
+
+template <typename F>
+auto commander::async_abortable_receive::operator >>(F && f)
+{
+	return async_receive::operator>>(wrap(std::forward<F>(f)));
 }
 
-commander::commander(event_loop &loop, controller &co, tvfs::engine &tvfs, notifier &notifier,
+commander::commander(event_loop &loop, controller &co, tvfs::engine &tvfs, hash_engine &hash_engine, small_file_cache &small_file_cache, timer_wheel &timer_wheel, notifier &notifier,
+					 tcp::session::id session_id,
 					 monotonic_clock &last_activity,
 					 bool needs_security_before_user_cmd,
 					 const welcome_message_t &welcome_message, const std::string &refuse_message,
@@ -171,7 +279,11 @@ commander::commander(event_loop &loop, controller &co, tvfs::engine &tvfs, notif
 	, channel_{*this, max_line_size, 5, false, *this, 0}
 	, controller_{co}
 	, tvfs_{tvfs}
+	, hash_engine_{hash_engine}
+	, small_file_cache_{small_file_cache}
+	, timer_wheel_{timer_wheel}
 	, notifier_{notifier}
+	, session_id_{session_id}
 	, welcome_message_(welcome_message)
 	, refuse_message_(refuse_message)
 	, logger_{logger}
@@ -182,8 +294,15 @@ commander::commander(event_loop &loop, controller &co, tvfs::engine &tvfs, notif
 
 commander::~commander()
 {
+	// Sessions are destroyed from outside of their loop, where the timeout might be expiring right now.
+	timeout_.disarm();
+
 	remove_handler();
 	stop_receiving();
+
+	// An upload might have been interrupted by the session going away.
+	if (data_ops_)
+		data_ops_->file_writer.finalize();
 }
 
 void commander::set_socket(socket_interface *si)
@@ -230,31 +349,70 @@ void commander::set_socket(socket_interface *si)
 	}
 }
 
+void commander::set_upload_options(buffer_operator::file_writer::options opts)
+{
+	upload_opts_ = opts;
+
+	if (data_ops_)
+		data_ops_->file_writer.set_options(opts);
+}
+
+void commander::set_download_options(buffer_operator::file_reader::options opts)
+{
+	download_opts_ = opts;
+
+	if (data_ops_)
+		data_ops_->file_reader.set_options(opts);
+}
+
+commander::data_operators::data_operators(commander &c)
+	: facts_lister{c.event_loop_, c.entries_iterator_, c.enabled_facts_}
+	, stats_lister{c.event_loop_, c.entries_iterator_, c.stats_context_}
+	, names_lister{c.event_loop_, c.entries_iterator_, c.names_prefix_}
+	, file_reader{c.file_, 128*1024, c.download_opts_}
+	, cached_file_reader{128*1024}
+	, file_writer{c.file_, c.upload_opts_}
+	, multi_file_reader{c.event_loop_, c.tvfs_, c.notifier_, 128*1024}
+	, multi_file_writer{c.event_loop_, c.tvfs_, c.notifier_}
+{}
+
+commander::data_operators &commander::data_ops()
+{
+	if (!data_ops_)
+		data_ops_ = std::make_unique<data_operators>(*this);
+
+	return *data_ops_;
+}
+
+void commander::release_data_resources()
+{
+	if (is_executing_command())
+		return;
+
+	data_ops_.reset();
+}
+
 void commander::set_timeouts(const duration &login_timeout, const duration &activity_timeout)
 {
 	login_timeout_ = login_timeout;
 	activity_timeout_ = activity_timeout;
 
-	stop_timer(timer_id_);
-	timer_id_ = 0;
+	timeout_.disarm();
 
 	if (channel_.get_socket()) {
 		if (!controller_.is_authenticated()) {
 			if (login_timeout)
-				timer_id_ = add_timer(start_time_ + login_timeout - fz::monotonic_clock::now(), true);
+				timer_wheel_.arm(timeout_, start_time_ + login_timeout - fz::monotonic_clock::now());
 		}
 		else
 		if (activity_timeout) {
-			timer_id_ = add_timer(last_activity_ + activity_timeout - fz::monotonic_clock::now(), true);
+			timer_wheel_.arm(timeout_, last_activity_ + activity_timeout - fz::monotonic_clock::now());
 		}
 	}
 }
 
-void commander::on_timer_event(timer_id id)
+void commander::on_timeout()
 {
-	if (id != timer_id_)
-		return;
-
 	const auto timeout = [this](const char *msg) {
 		if (controller_.is_securing())
 			return controller_.quit(ETIMEDOUT);
@@ -273,7 +431,8 @@ void commander::on_timer_event(timer_id id)
 	if (delta >= activity_timeout_)
 		return timeout("Activity timeout.");
 
-	timer_id_ = add_timer(activity_timeout_ - delta, true);
+	// The activity is not tracked by re-arming the timeout at each read and write, it's checked upon here instead.
+	timer_wheel_.arm(timeout_, activity_timeout_ - delta);
 }
 
 void commander::shutdown(int err)
@@ -293,15 +452,27 @@ bool commander::has_empty_buffers()
 
 bool commander::is_executing_command() const
 {
-	return current_cmd_ != commands_.cend();
+	return current_cmd_ != commands_.cend() || !pipeline_.empty();
 }
 
-void commander::act_upon_command_reply(command_reply reply)
+void commander::act_upon_command_reply(command_reply reply, int code)
 {
 	if (reply != positive_preliminary_reply) {
+		// ALLO only applies to the command that follows it.
+		if (!CUR_FTP_CMD_IS(ALLO))
+			allo_size_ = 0;
+
 		// Command has finished execution.
 		current_cmd_ = commands_.cend();
+		trace_.end(code ? code : int(reply)*100);
 
+		if (!pipeline_.empty()) {
+			// The queued command, if any, must wait for the pipeline to be drained.
+			invoke_later([this] {
+				execute_next_pipelined_cmd();
+			});
+		}
+		else
 		if (a_cmd_has_been_queued_) {
 			// Inform the consumer it can start dequeing commands again;
 			a_cmd_has_been_queued_ = false;
@@ -367,6 +538,66 @@ int commander::queue_new_cmd()
 	return EAGAIN;
 }
 
+bool commander::can_be_pipelined(decltype(commands_)::const_iterator cmd, std::string_view arg) const
+{
+	// Everything in the pipeline is pipelineable, thus it's enough to check the command currently executing.
+	bool current_is_pipelineable = current_cmd_ == commands_.cend() || (current_cmd_->second.flags & pipelineable);
+
+	return
+		(cmd->second.flags & pipelineable) &&
+		current_is_pipelineable &&
+		pipeline_.size() < max_pipelined_cmds &&
+		!(cmd->second.flags & needs_arg && arg.empty()) &&
+		controller_.is_authenticated();
+}
+
+int commander::pipeline_cmd(decltype(commands_)::const_iterator cmd, std::string_view arg)
+{
+	auto &p = pipeline_.emplace_back(pipelined_cmd{cmd, std::string(arg), std::make_shared<prefetched_entry>()});
+
+	tvfs_.async_get_entry(p.arg, async_receive(this) >> [pe = p.entry](result res, tvfs::entry &e) {
+		pe->res = res;
+		pe->entry = std::move(e);
+		pe->ready = true;
+
+		if (pe->waiter)
+			std::exchange(pe->waiter, nullptr)(pe->res, pe->entry);
+	});
+
+	return 0;
+}
+
+void commander::execute_next_pipelined_cmd()
+{
+	if (pipeline_.empty() || current_cmd_ != commands_.cend())
+		return;
+
+	auto p = std::move(pipeline_.front());
+	pipeline_.pop_front();
+
+	current_cmd_ = p.cmd;
+	trace_.begin(session_id_, current_cmd_->first);
+
+	prefetched_ = std::move(p.entry);
+	(this->*current_cmd_->second.func)(p.arg);
+	prefetched_ = nullptr;
+}
+
+template <typename F>
+void commander::async_get_entry(std::string_view path, F &&f)
+{
+	if (auto pe = std::move(prefetched_)) {
+		if (pe->ready)
+			return f(pe->res, pe->entry);
+
+		// The prefetch is still in flight: make the wait abortable, just like a lookup of our own would be.
+		pe->waiter = async_receive_.wrap(std::forward<F>(f));
+		return;
+	}
+
+	tvfs_.async_get_entry(path, async_receive_ >> std::forward<F>(f));
+}
+
 int commander::process_buffer_line(buffer_string_view line, bool there_is_more_data_to_come)
 {
 	if (!channel_.get_socket()) {
@@ -407,10 +638,17 @@ int commander::process_buffer_line(buffer_string_view line, bool there_is_more_d
 		}
 
 		if (new_cmd != ABOR_cmd_) {
-			if (is_executing_command())
+			if (is_executing_command()) {
+				if (can_be_pipelined(new_cmd, arg))
+					return pipeline_cmd(new_cmd, arg);
+
 				return queue_new_cmd();
+			}
 		}
 		else {
+			if (!pipeline_.empty())
+				return queue_new_cmd();
+
 			if (CUR_FTP_CMD_IS(ABOR) || CUR_FTP_CMD_IS(USER) || CUR_FTP_CMD_IS(PASS))
 				return queue_new_cmd();
 
@@ -423,6 +661,7 @@ int commander::process_buffer_line(buffer_string_view line, bool there_is_more_d
 		}
 
 		current_cmd_ = new_cmd;
+		trace_.begin(session_id_, current_cmd_->first);
 
 		if (current_cmd_->second.flags & needs_arg && arg.empty()) {
 			respond<501>() << "Missing required argument";
@@ -467,11 +706,9 @@ void commander::operator()(const event_base &event)
 		return;
 
 	fz::dispatch<
-		channel::done_event,
-		timer_event
+		channel::done_event
 	>(event, this,
-		&commander::on_channel_done_event,
-		&commander::on_timer_event
+		&commander::on_channel_done_event
 	);
 }
 
@@ -517,6 +754,14 @@ FTP_CMD(FEAT) {
 		<< "EPSV" << endl
 		<< "EPRT" << endl
 		<< "MFMT" << endl
+		<< "MRTR" << endl
+		<< "MSTR" << endl
+		<< "HASH" << hash_feat(hash_algorithm_) << endl
+		<< "XCRC" << endl
+		<< "XMD5" << endl
+		<< "XSHA1" << endl
+		<< "XSHA256" << endl
+		<< "XSHA512" << endl
 		<< "End";
 }
 
@@ -535,6 +780,21 @@ FTP_CMD(OPTS) {
 		}
 	}
 	else
+	if (!opts.empty() && opts.size() <= 2 && equal_insensitive_ascii(opts[0], "HASH")) {
+		if (opts.size() == 2) {
+			auto algo = hash_engine::from_string(opts[1]);
+			if (!algo) {
+				respond<501>() << "Unknown algorithm.";
+				return;
+			}
+
+			hash_algorithm_ = *algo;
+		}
+
+		respond<200>() << hash_engine::to_string(hash_algorithm_);
+		return;
+	}
+	else
 	if (!opts.empty() && opts.size() <= 2 && equal_insensitive_ascii(opts[0], "MLST")) {
 		enabled_facts_ = {};
 
@@ -561,6 +821,7 @@ FTP_CMD(USER) {
 
 	// Let's get the list of auth methods, with this.
 	// We'll send the response to the user from within the handle_authenticate_user_response method below.
+	trace_.phase("authentication");
 	controller_.authenticate_user(user_, {}, this);
 }
 
@@ -579,10 +840,9 @@ FTP_CMD(PASS) {
 		// This should never happen, it's a program logic error.
 		return handle_authenticate_user_response(std::move(auth_op_));
 
-	if (timer_id_) {
-		stop_timer(timer_id_);
-		timer_id_ = 0;
-	}
+	timeout_.disarm();
+
+	trace_.phase("authentication");
 
 	if (!next(std::move(auth_op_), {authentication::method::password{std::string(arg)}})) {
 		logger_.log_raw(logmsg::error, L"Whoopsie, the authenticator just disappeared!");
@@ -592,6 +852,8 @@ FTP_CMD(PASS) {
 
 void commander::handle_authenticate_user_response(std::unique_ptr<authentication::authenticator::operation> &&op)
 {
+	trace_.phase({});
+
 	auto error = [&](auto e) {
 		user_ = {};
 		stop(std::move(op));
@@ -612,11 +874,10 @@ void commander::handle_authenticate_user_response(std::unique_ptr<authentication
 		notifier_.notify_user_name(user_);
 		stop(std::move(op));
 
-		if (timer_id_)
-			stop_timer(timer_id_);
+		timeout_.disarm();
 
 		if (activity_timeout_)
-			timer_id_ = add_timer(activity_timeout_, true);
+			timer_wheel_.arm(timeout_, activity_timeout_);
 
 		if (controller_.get_alpn() == "x-filezilla-ftp"sv)
 			controller_.set_data_protection_mode(controller::data_protection_mode::P);
@@ -679,14 +940,21 @@ FTP_CMD(AUTH) {
 	controller_.make_secure("234 Using authentication type TLS.\r\n", this);
 }
 
-void commander::handle_make_secure_response(bool can_secure)
+void commander::handle_make_secure_response(controller::make_secure_result result)
 {
-	if (can_secure) {
-		act_upon_command_reply(command_reply::positive_completion_reply);
-		logger_.log_u(logmsg::reply, L"234 Using authentication type TLS.");
-	}
-	else {
-		respond<504>() << "TLS handshaking failed!";
+	switch (result) {
+		case controller::make_secure_result::can_secure:
+			act_upon_command_reply(command_reply::positive_completion_reply);
+			logger_.log_u(logmsg::reply, L"234 Using authentication type TLS.");
+			break;
+
+		case controller::make_secure_result::failed:
+			respond<504>() << "TLS handshaking failed!";
+			break;
+
+		case controller::make_secure_result::too_busy:
+			respond<431>() << "Too many TLS handshakes in progress, try again later.";
+			break;
 	}
 }
 
@@ -756,6 +1024,9 @@ FTP_CMD(ABOR) {
 	if (!stop_processing_nested_adder()) {
 		auto data_connection_status = controller_.close_data_connection();
 
+		if (data_connection_status != controller::data_connection_status::not_started && data_ops_)
+			data_ops_->file_writer.finalize();
+
 		if (data_connection_status == controller::data_connection_status::started)
 			respond<426>() << "Data connection closed; transfer aborted.";
 		else
@@ -763,7 +1034,7 @@ FTP_CMD(ABOR) {
 			respond<426>() << "Command aborted.";
 
 		if (data_connection_status != controller::data_connection_status::not_started)
-			notifier_.notify_entry_close(1, ECONNABORTED);
+			close_transferred_entry(cmd_being_aborted_, ECONNABORTED);
 	}
 
 	respond<226>() << "ABOR command successful.";
@@ -839,6 +1110,7 @@ FTP_CMD(PASV) {
 		return;
 	}
 
+	trace_.phase("data_listen");
 	controller_.get_data_local_info(address_type::ipv4, true, *this);
 }
 
@@ -864,11 +1136,14 @@ FTP_CMD(EPSV) {
 		}
 	}
 
+	trace_.phase("data_listen");
 	controller_.get_data_local_info(family, false, *this);
 }
 
 void commander::handle_data_local_info(const std::optional<std::pair<std::string, uint16_t>> &info)
 {
+	trace_.phase({});
+
 	if (!info) {
 		respond<425>() << "Cannot prepare for data connection.";
 		return;
@@ -963,7 +1238,7 @@ FTP_CMD(MODE) {
 }
 
 FTP_CMD(MLST) {
-	tvfs_.async_get_entry(arg, async_receive_ >> [this, arg = std::string(arg)](result result, tvfs::entry &e) {
+	async_get_entry(arg, [this, arg = std::string(arg)](result result, tvfs::entry &e) {
 		if (!result) {
 			respond<550>() << to_string_view(result);
 			return;
@@ -987,7 +1262,8 @@ FTP_CMD(MLSD) {
 		}
 
 		notifier_.notify_entry_open(1, path, -1);
-		controller_.start_data_transfer(facts_lister_, this, true);
+		trace_.phase("data_connection");
+		controller_.start_data_transfer(data_ops().facts_lister, this, true);
 	});
 }
 
@@ -1028,7 +1304,9 @@ FTP_CMD(LIST) {
 		}
 
 		notifier_.notify_entry_open(1, path, -1);
-		controller_.start_data_transfer(stats_lister_.prepend_space(false), this, true);
+		stats_context_.reset();
+		trace_.phase("data_connection");
+		controller_.start_data_transfer(data_ops().stats_lister.prepend_space(false), this, true);
 	});
 }
 
@@ -1048,16 +1326,31 @@ FTP_CMD(NLST) {
 			names_prefix_ += '/';
 
 		notifier_.notify_entry_open(1, path, -1);
-		controller_.start_data_transfer(names_lister_, this, true);
+		trace_.phase("data_connection");
+		controller_.start_data_transfer(data_ops().names_lister, this, true);
 	});
 }
 
+void commander::close_transferred_entry(decltype(commands_)::const_iterator cmd, int error)
+{
+	if (cmd == MSTR_cmd_)
+		data_ops().multi_file_writer.abort(error);
+	else
+	if (cmd == MRTR_cmd_)
+		data_ops().multi_file_reader.abort(error);
+	else
+		notifier_.notify_entry_close(1, error);
+}
+
 void commander::handle_data_transfer(data_transfer_handler::status st, channel::error_type error, std::string_view msg)
 {
 	if (error) {
 		std::string error_string = msg.empty() ? fz::to_utf8(socket_error_description(error)) : std::string(msg);
 
-		notifier_.notify_entry_close(1, error);
+		// Whatever got uploaded so far is kept, without the space preallocated for the rest.
+		if (data_ops_)
+			data_ops_->file_writer.finalize();
+		close_transferred_entry(current_cmd_, error);
 
 		if (st == data_transfer_handler::connecting) {
 			if (error == ENOTSOCK)
@@ -1081,10 +1374,48 @@ void commander::handle_data_transfer(data_transfer_handler::status st, channel::
 	}
 	else
 	if (st == data_transfer_handler::started) {
+		trace_.phase("transfer");
 		respond<150>() << (msg.empty() ? "Data transfer started" : msg);
 	}
 	else
 	if (st == data_transfer_handler::stopped) {
+		if (CUR_FTP_CMD_IS(MRTR)) {
+			respond<226>() << data_ops().multi_file_reader.num_sent() << "files sent," << data_ops().multi_file_reader.num_failed() << "could not be opened.";
+			return;
+		}
+
+		if (CUR_FTP_CMD_IS(MSTR)) {
+			if (!data_ops().multi_file_writer.is_complete()) {
+				data_ops().multi_file_writer.abort(ECONNRESET);
+				respond<451>() << "Data connection closed in the middle of a file.";
+				return;
+			}
+
+			auto &failed = data_ops().multi_file_writer.failed();
+
+			if (failed.empty()) {
+				respond<226>() << data_ops().multi_file_writer.num_stored() << "files stored.";
+				return;
+			}
+
+			auto res = respond<226>();
+			res << data_ops().multi_file_writer.num_stored() << "files stored," << failed.size() << "could not be opened:" << endl;
+
+			for (auto &f: failed)
+				res << quote(f) << endl;
+
+			res << "End";
+			return;
+		}
+
+		if (CUR_FTP_CMD_IS(STOR) || CUR_FTP_CMD_IS(APPE)) {
+			if (int err = data_ops().file_writer.finalize()) {
+				notifier_.notify_entry_close(1, err);
+				respond<451>() << "Error writing to file:" << fz::to_utf8(socket_error_description(err));
+				return;
+			}
+		}
+
 		notifier_.notify_entry_close(1, error);
 
 		respond<226>() << (msg.empty() ? "Operation successful" : msg);
@@ -1107,7 +1438,8 @@ FTP_CMD(STAT) {
 		}
 
 		buffer_stream() << "221-Status of " << path << ":\r\n";
-		process_nested_adder_until_eof(stats_lister_.prepend_space(), [this] {
+		stats_context_.reset();
+		process_nested_adder_until_eof(data_ops().stats_lister.prepend_space(), [this] {
 			bool aborted = CUR_FTP_CMD_IS(ABOR);
 
 			buffer_stream() << "221 End";
@@ -1125,7 +1457,7 @@ FTP_CMD(STAT) {
 }
 
 FTP_CMD(SIZE) {
-	tvfs_.async_get_entry(arg, async_receive_ >> [this](result result, auto &e) {
+	async_get_entry(arg, [this](result result, auto &e) {
 		tvfs::entry_size size = e.size();
 
 		if (result && size < 0)
@@ -1147,8 +1479,19 @@ FTP_CMD(RETR) {
 			return;
 		}
 
+		// Small files might be served from memory. The file has been opened anyway, so the permissions have been checked as usual.
+		if (auto data = small_file_cache_.get(file_)) {
+			notifier_.notify_entry_open(1, path, std::int64_t(data->size()));
+			data_ops().cached_file_reader.set_data(std::move(data), std::size_t(rest_size_));
+			trace_.phase("data_connection");
+			controller_.start_data_transfer(data_ops().cached_file_reader, this, data_is_binary_);
+			return;
+		}
+
 		notifier_.notify_entry_open(1, path, file_.size());
-		controller_.start_data_transfer(file_reader_, this, data_is_binary_);
+		data_ops().file_reader.set_streaming(tvfs_.get_mount_flags(path) & tvfs::mount_point::streaming);
+		trace_.phase("data_connection");
+		controller_.start_data_transfer(data_ops().file_reader, this, data_is_binary_);
 	});
 }
 
@@ -1160,10 +1503,114 @@ FTP_CMD(STOR) {
 		}
 
 		notifier_.notify_entry_open(1, path, file_.size());
-		controller_.start_data_transfer(file_writer_, this, data_is_binary_);
+		data_ops().file_writer.preallocate(allo_size_);
+		trace_.phase("data_connection");
+		controller_.start_data_transfer(data_ops().file_writer, this, data_is_binary_);
 	});
 }
 
+FTP_CMD(MRTR) {
+	std::vector<std::string> paths;
+
+	if (!parse_path_list(arg, paths)) {
+		respond<501>() << "Syntax error in the list of files.";
+		return;
+	}
+
+	data_ops().multi_file_reader.set_paths(std::move(paths));
+	trace_.phase("data_connection");
+	controller_.start_data_transfer(data_ops().multi_file_reader, this, true);
+}
+
+FTP_CMD(MSTR) {
+	data_ops().multi_file_writer.reset();
+	trace_.phase("data_connection");
+	controller_.start_data_transfer(data_ops().multi_file_writer, this, true);
+}
+
+void commander::hash_file(hash_engine::algorithm algo, std::string_view arg, bool is_hash_cmd)
+{
+	std::string path{arg};
+	std::int64_t begin = 0, end = -1;
+
+	if (!is_hash_cmd && !parse_hash_arg(arg, path, begin, end)) {
+		respond<501>() << "Syntax error in parameters or arguments.";
+		return;
+	}
+
+	tvfs_.async_open_file(file_, path, file::mode::reading, 0, async_receive_ >> [this, algo, begin, end, is_hash_cmd](fz::result res, const std::string &tvfs_path) {
+		if (!res) {
+			respond<550>() << to_string_view(res);
+			return;
+		}
+
+		// The size and modification time validate the cached digest, if any.
+		tvfs_.async_get_entry(tvfs_path, async_receive_ >> [this, algo, begin, end, is_hash_cmd, tvfs_path](result res, tvfs::entry &e) {
+			if (!res) {
+				file_.close();
+				respond<550>() << to_string_view(res);
+				return;
+			}
+
+			hash_engine::request r;
+			r.algo = algo;
+			r.file = std::move(file_);
+			r.begin = begin;
+			r.end = end;
+			r.id = fz::sprintf("%s:%s", user_, tvfs_path);
+			r.size = e.size();
+			r.mtime = e.mtime();
+
+			auto effective_end = end < 0 ? e.size() : std::min(end, e.size());
+
+			trace_.phase("hashing");
+			hash_engine_.async_hash(std::move(r), async_receive_ >> [this, algo, begin, effective_end, is_hash_cmd, tvfs_path](int error, const std::string &digest) {
+				if (error == EINVAL) {
+					respond<501>() << "Invalid range.";
+					return;
+				}
+
+				if (error) {
+					respond<550>() << "Could not compute the digest:" << fz::to_utf8(socket_error_description(error));
+					return;
+				}
+
+				if (is_hash_cmd) {
+					// The range's end is inclusive. An empty file has no last byte, and 0-0 is the nearest the syntax gets to it.
+					auto last = effective_end > begin ? effective_end - 1 : begin;
+					respond<213>() << hash_engine::to_string(algo) << fz::sprintf("%d-%d", begin, last) << digest << tvfs_path;
+				}
+				else
+					respond<250>() << digest;
+			});
+		});
+	});
+}
+
+FTP_CMD(HASH) {
+	hash_file(hash_algorithm_, arg, true);
+}
+
+FTP_CMD(XCRC) {
+	hash_file(hash_engine::algorithm::crc32, arg, false);
+}
+
+FTP_CMD(XMD5) {
+	hash_file(hash_engine::algorithm::md5, arg, false);
+}
+
+FTP_CMD(XSHA1) {
+	hash_file(hash_engine::algorithm::sha1, arg, false);
+}
+
+FTP_CMD(XSHA256) {
+	hash_file(hash_engine::algorithm::sha256, arg, false);
+}
+
+FTP_CMD(XSHA512) {
+	hash_file(hash_engine::algorithm::sha512, arg, false);
+}
+
 FTP_CMD(DELE) {
 	tvfs_.async_remove_file(arg, async_receive_ >> [this](auto result, auto) {
 		if (!result) {
@@ -1218,7 +1665,9 @@ FTP_CMD(APPE) {
 		}
 
 		notifier_.notify_entry_open(1, path, file_.size());
-		controller_.start_data_transfer(file_writer_, this, data_is_binary_);
+		data_ops().file_writer.preallocate(allo_size_);
+		trace_.phase("data_connection");
+		controller_.start_data_transfer(data_ops().file_writer, this, data_is_binary_);
 	});
 }
 
@@ -1233,7 +1682,7 @@ FTP_CMD(REST) {
 }
 
 FTP_CMD(MDTM) {
-	tvfs_.async_get_entry(arg, async_receive_ >> [this] (auto result, auto &e) {
+	async_get_entry(arg, [this] (auto result, auto &e) {
 		if (!result) {
 			respond<550>() << to_string_view(result);
 			return;
@@ -1318,7 +1767,16 @@ FTP_CMD(ADAT) {
 }
 
 FTP_CMD(ALLO) {
-	respond<202>() << "No storage allocation neccessary.";
+	// ALLO <size> [R <record size>]: the record size is of no use to us.
+	auto tokens = fz::strtok_view(arg, " ");
+	auto size = tokens.empty() ? -1 : to_integral<decltype(allo_size_)>(tokens[0], -1);
+	if (size < 0) {
+		respond<501>() << "Invalid size";
+		return;
+	}
+
+	allo_size_ = size;
+	respond<200>() << "Allocation size set to" << size;
 }
 
 #undef FTP_CMD
@@ -2,19 +2,28 @@
 #define COMMANDER_HPP
 
 #include <unordered_map>
+#include <deque>
+#include <functional>
 
 #include <libfilezilla/string.hpp>
 #include <libfilezilla/logger.hpp>
 
 #include "../buffer_operator/file_reader.hpp"
+#include "../buffer_operator/cached_file_reader.hpp"
 #include "../buffer_operator/file_writer.hpp"
+#include "../buffer_operator/multi_file_reader.hpp"
+#include "../buffer_operator/multi_file_writer.hpp"
 #include "../buffer_operator/streamed_adder.hpp"
 #include "../buffer_operator/line_consumer.hpp"
 #include "../buffer_operator/tvfs_entries_lister.hpp"
 
 #include "../channel.hpp"
+#include "../hash_engine.hpp"
+#include "../small_file_cache.hpp"
+#include "../timer_wheel.hpp"
 #include "../tvfs/engine.hpp"
 #include "../tcp/session.hpp"
+#include "../metrics/tracer.hpp"
 
 #include "controller.hpp"
 
@@ -89,7 +98,8 @@ public:
 		bool has_version;
 	};
 
-	commander(event_loop &loop, controller &co, tvfs::engine &tvfs, notifier &notifier,
+	commander(event_loop &loop, controller &co, tvfs::engine &tvfs, hash_engine &hash_engine, small_file_cache &small_file_cache, timer_wheel &timer_wheel, notifier &notifier,
+			  tcp::session::id session_id,
 			  fz::monotonic_clock &last_activity,
 			  bool needs_security_before_user_cmd,
 			  const welcome_message_t &welcome_message, const std::string &refuse_message,
@@ -98,6 +108,12 @@ public:
 
 	void set_socket(socket_interface *);
 	void set_timeouts(const fz::duration &login_timeout, const fz::duration &activity_timeout);
+	void set_upload_options(buffer_operator::file_writer::options opts);
+	void set_download_options(buffer_operator::file_reader::options opts);
+
+	//! Releases the memory only needed by the data transfers, which gets allocated again on the next transfer.
+	//! Does nothing while a command is being executed.
+	void release_data_resources();
 	void shutdown(int err = 0);
 
 	bool has_empty_buffers();
@@ -107,7 +123,11 @@ private:
 	channel channel_;
 	controller &controller_;
 	tvfs::engine &tvfs_;
+	hash_engine &hash_engine_;
+	small_file_cache &small_file_cache_;
+	timer_wheel &timer_wheel_;
 	notifier &notifier_;
+	tcp::session::id session_id_;
 	const welcome_message_t &welcome_message_;
 	const std::string &refuse_message_;
 	logger_interface &logger_;
@@ -118,7 +138,10 @@ private:
 		needs_auth            = 1 << 1,
 		must_be_last_in_queue = 1 << 2,
 		needs_security        = 1 << 3,
-		trim_arg              = 1 << 4
+		trim_arg              = 1 << 4,
+
+		//! The command only reads metadata, and can have its lookup performed ahead of time, while the preceding commands are still executing.
+		pipelineable          = 1 << 5
 	};
 
 	enum command_reply {
@@ -167,14 +190,17 @@ private:
 	FTP_CMD(EPRT, needs_arg | trim_arg | needs_auth);
 	FTP_CMD(EPSV, needs_auth);
 	FTP_CMD(FEAT, none);
+	FTP_CMD(HASH, needs_arg | needs_auth);
 	FTP_CMD(HELP, none);
 	FTP_CMD(LIST, needs_auth);
-	FTP_CMD(MDTM, needs_arg | needs_auth);
+	FTP_CMD(MDTM, needs_arg | needs_auth | pipelineable);
 	FTP_CMD(MFMT, needs_arg | needs_auth);
 	FTP_CMD(MKD,  needs_arg | needs_auth);
 	FTP_CMD(MLSD, needs_auth);
-	FTP_CMD(MLST, needs_auth);
+	FTP_CMD(MLST, needs_auth | pipelineable);
 	FTP_CMD(MODE, needs_arg | needs_auth );
+	FTP_CMD(MRTR, needs_arg | needs_auth);
+	FTP_CMD(MSTR, needs_auth);
 	FTP_CMD(NLST, needs_auth);
 	FTP_CMD(NOOP, none);
 	FTP_CMD(OPTS, needs_arg);
@@ -190,13 +216,18 @@ private:
 	FTP_CMD(RMD,  needs_arg | needs_auth);
 	FTP_CMD(RNFR, needs_arg | needs_auth);
 	FTP_CMD(RNTO, needs_arg | needs_auth);
-	FTP_CMD(SIZE, needs_arg | needs_auth);
+	FTP_CMD(SIZE, needs_arg | needs_auth | pipelineable);
 	FTP_CMD(STAT, needs_auth);
 	FTP_CMD(STOR, needs_arg | needs_auth);
 	FTP_CMD(STRU, needs_arg | needs_auth);
 	FTP_CMD(SYST, none);
 	FTP_CMD(TYPE, needs_arg | needs_auth);
 	FTP_CMD(USER, needs_arg);
+	FTP_CMD(XCRC, needs_arg | needs_auth);
+	FTP_CMD(XMD5, needs_arg | needs_auth);
+	FTP_CMD(XSHA1, needs_arg | needs_auth);
+	FTP_CMD(XSHA256, needs_arg | needs_auth);
+	FTP_CMD(XSHA512, needs_arg | needs_auth);
 
 	FTP_CMD_ALIAS(NOP, NOOP);
 	FTP_CMD_ALIAS(XCWD, CWD);
@@ -209,39 +240,103 @@ private:
 
 	decltype(commands_)::const_iterator current_cmd_ { commands_.cend() };
 	decltype(commands_)::const_iterator cmd_being_aborted_ { commands_.cend() };
+	metrics::command_trace trace_;
 
 	class responder;
 	template <unsigned int XYZ>
 	responder respond(bool emit_xyz_on_each_line = false);
 
 	int failure_count_{};
-	void act_upon_command_reply(command_reply reply);
+	void act_upon_command_reply(command_reply reply, int code = 0);
+
+	/*
+	Pipelining.
+
+	Clients are allowed to send commands without waiting for the replies to the previous ones, but commands are executed
+	one at a time, in the order they've been received. Pipelineable commands, though, get their entry looked up as soon as
+	they're received, if they follow other pipelineable commands, so that the lookups overlap. They're still executed,
+	and replied to, in order, as usual: only, by the time their turn comes, their entry is most likely already available.
+
+	Any other kind of command acts as a barrier: it waits for all the pipelined commands to be done before executing.
+	*/
+	static constexpr std::size_t max_pipelined_cmds = 64;
+
+	struct prefetched_entry
+	{
+		result res{result::other};
+		tvfs::entry entry{};
+		bool ready{};
+		std::function<void(result, tvfs::entry &)> waiter{};
+	};
+
+	struct pipelined_cmd
+	{
+		decltype(commands_)::const_iterator cmd;
+		std::string arg;
+		std::shared_ptr<prefetched_entry> entry;
+	};
+
+	std::deque<pipelined_cmd> pipeline_;
+	std::shared_ptr<prefetched_entry> prefetched_;
+
+	bool can_be_pipelined(decltype(commands_)::const_iterator cmd, std::string_view arg) const;
+	int pipeline_cmd(decltype(commands_)::const_iterator cmd, std::string_view arg);
+	void execute_next_pipelined_cmd();
+
+	//! Uses the prefetched entry, if the command being executed has one, otherwise looks the entry up.
+	template <typename F>
+	void async_get_entry(std::string_view path, F &&f);
+
+	//! Replies with the digest of the file. Unlike HASH, the X* commands can be given a range, and reply with just the digest.
+	void hash_file(hash_engine::algorithm algo, std::string_view arg, bool is_hash_cmd);
 
 	std::string user_;
 	std::unique_ptr<authentication::authenticator::operation> auth_op_;
 
 	bool only_allow_epsv_{};
 	tvfs::entry_size rest_size_{};
+	tvfs::entry_size allo_size_{};
 	tvfs::entry_facts::which enabled_facts_ = tvfs::entry_facts::all;
 	std::string names_prefix_;
 	tvfs::entries_iterator entries_iterator_;
+	tvfs::entry_stats::context stats_context_;
 	file file_;
 
-	buffer_operator::tvfs_entries_lister<tvfs::entry_facts, tvfs::entry_facts::which&> facts_lister_{event_loop_, entries_iterator_, enabled_facts_};
-	buffer_operator::tvfs_entries_lister<tvfs::entry_stats> stats_lister_{event_loop_, entries_iterator_};
-	buffer_operator::tvfs_entries_lister<tvfs::entry_name, std::string&> names_lister_{event_loop_, entries_iterator_, names_prefix_};
-	buffer_operator::tvfs_entries_lister<tvfs::entry_facts, tvfs::entry_facts::which> mfmt_lister_{event_loop_, entries_iterator_, tvfs::entry_facts::which::modify};
+	// The operators that produce and consume the data of the transfers are only constructed when first needed,
+	// and are released by release_data_resources(): most sessions spend most of their time idling.
+	struct data_operators
+	{
+		data_operators(commander &c);
+
+		buffer_operator::tvfs_entries_lister<tvfs::entry_facts, tvfs::entry_facts::which&> facts_lister;
+		buffer_operator::tvfs_entries_lister<tvfs::entry_stats, const tvfs::entry_stats::context&> stats_lister;
+		buffer_operator::tvfs_entries_lister<tvfs::entry_name, std::string&> names_lister;
+
+		buffer_operator::file_reader file_reader;
+		buffer_operator::cached_file_reader cached_file_reader;
+		buffer_operator::file_writer file_writer;
+		buffer_operator::multi_file_reader multi_file_reader;
+		buffer_operator::multi_file_writer multi_file_writer;
+	};
+
+	data_operators &data_ops();
+
+	//! Closes the entry of the file being transferred by the given command with the given error.
+	//! MSTR and MRTR transfer several files, whose operators know which one, if any, is still open.
+	void close_transferred_entry(decltype(commands_)::const_iterator cmd, int error);
 
-	buffer_operator::file_reader file_reader_{file_, 128*1024};
-	buffer_operator::file_writer file_writer_{file_};
+	std::unique_ptr<data_operators> data_ops_;
+	buffer_operator::file_reader::options download_opts_{};
+	buffer_operator::file_writer::options upload_opts_{};
 
 	std::string rename_from_{};
 
 	bool data_is_binary_{};
+	hash_engine::algorithm hash_algorithm_ = hash_engine::algorithm::sha256;
 
 	duration login_timeout_{};
 	duration activity_timeout_{};
-	timer_id timer_id_{};
+	timer_wheel::entry timeout_{timer_wheel_, [this]{ on_timeout(); }};
 	monotonic_clock start_time_{};
 	monotonic_clock &last_activity_;
 	bool needs_security_before_user_cmd_{};
@@ -252,7 +347,7 @@ private:
 
 	// make_secure_response_handler interface
 private:
-	void handle_make_secure_response(bool can_secure) override;
+	void handle_make_secure_response(controller::make_secure_result result) override;
 
 	// line_consumer interface
 public:
@@ -262,7 +357,8 @@ public:
 private:
 	void operator ()(const event_base &) override;
 	void on_channel_done_event(channel &, channel::error_type error);
-	void on_timer_event(timer_id id);
+
+	void on_timeout();
 
 	// data_transfer_handler interface
 public:
@@ -296,6 +392,10 @@ private:
 		template <typename F>
 		auto operator >>(F && f);
 
+		//! Wraps f so that it can be aborted, for when f is to be invoked by something other than an async_receive.
+		template <typename F>
+		auto wrap(F && f);
+
 		void abort();
 		bool is_pending() const;
 	};
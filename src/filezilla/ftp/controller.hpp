@@ -32,10 +32,16 @@ public:
 	virtual void stop_ongoing_user_authentication() = 0;
 	virtual bool is_authenticated() const = 0;
 
+	enum class make_secure_result {
+		can_secure,
+		failed,
+		too_busy   //!< Too many handshakes are in progress server-wide, the client should try later.
+	};
+
 	class make_secure_response_handler {
 	public:
 		virtual ~make_secure_response_handler() = default;
-		virtual void handle_make_secure_response(bool secured) = 0;
+		virtual void handle_make_secure_response(make_secure_result result) = 0;
 	};
 
 	enum class secure_state {
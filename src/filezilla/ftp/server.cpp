@@ -21,14 +21,19 @@ server::server(tcp::server_context &context, event_loop_pool &loop_pool,
 : event_handler(context.loop())
 , tcp::session::factory::base(loop_pool, disallowed_ips, allowed_ips, autobanner, nonsession_logger)
 , pool_(context.pool())
+, loop_pool_(loop_pool)
 , nonsession_logger_(nonsession_logger, "FTP Server")
 , session_logger_(session_logger, "FTP Server")
 , authenticator_(authenticator)
 , rate_limit_manager_(rate_limit_manager)
 , autobanner_(autobanner, *this)
 , port_manager_(port_manager)
+, hash_engine_(context.pool(), nonsession_logger)
 , tcp_server_(context, nonsession_logger_, *this)
 {
+	static auto &session_size = metrics::registry::global().get_gauge("fz_ftp_session_size_bytes", "Size of each FTP session object, not counting the memory it allocates on demand, nor the per-user data shared among sessions.");
+	session_size.set(std::int64_t(sizeof(session)));
+
 	set_options(std::move(opts));
 }
 
@@ -55,13 +60,41 @@ void server::refuse_connections(std::string_view refuse_message)
 
 void server::set_options(server::options opts)
 {
-	tcp_server_.set_listen_address_infos(opts.listeners_info().begin(), opts.listeners_info().end(), [](const address_info &ai) {
-		return ai.tls_mode;
+	decltype(tls_handshake_counters_) tls_handshake_counters;
+
+	{
+		fz::scoped_lock lock(mutex_);
+
+		for (const auto &ai: opts.listeners_info()) {
+			auto &c = tls_handshake_counters[ai];
+
+			if (auto it = tls_handshake_counters_.find(ai); it != tls_handshake_counters_.end())
+				c = it->second;
+			else
+				c = std::make_shared<session::tls_handshake_counters>();
+		}
+	}
+
+	tcp_server_.set_listen_address_infos(opts.listeners_info().begin(), opts.listeners_info().end(), [&tls_handshake_counters](const address_info &ai) {
+		auto &registry = metrics::registry::global();
+		metrics::labels labels = {{"listener", fz::sprintf("%s:%d", ai.address, ai.port)}};
+
+		session::listener_metrics listener_metrics = {
+			&registry.get_counter("fz_ftp_data_received_bytes_total", "Bytes received on the data connections of the sessions accepted by a listener.", labels),
+			&registry.get_counter("fz_ftp_data_sent_bytes_total", "Bytes sent on the data connections of the sessions accepted by a listener.", labels)
+		};
+
+		return listener_data{ ai.tls_mode, tls_handshake_counters[ai], listener_metrics };
 	});
 
 	if (opts.listeners_info().empty())
 		nonsession_logger_.log_u(fz::logmsg::debug_warning, L"No listeners were set. Will not serve!");
 
+	tls_handshake_throttler_.set_options(opts.tls_handshakes());
+	data_buffers_budget_.set_max_total(std::size_t(std::min<std::uint64_t>(opts.data_buffers_memory_budget(), std::numeric_limits<std::size_t>::max())));
+	hash_engine_.set_options(opts.hashing());
+	small_file_cache_.set_options(opts.small_files());
+
 	if (auto res = opts.welcome_message().validate(); !res) {
 		nonsession_logger_.log_u(fz::logmsg::error, L"Welcome message is invalid: %s. Ignoring.",
 			res == res.total_size_too_big ? "total size is too big." :
@@ -77,6 +110,7 @@ void server::set_options(server::options opts)
 
 	fz::scoped_lock lock(mutex_);
 	opts_ = std::move(opts);
+	tls_handshake_counters_ = std::move(tls_handshake_counters);
 }
 
 void server::set_data_buffer_sizes(int32_t receive, int32_t send)
@@ -117,8 +151,8 @@ void server::set_notifier_factory(session::notifier::factory &nf)
 
 std::unique_ptr<tcp::session> server::make_session(event_handler &target_handler, event_loop &loop, tcp::session::id session_id, std::unique_ptr<socket> socket, const std::any &user_data, int &error)
 {
-	auto tls_mode = std::any_cast<session::tls_mode>(&user_data);
-	if (!tls_mode) {
+	auto listener_data = std::any_cast<server::listener_data>(&user_data);
+	if (!listener_data) {
 		// This should really never ever happen
 		session_logger_.log(logmsg::error, L"User data is not of the proper type. This is an internal error.");
 		error = EINVAL;
@@ -139,15 +173,22 @@ std::unique_ptr<tcp::session> server::make_session(event_handler &target_handler
 		pool_,
 		loop,
 		target_handler,
-		rate_limit_manager_,
+		loop_pool_.get_rate_limit_manager(loop),
 		std::move(notifier),
 		session_id,
 		startdate,
 		std::move(socket),
-		*tls_mode,
+		listener_data->tls_mode,
+		listener_data->tls_handshake_counters,
+		listener_data->listener_metrics,
 		autobanner_,
 		authenticator_,
 		port_manager_,
+		tls_handshake_throttler_,
+		data_buffers_budget_,
+		hash_engine_,
+		small_file_cache_,
+		loop_pool_.get_timer_wheel(loop),
 		opts_.welcome_message(),
 		refuse_message_,
 		opts_.sessions()
@@ -159,6 +200,37 @@ std::unique_ptr<tcp::session> server::make_session(event_handler &target_handler
 	return session;
 }
 
+std::size_t server::get_data_buffers_memory_usage() const
+{
+	return data_buffers_budget_.get_used();
+}
+
+void server::set_hash_index_path(native_string path)
+{
+	hash_engine_.set_index_path(std::move(path));
+}
+
+std::vector<server::tls_handshake_stats> server::get_tls_handshake_stats() const
+{
+	std::vector<tls_handshake_stats> stats;
+
+	scoped_lock lock(mutex_);
+
+	stats.reserve(tls_handshake_counters_.size());
+
+	for (const auto &[ai, c]: tls_handshake_counters_) {
+		stats.push_back({
+			ai,
+			c->control.load(std::memory_order_relaxed),
+			c->data_resumed.load(std::memory_order_relaxed),
+			c->data_not_resumed.load(std::memory_order_relaxed),
+			c->data_failed.load(std::memory_order_relaxed)
+		});
+	}
+
+	return stats;
+}
+
 void server::listener_status_changed(const tcp::listener &listener)
 {
 	notifier_factory_->listener_status(listener);
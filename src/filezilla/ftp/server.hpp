@@ -1,6 +1,8 @@
 #ifndef FT_FTP_SERVER_HPP
 #define FT_FTP_SERVER_HPP
 
+#include <map>
+
 #include <libfilezilla/socket.hpp>
 #include <libfilezilla/thread_pool.hpp>
 #include <libfilezilla/rate_limiter.hpp>
@@ -33,10 +35,30 @@ public:
 		}
 	};
 
+	struct tls_handshake_stats
+	{
+		tcp::address_info address_info;
+
+		std::uint64_t control{};
+		std::uint64_t data_resumed{};
+		std::uint64_t data_not_resumed{};
+		std::uint64_t data_failed{};
+
+		template <typename Archive>
+		void serialize(Archive &ar)
+		{
+			ar(FZ_NVP(address_info), FZ_NVP(control), FZ_NVP(data_resumed), FZ_NVP(data_not_resumed), FZ_NVP(data_failed));
+		}
+	};
+
 	struct options: util::options<options, server> {
 		opt<std::vector<address_info>>    listeners_info  = o();
 		opt<session::options>             sessions        = o();
 		opt<commander::welcome_message_t> welcome_message = o();
+		opt<tls_handshake_throttler::options> tls_handshakes = o();
+		opt<std::uint64_t>                    data_buffers_memory_budget = o(std::uint64_t(256*1024*1024));
+		opt<hash_engine::options>             hashing = o();
+		opt<small_file_cache::options>        small_files = o();
 
 		options(){}
 	};
@@ -85,16 +107,38 @@ public:
 
 	void set_notifier_factory(session::notifier::factory &nf);
 
+	//! \returns the amount of memory currently devoted to the data transfers' buffers, across all sessions.
+	std::size_t get_data_buffers_memory_usage() const;
+
+	//! \returns the counters of the TLS handshakes performed by the sessions, one entry per each of the currently configured listeners.
+	//! The counters survive reconfigurations, for as long as the listener's address and port don't change.
+	std::vector<tls_handshake_stats> get_tls_handshake_stats() const;
+
+	//! Makes the digests computed on behalf of the sessions persist in the given file. An empty path disables persistence.
+	void set_hash_index_path(native_string path);
+
 private:
-	fz::mutex mutex_{true};
+	struct listener_data
+	{
+		session::tls_mode tls_mode;
+		std::shared_ptr<session::tls_handshake_counters> tls_handshake_counters;
+		session::listener_metrics listener_metrics;
+	};
+
+	mutable fz::mutex mutex_{true};
 
 	thread_pool &pool_;
+	event_loop_pool &loop_pool_;
 	logger::modularized nonsession_logger_;
 	logger::modularized session_logger_;
 	authentication::authenticator &authenticator_;
 	fz::rate_limit_manager &rate_limit_manager_;
 	authentication::autobanner::with_events autobanner_;
 	port_manager &port_manager_;
+	tls_handshake_throttler tls_handshake_throttler_;
+	buffer_budget data_buffers_budget_;
+	hash_engine hash_engine_;
+	small_file_cache small_file_cache_;
 
 	options opts_;
 
@@ -105,6 +149,8 @@ private:
 
 	std::string refuse_message_;
 
+	std::map<tcp::address_info, std::shared_ptr<session::tls_handshake_counters>> tls_handshake_counters_;
+
 	tcp::server tcp_server_;
 
 	session::notifier::factory *notifier_factory_{&session::notifier::factory::none};
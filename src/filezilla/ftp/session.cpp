@@ -22,6 +22,16 @@ namespace fz::ftp {
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
+namespace {
+
+// How long after the last data transfer the memory it needed is released.
+const auto data_idle_delay = duration::from_seconds(30);
+
+// How long a client can take to complete the TLS handshake of the control connection, while holding one of the throttler's slots.
+const auto tls_handshake_timeout = duration::from_seconds(30);
+
+}
+
 session::protocol_info::status session::protocol_info::get_status() const
 {
 	if (!security)
@@ -45,9 +55,16 @@ session::session(fz::thread_pool &pool, event_loop &loop, event_handler &target_
 				 datetime start,
 				 std::unique_ptr<socket> control_socket,
 				 session::tls_mode tls_mode,
+				 std::shared_ptr<tls_handshake_counters> tls_handshake_counters,
+				 session::listener_metrics listener_metrics,
 				 authentication::autobanner &autobanner,
 				 authentication::authenticator &authenticator,
 				 port_manager &port_manager,
+				 tls_handshake_throttler &tls_handshake_throttler,
+				 buffer_budget &data_buffers_budget,
+				 hash_engine &hash_engine,
+				 small_file_cache &small_file_cache,
+				 timer_wheel &timer_wheel,
 				 const commander::welcome_message_t &welcome_message, const std::string &refuse_message,
 				 options opts)
 	: tcp::session(target_event_handler, id, {control_socket->peer_ip(), control_socket->address_family()})
@@ -59,27 +76,33 @@ session::session(fz::thread_pool &pool, event_loop &loop, event_handler &target_
 	, logger_(notifier_->logger(), "FTP Session", {{"id", std::to_string(id)}, {"host", control_socket->peer_ip()}}, logger_info_to_string)
 	, start_datetime_{start}
 	, control_socket_(loop, this, std::move(control_socket), logger_)
+	, tls_handshake_counters_(tls_handshake_counters ? std::move(tls_handshake_counters) : std::make_shared<session::tls_handshake_counters>())
+	, listener_metrics_(listener_metrics)
 	, port_manager_(port_manager)
+	, tls_handshake_throttler_(tls_handshake_throttler)
 	, opts_(std::move(opts))
 	, tvfs_(logger_)
-	, commander_(loop, *this, tvfs_, *notifier_, last_activity_, tls_mode == require_tls, welcome_message, refuse_message, logger_)
+	, commander_(loop, *this, tvfs_, hash_engine, small_file_cache, timer_wheel, *notifier_, id, last_activity_, tls_mode == require_tls, welcome_message, refuse_message, logger_)
+	, timer_wheel_(timer_wheel)
 	, autobanner_(autobanner)
 	, authenticator_(authenticator)
+	, data_buffer_size_(data_buffers_budget, opts_.data_buffers)
 	, invoke_later_(loop)
 {
 	control_socket_.set_unexpected_eof_cb([this] { return !must_downgrade_log_level();} );
 
 	logger_.log_u(logmsg::debug_info, L"Session %p with ID %zu created.", this, id_);
 
+	commander_.set_upload_options(opts_.uploads);
+	commander_.set_download_options(opts_.downloads);
+
 	control_limiter_ = &control_socket_.emplace<compound_rate_limited_layer>(nullptr, control_socket_.top());
 
 	invoke_later_([this, tls_mode] {
 		FZ_UTIL_THREAD_CHECK
 
-		if (tls_mode == implicit_tls) {
-			if (!control_socket_.make_secure_server(opts_.tls.min_tls_ver, opts_.tls.cert, {}, {}, {"x-filezilla-ftp", "ftp"}))
-				quit(EPROTO);
-		}
+		if (tls_mode == implicit_tls)
+			make_secure({}, nullptr);
 		else {
 			commander_.set_socket(&control_socket_);
 			notifier_->notify_protocol_info(get_protocol_info());
@@ -88,6 +111,10 @@ session::session(fz::thread_pool &pool, event_loop &loop, event_handler &target_
 }
 
 session::~session() {
+	// Sessions are destroyed from outside of their loop, where the entries might be expiring right now.
+	data_idle_.disarm();
+	tls_handshake_deadline_.disarm();
+
 	remove_handler();
 
 	logger_.log_u(logmsg::debug_info, L"Session %p with ID %zu destroyed.", this, id_);
@@ -130,7 +157,19 @@ void session::on_shared_user_changed_event(const authentication::weak_user &su)
 	tvfs_.set_backend(user->impersonator);
 
 	session_limiter_.set_limits(user->session_inbound_limit, user->session_outbound_limit);
-	user_limiter_ = user->limiter;
+	session_limited_ = user->session_inbound_limit != rate::unlimited || user->session_outbound_limit != rate::unlimited;
+
+	// The user's limiter goes away when the user's limits are lifted, and a new one is made when they're set again.
+	if (user_limiter_ != user->limiter) {
+		if (user_limiter_) {
+			for (auto crll: { control_limiter_, data_limiter_ }) {
+				if (crll)
+					crll->remove_limiter(user_limiter_.get());
+			}
+		}
+
+		user_limiter_ = user->limiter;
+	}
 
 	update_limits(control_limiter_, &user->extra_limiters);
 	update_limits(data_limiter_, &user->extra_limiters);
@@ -143,6 +182,10 @@ void session::on_timer_event(timer_id id)
 	if (id == check_if_control_is_secured_id_) {
 		if (is_secure()) {
 			stop_timer(id);
+			tls_handshake_deadline_.disarm();
+			tls_handshake_slot_.release();
+			++tls_handshake_counters_->control;
+			record_tls_handshake_duration();
 			notifier_->notify_protocol_info(get_protocol_info());
 		}
 	}
@@ -152,6 +195,9 @@ void session::set_options(options opts)
 {
 	invoke_later_([this, opts = std::move(opts)] () mutable {
 		opts_ = std::move(opts);
+		data_buffer_size_.set_options(opts_.data_buffers);
+		commander_.set_upload_options(opts_.uploads);
+		commander_.set_download_options(opts_.downloads);
 	});
 }
 
@@ -177,6 +223,18 @@ session::protocol_info session::get_protocol_info() const
 	return { control_socket_.get_session_info() };
 }
 
+void session::apply_data_buffer_size(std::size_t size)
+{
+	data_channel_.set_max_buffer_size(size);
+
+	// Downloads are read from file in chunks as big as the buffer.
+	if (auto reader = dynamic_cast<buffer_operator::file_reader *>(data_adder_))
+		reader->set_max_buffer_size(size);
+	else
+	if (auto reader = dynamic_cast<buffer_operator::cached_file_reader *>(data_adder_))
+		reader->set_max_buffer_size(size);
+}
+
 void session::do_set_buffer_sizes()
 {
 	static_assert(
@@ -222,16 +280,88 @@ void session::make_secure(std::string_view preamble, controller::make_secure_res
 {
 	FZ_UTIL_THREAD_CHECK
 
-	auto && securer = control_socket_.make_secure_server(opts_.tls.min_tls_ver, opts_.tls.cert, {}, preamble, {"x-filezilla-ftp", "ftp"});
+	switch (tls_handshake_throttler_.acquire(tls_handshake_slot_, *this)) {
+		case tls_handshake_throttler::slot::granted:
+			return secure_control_connection(preamble, response_handler);
+
+		case tls_handshake_throttler::slot::queued:
+			logger_.log_u(logmsg::debug_info, L"Too many TLS handshakes in progress. Waiting for our turn.");
+
+			tls_handshake_preamble_ = preamble;
+			tls_handshake_response_handler_ = response_handler;
+			return;
+
+		case tls_handshake_throttler::slot::none:
+		case tls_handshake_throttler::slot::refused:
+			break;
+	}
+
+	logger_.log_u(logmsg::error, L"Too many TLS handshakes in progress and too many waiting for their turn. Refusing to secure the connection.");
 
 	if (response_handler)
-		response_handler->handle_make_secure_response(securer);
+		response_handler->handle_make_secure_response(make_secure_result::too_busy);
+	else
+		quit(EBUSY);
+}
+
+void session::secure_control_connection(std::string_view preamble, controller::make_secure_response_handler *response_handler)
+{
+	FZ_UTIL_THREAD_CHECK
+
+	tls_handshake_start_ = monotonic_clock::now();
+	auto && securer = control_socket_.make_secure_server(opts_.tls.min_tls_ver, opts_.tls.cert, {}, preamble, {"x-filezilla-ftp", "ftp"});
+
+	if (!securer)
+		tls_handshake_slot_.release();
+	else
+		timer_wheel_.arm(tls_handshake_deadline_, tls_handshake_timeout);
+
+	if (!response_handler) {
+		// Implicit TLS: the connection event is delivered directly to us.
+		if (!securer)
+			quit(EPROTO);
+
+		return;
+	}
+
+	response_handler->handle_make_secure_response(securer ? make_secure_result::can_secure : make_secure_result::failed);
 
 	// To know whether the control socket has been secured we need to poll, because the connection event is delivered to the socket adapter,
 	// deep into the guts of the channel embedded into the commander.
 	check_if_control_is_secured_id_ = add_timer(fz::duration::from_milliseconds(100), false);
 }
 
+void session::record_tls_handshake_duration()
+{
+	// With AUTH TLS the completion of the handshake is polled for, the figure is thus only accurate to the polling period.
+	static auto &handshake_duration = metrics::registry::global().get_histogram("fz_ftp_tls_handshake_duration_seconds", "Time taken to secure the control connections.");
+	handshake_duration.record_since(tls_handshake_start_);
+}
+
+void session::on_tls_handshake_timeout()
+{
+	FZ_UTIL_THREAD_CHECK
+
+	if (is_secure())
+		return;
+
+	// Don't let a stalled client keep others from securing their connections.
+	stop_timer(check_if_control_is_secured_id_);
+	tls_handshake_slot_.release();
+
+	logger_.log_u(logmsg::error, L"Failed securing control connection. Reason: the TLS handshake has not completed in time.");
+	quit(ETIMEDOUT);
+}
+
+void session::on_tls_handshake_granted_event(tls_handshake_throttler::slot *)
+{
+	FZ_UTIL_THREAD_CHECK
+
+	logger_.log_u(logmsg::debug_info, L"Our turn to perform the TLS handshake has come.");
+
+	secure_control_connection(tls_handshake_preamble_, std::exchange(tls_handshake_response_handler_, nullptr));
+}
+
 controller::secure_state session::get_secure_state() const
 {
 	FZ_UTIL_THREAD_CHECK
@@ -442,14 +572,28 @@ void session::notify_channel_socket_read_amount(const monotonic_clock &time_poin
 	last_activity_ = time_point;
 
 	notifier_->notify_entry_write(1, amount - data_previous_read_amount_, -1);
+
+	if (listener_metrics_.received_bytes)
+		listener_metrics_.received_bytes->add(std::uint64_t(amount - data_previous_read_amount_));
+
 	data_previous_read_amount_ = amount;
+
+	if (data_buffer_size_.update(time_point, amount))
+		apply_data_buffer_size(data_buffer_size_.get());
 }
 
 void session::notify_channel_socket_written_amount(const monotonic_clock &time_point, int64_t amount)
 {
 	last_activity_ = time_point;
 	notifier_->notify_entry_read(1, amount - data_previous_written_amount_, -1);
+
+	if (listener_metrics_.sent_bytes)
+		listener_metrics_.sent_bytes->add(std::uint64_t(amount - data_previous_written_amount_));
+
 	data_previous_written_amount_ = amount;
+
+	if (data_buffer_size_.update(time_point, amount))
+		apply_data_buffer_size(data_buffer_size_.get());
 }
 
 bool session::setup_data_channel()
@@ -496,6 +640,7 @@ bool session::setup_data_channel()
 				case securable_socket_state::secured:
 					logger_.log_u(logmsg::debug_debug, L"The data connection is now secure.");
 					data_socket_->set_flags(socket::flag_nodelay, false);
+					++tls_handshake_counters_->data_resumed;
 					error_msg = {};
 					break;
 
@@ -506,6 +651,7 @@ bool session::setup_data_channel()
 					break;
 
 				case securable_socket_state::session_not_resumed:
+					++tls_handshake_counters_->data_not_resumed;
 					error_msg = "TLS session of data connection not resumed.";
 					break;
 
@@ -544,6 +690,8 @@ bool session::setup_data_channel()
 
 			update_limits(data_limiter_);
 
+			apply_data_buffer_size(data_buffer_size_.start());
+
 			if (logger_.should_log(logmsg::debug_debug))
 				data_channel_.dump_state(logger_);
 
@@ -649,7 +797,9 @@ controller::data_connection_status session::close_data_connection()
 	auto removed = remove_events<channel::done_event>(this, data_channel_);
 	logger_.log_u(logmsg::debug_debug, L"Removed done events: %d", removed);
 
-	data_channel_.clear();
+	// Idle sessions keep no more than the minimum amount of buffer memory around.
+	data_channel_.clear(opts_.data_buffers.min_size);
+	data_buffer_size_.reset();
 
 	data_socket_.reset();
 	data_listen_socket_.reset();
@@ -663,9 +813,23 @@ controller::data_connection_status session::close_data_connection()
 	data_limiter_ = nullptr;
 	data_shutting_down_ = false;
 
+	timer_wheel_.arm(data_idle_, data_idle_delay);
+
 	return prev_status;
 }
 
+void session::release_data_resources()
+{
+	FZ_UTIL_THREAD_CHECK
+
+	// A new transfer is being set up already.
+	if (data_adder_ || data_consumer_ || data_transfer_handler_ || data_socket_ || data_listen_socket_)
+		return;
+
+	data_channel_.clear(0);
+	commander_.release_data_resources();
+}
+
 void session::on_socket_event(fz::socket_event_source *source, fz::socket_event_flag type, int error)
 {
 	FZ_UTIL_THREAD_CHECK
@@ -700,11 +864,21 @@ void session::on_socket_event(fz::socket_event_source *source, fz::socket_event_
 	if (error) {
 		// Control connection
 		if (source->root() == control_socket_.root()) {
+			tls_handshake_deadline_.disarm();
+			tls_handshake_slot_.release();
 			logger_.log_u(logmsg::error, L"Failed securing control connection. Reason: %s.", socket_error_description(error));
 			quit(error);
 		}
 		// Data connection
 		else {
+			// Only errors happening while the TLS handshake is under way count as failed handshakes:
+			// the connection might just as well fail before the handshake starts, or once it's secured.
+			if (data_socket_) {
+				auto state = data_socket_->get_securable_state();
+				if (state == securable_socket_state::about_to_secure || state == securable_socket_state::securing)
+					++tls_handshake_counters_->data_failed;
+			}
+
 			logger_.log_u(logmsg::error, L"Failed connection for data socket. Reason: %s.", socket_error_description(error));
 			handle_data_transfer(controller::data_transfer_handler::connecting, {error, channel::error_source::socket});
 		}
@@ -718,6 +892,10 @@ void session::on_socket_event(fz::socket_event_source *source, fz::socket_event_
 			// This may only happen if TLS was requested.
 
 			// All fine, hand the socket down to the commander.
+			tls_handshake_deadline_.disarm();
+			tls_handshake_slot_.release();
+			++tls_handshake_counters_->control;
+			record_tls_handshake_duration();
 			commander_.set_socket(&control_socket_);
 			notifier_->notify_protocol_info(get_protocol_info());
 			return;
@@ -853,14 +1031,16 @@ void session::operator()(const event_base &ev)
 		authentication::authenticator::operation::result_event,
 		hostname_lookup_event,
 		authentication::shared_user_changed_event,
-		timer_event
+		timer_event,
+		tls_handshake_throttler::granted_event
 	>(ev, this,
 		&session::on_socket_event,
 		&session::on_channel_done_event,
 		&session::on_authenticator_operation_result,
 		&session::on_hostname_lookup_event,
 		&session::on_shared_user_changed_event,
-		&session::on_timer_event
+		&session::on_timer_event,
+		&session::on_tls_handshake_granted_event
 	);
 }
 
@@ -901,8 +1081,14 @@ void session::update_limits(compound_rate_limited_layer *crll, std::vector<std::
 	for (auto &rl: extra_limiters_)
 		crll->add_limiter(rl.get());
 
-	crll->add_limiter(user_limiter_.get());
-	crll->add_limiter(&session_limiter_);
+	if (user_limiter_)
+		crll->add_limiter(user_limiter_.get());
+
+	// Limiters that don't limit anything would only add buckets to be refilled on each tick.
+	if (session_limited_)
+		crll->add_limiter(&session_limiter_);
+	else
+		crll->remove_limiter(&session_limiter_);
 }
 
 bool session::must_downgrade_log_level()
@@ -1,6 +1,8 @@
 ﻿#ifndef FZ_FTP_SESSION_HPP
 #define FZ_FTP_SESSION_HPP
 
+#include <atomic>
+
 #include <libfilezilla/logger.hpp>
 #include <libfilezilla/time.hpp>
 
@@ -10,7 +12,12 @@
 #include "../tcp/session.hpp"
 #include "../util/invoke_later.hpp"
 #include "../port_randomizer.hpp"
+#include "../tls_handshake_throttler.hpp"
+#include "../hash_engine.hpp"
+#include "../small_file_cache.hpp"
+#include "../adaptive_buffer_size.hpp"
 #include "../logger/modularized.hpp"
+#include "../metrics/registry.hpp"
 
 #include "controller.hpp"
 #include "commander.hpp"
@@ -56,8 +63,11 @@ public:
 			std::optional<port_range> port_range;
 		};
 
-		pasv                   pasv = {};
-		securable_socket::info tls  = {};
+		pasv                          pasv         = {};
+		securable_socket::info        tls          = {};
+		adaptive_buffer_size::options data_buffers = {};
+		buffer_operator::file_writer::options uploads = {};
+		buffer_operator::file_reader::options downloads = {};
 
 		options(){}
 	};
@@ -90,6 +100,29 @@ public:
 		require_tls
 	};
 
+	//! Counters of the TLS handshakes performed by the sessions, shared by all the sessions accepted by the same listener.
+	struct tls_handshake_counters
+	{
+		//! Control connections secured, either implicitly or via AUTH TLS.
+		std::atomic<std::uint64_t> control{};
+
+		//! Data connections that resumed the TLS session of their control connection.
+		std::atomic<std::uint64_t> data_resumed{};
+
+		//! Data connections that performed a full handshake, and thus got refused.
+		std::atomic<std::uint64_t> data_not_resumed{};
+
+		//! Data connections whose handshake failed altogether.
+		std::atomic<std::uint64_t> data_failed{};
+	};
+
+	//! The metrics the data traffic of the sessions is accounted to, shared by all the sessions accepted by the same listener.
+	struct listener_metrics
+	{
+		metrics::counter *received_bytes{};
+		metrics::counter *sent_bytes{};
+	};
+
 	session(fz::thread_pool &pool, event_loop &loop, event_handler &target_event_handler,
 			rate_limit_manager &rate_limit_manager,
 			std::unique_ptr<notifier> notifier,
@@ -97,9 +130,16 @@ public:
 			datetime start,
 			std::unique_ptr<socket> control_socket,
 			tls_mode tls_mode,
+			std::shared_ptr<tls_handshake_counters> tls_handshake_counters,
+			listener_metrics listener_metrics,
 			authentication::autobanner &autobanner,
 			authentication::authenticator &authenticator,
 			port_manager &port_manager,
+			tls_handshake_throttler &tls_handshake_throttler,
+			buffer_budget &data_buffers_budget,
+			hash_engine &hash_engine,
+			small_file_cache &small_file_cache,
+			timer_wheel &timer_wheel,
 			const commander::welcome_message_t &welcome_message,
 			const std::string &refuse_message,
 			options opts = {});
@@ -121,8 +161,10 @@ private:
 	protocol_info get_protocol_info() const;
 	void update_limits(compound_rate_limited_layer *crll, std::vector<std::shared_ptr<rate_limiter> > *extra = {});
 	void do_set_buffer_sizes();
+	void apply_data_buffer_size(std::size_t size);
 
 	rate_limiter session_limiter_;
+	bool session_limited_{};
 	std::shared_ptr<rate_limiter> user_limiter_{};
 	std::vector<std::shared_ptr<rate_limiter>> extra_limiters_{};
 	compound_rate_limited_layer *control_limiter_{};
@@ -137,7 +179,14 @@ private:
 
 	datetime start_datetime_;
 	securable_socket control_socket_;
+	std::shared_ptr<tls_handshake_counters> tls_handshake_counters_;
+	listener_metrics listener_metrics_;
+	monotonic_clock tls_handshake_start_;
 	port_manager &port_manager_;
+	tls_handshake_throttler &tls_handshake_throttler_;
+	tls_handshake_throttler::slot tls_handshake_slot_;
+	std::string tls_handshake_preamble_;
+	controller::make_secure_response_handler *tls_handshake_response_handler_{};
 
 	options opts_;
 	std::int32_t receive_buffer_size_ = -1;
@@ -147,6 +196,7 @@ private:
 
 	tvfs::engine tvfs_;
 	commander commander_;
+	timer_wheel &timer_wheel_;
 	authentication::autobanner &autobanner_;
 	monotonic_clock time_of_first_failed_login_attempt_;
 	std::size_t current_number_of_failed_login_attempts_{};
@@ -189,6 +239,7 @@ private:
 
 	hostaddress data_peer_hostaddress_{};
 	channel data_channel_{*this, 128*1024, 10, false, *this};
+	adaptive_buffer_size data_buffer_size_;
 	data_protection_mode data_protection_mode_{data_protection_mode::C};
 
 private:
@@ -208,8 +259,14 @@ private:
 	void on_hostname_lookup_event(hostname_lookup*, int, const std::vector<std::string> &ips);
 	void on_shared_user_changed_event(const authentication::weak_user &su);
 	void on_timer_event(timer_id id);
+	void on_tls_handshake_granted_event(tls_handshake_throttler::slot *);
+	void on_tls_handshake_timeout();
 
 private:
+	//! If response_handler is nullptr, the control connection is made secure implicitly.
+	void secure_control_connection(std::string_view preamble, controller::make_secure_response_handler *response_handler);
+	void record_tls_handshake_duration();
+
 	bool setup_data_channel();
 	void data_socket_shutdown(channel::error_type error);
 	bool handle_data_transfer(data_transfer_handler::status, channel::error_type error, std::string_view msg = {});
@@ -227,6 +284,13 @@ private:
 
 	timer_id check_if_control_is_secured_id_{};
 
+	//! Expires once no data transfers have taken place for a while, at which point the memory they need is released.
+	timer_wheel::entry data_idle_{timer_wheel_, [this]{ release_data_resources(); }};
+	void release_data_resources();
+
+	//! Expires if the TLS handshake of the control connection takes too long.
+	timer_wheel::entry tls_handshake_deadline_{timer_wheel_, [this]{ on_tls_handshake_timeout(); }};
+
 private:
 	static std::string logger_info_to_string(const logger::modularized::info &i, const logger::modularized::info_list &parent_info_list);
 
@@ -0,0 +1,405 @@
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/hash.hpp>
+#include <libfilezilla/local_filesys.hpp>
+#include <libfilezilla/uri.hpp>
+
+#include "util/io.hpp"
+#include "string.hpp"
+
+#include "hash_engine.hpp"
+
+namespace fz {
+
+namespace {
+
+// CRC-32, as used by zip and expected by XCRC, computed 8 bytes at a time (slicing-by-8).
+class crc32
+{
+public:
+	void update(const std::uint8_t *p, std::size_t n)
+	{
+		static const tables tables;
+		auto &t = tables.t;
+
+		auto crc = ~crc_;
+
+		for (; n >= 8; p += 8, n -= 8) {
+			std::uint32_t a = crc ^ (std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24);
+			std::uint32_t b = std::uint32_t(p[4]) | std::uint32_t(p[5]) << 8 | std::uint32_t(p[6]) << 16 | std::uint32_t(p[7]) << 24;
+
+			crc = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24]
+			    ^ t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+		}
+
+		for (; n > 0; ++p, --n)
+			crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+
+		crc_ = ~crc;
+	}
+
+	std::string hex_digest() const
+	{
+		return fz::sprintf("%08x", crc_);
+	}
+
+private:
+	struct tables
+	{
+		std::uint32_t t[8][256];
+
+		tables()
+		{
+			for (std::uint32_t i = 0; i < 256; ++i) {
+				std::uint32_t c = i;
+
+				for (int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+
+				t[0][i] = c;
+			}
+
+			for (std::size_t s = 1; s < 8; ++s) {
+				for (std::size_t i = 0; i < 256; ++i)
+					t[s][i] = (t[s-1][i] >> 8) ^ t[0][t[s-1][i] & 0xFF];
+			}
+		}
+	};
+
+	std::uint32_t crc_{};
+};
+
+hash_algorithm to_hash_algorithm(hash_engine::algorithm algo)
+{
+	switch (algo) {
+		case hash_engine::algorithm::md5: return hash_algorithm::md5;
+		case hash_engine::algorithm::sha1: return hash_algorithm::sha1;
+		case hash_engine::algorithm::sha512: return hash_algorithm::sha512;
+		default: return hash_algorithm::sha256;
+	}
+}
+
+constexpr std::string_view index_header = "fz-hash-index 1";
+constexpr std::size_t read_size = 256*1024;
+const auto index_save_interval = duration::from_minutes(5);
+
+std::int64_t to_milliseconds(const datetime &dt)
+{
+	if (dt.empty())
+		return -1;
+
+	return dt.get_time_t() * 1000 + dt.get_milliseconds();
+}
+
+}
+
+std::string_view hash_engine::to_string(algorithm algo)
+{
+	switch (algo) {
+		case algorithm::crc32: return "CRC32";
+		case algorithm::md5: return "MD5";
+		case algorithm::sha1: return "SHA-1";
+		case algorithm::sha256: return "SHA-256";
+		case algorithm::sha512: return "SHA-512";
+	}
+
+	return {};
+}
+
+std::optional<hash_engine::algorithm> hash_engine::from_string(std::string_view name)
+{
+	for (auto algo: { algorithm::crc32, algorithm::md5, algorithm::sha1, algorithm::sha256, algorithm::sha512 }) {
+		if (equal_insensitive_ascii(name, to_string(algo)))
+			return algo;
+	}
+
+	return std::nullopt;
+}
+
+hash_engine::hash_engine(thread_pool &pool, logger_interface &logger, options opts)
+	: logger_(logger, "Hash Engine")
+	, pool_(pool)
+{
+	set_options(std::move(opts));
+}
+
+hash_engine::~hash_engine()
+{
+	{
+		scoped_lock lock(mutex_);
+		quit_ = true;
+		condition_.signal(lock);
+	}
+
+	for (auto &w: workers_)
+		w.join();
+
+	save_index();
+}
+
+void hash_engine::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = std::move(opts);
+
+	for (auto n = std::max(opts_.num_threads(), std::uint32_t(1)); num_workers_ < n; ++num_workers_)
+		workers_.push_back(pool_.spawn([this]{ work(); }));
+
+	trim_cache();
+
+	// Workers in excess, if any, must notice.
+	condition_.signal(lock);
+}
+
+void hash_engine::set_index_path(native_string path)
+{
+	{
+		scoped_lock lock(mutex_);
+
+		if (index_path_ == path)
+			return;
+
+		index_path_ = std::move(path);
+	}
+
+	load_index();
+}
+
+void hash_engine::async_hash(request r, receiver_handle<completion_event> h)
+{
+	auto key = cache_key(r);
+
+	scoped_lock lock(mutex_);
+
+	if (!key.empty()) {
+		if (auto it = cache_.find(key); it != cache_.end()) {
+			if (it->second.size == r.size && it->second.mtime == to_milliseconds(r.mtime)) {
+				lru_.splice(lru_.end(), lru_, it->second.lru_it);
+				h(0, it->second.digest);
+				return;
+			}
+		}
+	}
+
+	jobs_.push_back({std::move(r), std::move(h)});
+	condition_.signal(lock);
+}
+
+std::string hash_engine::cache_key(const request &r)
+{
+	if (r.id.empty())
+		return {};
+
+	return fz::sprintf("%s\n%s\n%d\n%d", r.id, std::string(to_string(r.algo)), r.begin, r.end);
+}
+
+void hash_engine::work()
+{
+	scoped_lock lock(mutex_);
+
+	while (true) {
+		while (!quit_ && jobs_.empty() && num_workers_ <= std::max(opts_.num_threads(), std::uint32_t(1)))
+			condition_.wait(lock);
+
+		if (quit_ || num_workers_ > std::max(opts_.num_threads(), std::uint32_t(1))) {
+			if (!quit_)
+				--num_workers_;
+
+			// Wake the next worker up, so that it gets to notice too.
+			condition_.signal(lock);
+			return;
+		}
+
+		auto j = std::move(jobs_.front());
+		jobs_.pop_front();
+
+		if (!jobs_.empty())
+			condition_.signal(lock);
+
+		lock.unlock();
+
+		std::string digest;
+		int error = compute(j, digest);
+		j.r.file.close();
+
+		lock.lock();
+
+		if (!error) {
+			if (auto key = cache_key(j.r); !key.empty())
+				cache(key, j.r, digest);
+		}
+
+		j.h(error, std::move(digest));
+
+		if (index_dirty_ && !index_path_.empty() && monotonic_clock::now() - index_saved_at_ >= index_save_interval) {
+			lock.unlock();
+			save_index();
+			lock.lock();
+		}
+	}
+}
+
+int hash_engine::compute(job &j, std::string &digest)
+{
+	auto &r = j.r;
+
+	auto size = r.file.size();
+	if (size < 0)
+		return EIO;
+
+	auto end = r.end < 0 ? size : std::min(r.end, size);
+	if (r.begin < 0 || r.begin > end)
+		return EINVAL;
+
+	if (r.file.seek(r.begin, file::begin) != r.begin)
+		return EIO;
+
+	crc32 crc;
+	std::optional<hash_accumulator> acc;
+
+	if (r.algo != algorithm::crc32)
+		acc.emplace(to_hash_algorithm(r.algo));
+
+	std::vector<std::uint8_t> buf(read_size);
+
+	for (auto remaining = end - r.begin; remaining > 0;) {
+		// Nobody is waiting for the result anymore.
+		if (!j.h)
+			return ECANCELED;
+
+		auto read = r.file.read(buf.data(), std::min(remaining, std::int64_t(buf.size())));
+		if (read <= 0)
+			return EIO;
+
+		if (acc)
+			acc->update(buf.data(), std::size_t(read));
+		else
+			crc.update(buf.data(), std::size_t(read));
+
+		remaining -= read;
+	}
+
+	digest = acc ? hex_encode<std::string>(acc->digest()) : crc.hex_digest();
+
+	return 0;
+}
+
+void hash_engine::cache(const std::string &key, const request &r, const std::string &digest)
+{
+	if (opts_.cache_capacity() == 0)
+		return;
+
+	auto [it, inserted] = cache_.try_emplace(key);
+
+	if (inserted)
+		it->second.lru_it = lru_.insert(lru_.end(), key);
+	else
+		lru_.splice(lru_.end(), lru_, it->second.lru_it);
+
+	it->second.size = r.size;
+	it->second.mtime = to_milliseconds(r.mtime);
+	it->second.digest = digest;
+
+	index_dirty_ = true;
+
+	trim_cache();
+}
+
+void hash_engine::trim_cache()
+{
+	while (cache_.size() > opts_.cache_capacity()) {
+		cache_.erase(lru_.front());
+		lru_.pop_front();
+		index_dirty_ = true;
+	}
+}
+
+/*
+The index is a text file. After the header line, each line holds one digest:
+
+    <percent encoded cache key> <size> <mtime in milliseconds> <digest>
+
+The least recently used digests come first.
+*/
+
+void hash_engine::load_index()
+{
+	scoped_lock lock(mutex_);
+
+	cache_.clear();
+	lru_.clear();
+	index_dirty_ = false;
+	index_saved_at_ = monotonic_clock::now();
+
+	if (index_path_.empty())
+		return;
+
+	auto data = util::io::read(index_path_);
+	auto lines = strtok_view(data.to_view(), "\r\n");
+
+	if (lines.empty())
+		return;
+
+	if (lines[0] != index_header) {
+		logger_.log_u(logmsg::error, L"Ignoring the hash index file \"%s\", its format is unknown.", index_path_);
+		return;
+	}
+
+	for (std::size_t i = 1; i < lines.size(); ++i) {
+		auto fields = strtok_view(lines[i], " ");
+		if (fields.size() != 4)
+			continue;
+
+		auto key = percent_decode_s(fields[0]);
+		if (key.empty())
+			continue;
+
+		auto [it, inserted] = cache_.try_emplace(std::move(key));
+		if (!inserted)
+			continue;
+
+		it->second.size = to_integral<std::int64_t>(fields[1]);
+		it->second.mtime = to_integral<std::int64_t>(fields[2]);
+		it->second.digest = std::string(fields[3]);
+		it->second.lru_it = lru_.insert(lru_.end(), it->first);
+	}
+
+	trim_cache();
+
+	logger_.log_u(logmsg::debug_info, L"Loaded %d digests from the hash index file \"%s\".", cache_.size(), index_path_);
+}
+
+void hash_engine::save_index()
+{
+	native_string path;
+	std::string data;
+
+	{
+		scoped_lock lock(mutex_);
+
+		if (!index_dirty_ || index_path_.empty())
+			return;
+
+		path = index_path_;
+
+		data.append(index_header).append("\n");
+
+		for (auto &key: lru_) {
+			auto &d = cache_[key];
+			data.append(fz::sprintf("%s %d %d %s\n", percent_encode(key), d.size, d.mtime, d.digest));
+		}
+
+		index_dirty_ = false;
+		index_saved_at_ = monotonic_clock::now();
+	}
+
+	// Write to a temporary file first, so that a crash midway doesn't leave a truncated index behind.
+	auto tmp_path = path + fzT(".tmp");
+
+	if (!util::io::write(file(tmp_path, file::writing, file::empty | file::current_user_and_admins_only), data) || !rename_file(tmp_path, path)) {
+		logger_.log_u(logmsg::error, L"Could not write the hash index file \"%s\".", path);
+		remove_file(tmp_path);
+	}
+}
+
+}
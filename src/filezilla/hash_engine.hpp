@@ -0,0 +1,136 @@
+#ifndef FZ_HASH_ENGINE_HPP
+#define FZ_HASH_ENGINE_HPP
+
+#include <deque>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <libfilezilla/file.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/thread_pool.hpp>
+#include <libfilezilla/time.hpp>
+
+#include "logger/modularized.hpp"
+#include "receiver/handle.hpp"
+#include "util/options.hpp"
+
+namespace fz {
+
+/*
+Computes the digests of files on behalf of the FTP sessions, on a small set of threads of its own,
+so that hashing big files neither blocks the sessions' event loops nor starves the general purpose thread pool.
+
+Digests are cached, keyed by an id that identifies the file, plus the algorithm and the range, and are considered
+valid for as long as the file's size and modification time don't change. The cache can be persisted
+to an index file, so that repeating queries are free even across restarts.
+*/
+class hash_engine
+{
+public:
+	enum class algorithm: std::uint8_t
+	{
+		crc32,
+		md5,
+		sha1,
+		sha256,
+		sha512
+	};
+
+	//! \returns the name of the algorithm, as per the HASH command.
+	static std::string_view to_string(algorithm algo);
+	static std::optional<algorithm> from_string(std::string_view name);
+
+	struct options: util::options<options, hash_engine>
+	{
+		//! The number of threads devoted to hashing.
+		opt<std::uint32_t> num_threads = o(2);
+
+		//! The maximum number of digests kept in the cache. 0 disables caching.
+		opt<std::size_t> cache_capacity = o(std::size_t(64*1024));
+
+		options() {}
+	};
+
+	struct request
+	{
+		algorithm algo{};
+
+		//! Must be open for reading.
+		fz::file file;
+
+		//! The range to hash, end excluded. An end of -1 means up to the end of the file.
+		std::int64_t begin{};
+		std::int64_t end{-1};
+
+		//! Identifies the file across requests and sessions. If empty, the digest doesn't get cached.
+		std::string id;
+		std::int64_t size{};
+		datetime mtime{};
+	};
+
+	struct completion_event_tag{};
+
+	//! The error is 0 on success, in which case the digest is hex encoded. EINVAL means the range was invalid.
+	using completion_event = receiver_event<completion_event_tag, int /*error*/, std::string /*digest*/>;
+
+	hash_engine(thread_pool &pool, logger_interface &logger, options opts = {});
+	~hash_engine();
+
+	void set_options(options opts);
+
+	//! Loads the cache from the given index file, and makes it persist there. An empty path makes the cache not persistent.
+	void set_index_path(native_string path);
+
+	//! Hashes the file, unless a valid digest is already cached. The request is abandoned if the handle's receiver goes away meanwhile.
+	void async_hash(request r, receiver_handle<completion_event> h);
+
+private:
+	struct job
+	{
+		request r;
+		receiver_handle<completion_event> h;
+	};
+
+	struct cached_digest
+	{
+		std::int64_t size{};
+		std::int64_t mtime{};
+		std::string digest;
+		std::list<std::string>::iterator lru_it{};
+	};
+
+	static std::string cache_key(const request &r);
+
+	void work();
+	int compute(job &j, std::string &digest);
+
+	void cache(const std::string &key, const request &r, const std::string &digest);
+	void trim_cache();
+	void load_index();
+	void save_index();
+
+	logger::modularized logger_;
+	thread_pool &pool_;
+
+	mutable fz::mutex mutex_;
+	fz::condition condition_;
+
+	options opts_;
+	bool quit_{};
+	std::uint32_t num_workers_{};
+	std::vector<async_task> workers_;
+	std::deque<job> jobs_;
+
+	std::unordered_map<std::string, cached_digest> cache_;
+	std::list<std::string> lru_;
+
+	native_string index_path_;
+	bool index_dirty_{};
+	monotonic_clock index_saved_at_;
+};
+
+}
+
+#endif // FZ_HASH_ENGINE_HPP
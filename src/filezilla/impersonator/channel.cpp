@@ -7,6 +7,7 @@
 #include "../serialization/types/time.hpp"
 #include "../serialization/types/local_filesys.hpp"
 #include "../mpl/with_index.hpp"
+#include "../metrics/registry.hpp"
 
 namespace fz::impersonator {
 
@@ -352,6 +353,9 @@ void caller::on_can_recv()
 						logger_.log(logmsg::debug_debug, L"Added new timeout timer with id %d.", timer_id_);
 				}
 
+				static auto &round_trip = metrics::registry::global().get_histogram("fz_impersonator_call_duration_seconds", "Time elapsed between sending a request to the impersonator process and getting its response.");
+				round_trip.record_since(res.sent_at_);
+
 				logger_.log_u(logmsg::debug_info, L"[%s]: dispatching message", util::type_name<T>());
 
 				auto &r = static_cast<receiver_handle<make_receiver_event_t<T>>&>(res.receiver_handle_);
@@ -392,6 +396,8 @@ void caller::on_can_send()
 				return;
 			}
 
+			req.res_.sent_at_ = monotonic_clock::now();
+
 			if (timeout_) {
 				req.res_.deadline_ = monotonic_clock::now() + timeout_;
 
@@ -116,6 +116,7 @@ private:
 		receiver_handle_base receiver_handle_;
 		std::size_t expected_in_msg_id_{};
 		monotonic_clock deadline_{};
+		monotonic_clock sent_at_{};
 	};
 
 	struct reqres
@@ -0,0 +1,164 @@
+#include "http_exporter.hpp"
+
+#include "../http/message_consumer.hpp"
+#include "../buffer_operator/streamed_adder.hpp"
+
+namespace fz::metrics {
+
+class http_exporter::session
+	: public tcp::session
+	, public event_handler
+	, private buffer_operator::streamed_adder
+	, private http::message_consumer
+{
+public:
+	session(event_handler &target_handler, tcp::session::id id, std::unique_ptr<socket> socket, http_exporter &owner);
+
+	~session() override;
+
+private:
+	int process_message_start_line(std::string_view line) override;
+	int process_end_of_message_headers() override;
+
+	bool is_alive() const override;
+	void shutdown(int err = 0) override;
+
+	void operator()(const event_base &ev) override;
+
+	void respond(std::string_view status, std::string_view content_type, std::string_view body);
+
+private:
+	http_exporter &owner_;
+	bool is_metrics_request_{};
+	std::unique_ptr<socket> socket_;
+	channel channel_;
+};
+
+http_exporter::http_exporter(tcp::server_context &context, logger_interface &logger, registry &registry)
+	: logger_(logger, "Metrics exporter")
+	, registry_(registry)
+	, server_(context, logger_, *this)
+{
+}
+
+void http_exporter::set_port(unsigned int port)
+{
+	std::vector<tcp::address_info> address_infos;
+
+	if (port)
+		address_infos = { {"127.0.0.1", port}, {"::1", port} };
+
+	server_.set_listen_address_infos(address_infos.begin(), address_infos.end());
+
+	if (port)
+		server_.start();
+	else
+		server_.stop(true);
+}
+
+std::unique_ptr<tcp::session> http_exporter::make_session(event_handler &target_handler, tcp::session::id id, std::unique_ptr<socket> socket, const std::any &, int &error)
+{
+	if (!socket || error)
+		return {};
+
+	auto ip = socket->peer_ip();
+	std::string_view ip_view = ip;
+
+	bool is_loopback = socket->address_family() == address_type::ipv4
+		? fz::starts_with(ip_view, std::string_view("127."))
+		: ip_view == "::1" || fz::starts_with(ip_view, std::string_view("::ffff:127."));
+
+	if (!is_loopback) {
+		logger_.log_u(logmsg::error, L"Refusing connection from non-local address %s.", ip);
+		error = EACCES;
+		return {};
+	}
+
+	return std::make_unique<session>(target_handler, id, std::move(socket), *this);
+}
+
+http_exporter::session::session(event_handler &target_handler, tcp::session::id id, std::unique_ptr<socket> socket, http_exporter &owner)
+	: tcp::session(target_handler, id, {socket->peer_ip(), socket->address_family()})
+	, event_handler(target_handler.event_loop_)
+	, streamed_adder()
+	, http::message_consumer(owner.logger_, 4096)
+	, owner_(owner)
+	, socket_(std::move(socket))
+	, channel_(*this, 64*1024, 5, false)
+{
+	channel_.set_buffer_adder(this);
+	channel_.set_buffer_consumer(this);
+	channel_.set_socket(socket_.get());
+}
+
+http_exporter::session::~session()
+{
+	remove_handler();
+}
+
+int http_exporter::session::process_message_start_line(std::string_view line)
+{
+	static const std::string_view http_ver = "HTTP/1.";
+
+	auto parts = fz::strtok_view(line, " ", false);
+
+	if (parts.size() != 3 || !fz::starts_with(parts[2], http_ver)) {
+		respond("400 Bad Request", "text/plain", "Malformed request.\n");
+		return 0;
+	}
+
+	if (parts[0] != "GET") {
+		respond("405 Method Not Allowed", "text/plain", "Only GET is supported.\n");
+		return 0;
+	}
+
+	if (parts[1] != "/metrics") {
+		respond("404 Not Found", "text/plain", "Try /metrics.\n");
+		return 0;
+	}
+
+	is_metrics_request_ = true;
+	return 0;
+}
+
+int http_exporter::session::process_end_of_message_headers()
+{
+	if (is_metrics_request_) {
+		is_metrics_request_ = false;
+		respond("200 OK", "text/plain; version=0.0.4", owner_.registry_.to_text());
+	}
+
+	return 0;
+}
+
+void http_exporter::session::respond(std::string_view status, std::string_view content_type, std::string_view body)
+{
+	buffer_stream()
+		<< "HTTP/1.1 " << status << "\r\n"
+		   "Connection: close\r\n"
+		   "Content-Type: " << content_type << "\r\n"
+		   "Content-Length: " << body.size() << "\r\n"
+		   "\r\n"
+		<< body;
+
+	channel_.shutdown();
+}
+
+bool http_exporter::session::is_alive() const
+{
+	return socket_ != nullptr;
+}
+
+void http_exporter::session::shutdown(int err)
+{
+	channel_.shutdown(err);
+}
+
+void http_exporter::session::operator()(const event_base &ev)
+{
+	fz::dispatch<channel::done_event>(ev, [this](channel &, channel::error_type error){
+		target_handler_.send_event<ended_event>(id_, error);
+	});
+}
+
+}
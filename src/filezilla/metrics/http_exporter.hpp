@@ -0,0 +1,37 @@
+#ifndef FZ_METRICS_HTTP_EXPORTER_HPP
+#define FZ_METRICS_HTTP_EXPORTER_HPP
+
+#include "../tcp/server.hpp"
+#include "../logger/modularized.hpp"
+
+#include "registry.hpp"
+
+namespace fz::metrics {
+
+/*
+Serves the metrics of a registry over HTTP, in the Prometheus text exposition format, at GET /metrics.
+
+The endpoint is local only: it listens on the loopback interfaces, and refuses connections from
+anywhere else, should they ever come. There's no authentication whatsoever.
+*/
+class http_exporter: private tcp::session::factory
+{
+	class session;
+
+public:
+	http_exporter(tcp::server_context &context, logger_interface &logger, registry &registry = registry::global());
+
+	//! Listens on 127.0.0.1 and ::1, on the given port. 0 disables the endpoint.
+	void set_port(unsigned int port);
+
+private:
+	std::unique_ptr<tcp::session> make_session(event_handler &target_handler, tcp::session::id id, std::unique_ptr<socket> socket, const std::any &user_data, int &error /* In-Out */) override;
+
+	logger::modularized logger_;
+	registry &registry_;
+	tcp::server server_;
+};
+
+}
+
+#endif // FZ_METRICS_HTTP_EXPORTER_HPP
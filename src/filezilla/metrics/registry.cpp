@@ -0,0 +1,231 @@
+#include <utility>
+
+#include <libfilezilla/format.hpp>
+
+#include "registry.hpp"
+
+namespace fz::metrics {
+
+std::size_t detail::this_thread_cell_index() noexcept
+{
+	static std::atomic<std::size_t> next_index{};
+	thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+
+	return index;
+}
+
+std::uint64_t counter::value() const noexcept
+{
+	std::uint64_t sum = 0;
+
+	for (auto &c: cells_)
+		sum += c.value.load(std::memory_order_relaxed);
+
+	return sum;
+}
+
+gauge::holder::holder(gauge &g, std::int64_t n) noexcept
+	: gauge_(&g)
+	, n_(n)
+{
+	gauge_->add(n_);
+}
+
+gauge::holder::~holder()
+{
+	if (gauge_)
+		gauge_->sub(n_);
+}
+
+gauge::holder::holder(holder &&rhs) noexcept
+	: gauge_(std::exchange(rhs.gauge_, nullptr))
+	, n_(rhs.n_)
+{
+}
+
+gauge::holder &gauge::holder::operator=(holder &&rhs) noexcept
+{
+	if (this != &rhs) {
+		if (gauge_)
+			gauge_->sub(n_);
+
+		gauge_ = std::exchange(rhs.gauge_, nullptr);
+		n_ = rhs.n_;
+	}
+
+	return *this;
+}
+
+histogram::snapshot histogram::get_snapshot() const noexcept
+{
+	snapshot s;
+
+	for (std::size_t i = 0; i < num_buckets; ++i) {
+		s.counts[i] = buckets_[i].load(std::memory_order_relaxed);
+		s.count += s.counts[i];
+	}
+
+	s.sum = sum_.load(std::memory_order_relaxed);
+
+	return s;
+}
+
+std::uint64_t histogram::snapshot::quantile(double q) const noexcept
+{
+	if (count == 0)
+		return 0;
+
+	auto rank = std::uint64_t(q * double(count - 1)) + 1;
+	std::uint64_t seen = 0;
+
+	for (std::size_t i = 0; i < num_buckets; ++i) {
+		seen += counts[i];
+		if (seen >= rank)
+			return bucket_upper_bound(i);
+	}
+
+	return bucket_upper_bound(num_buckets - 1);
+}
+
+registry &registry::global()
+{
+	static registry r;
+	return r;
+}
+
+template <typename T>
+T &registry::get(std::map<std::string, family<T>, std::less<>> &families, std::string_view name, std::string_view help, labels &&l)
+{
+	scoped_lock lock(mutex_);
+
+	auto it = families.find(name);
+	if (it == families.end())
+		it = families.emplace(std::string(name), family<T>{std::string(help), {}}).first;
+
+	auto &m = it->second.metrics[std::move(l)];
+	if (!m)
+		m = std::make_unique<T>();
+
+	return *m;
+}
+
+counter &registry::get_counter(std::string_view name, std::string_view help, labels l)
+{
+	return get(counters_, name, help, std::move(l));
+}
+
+gauge &registry::get_gauge(std::string_view name, std::string_view help, labels l)
+{
+	return get(gauges_, name, help, std::move(l));
+}
+
+histogram &registry::get_histogram(std::string_view name, std::string_view help, labels l)
+{
+	return get(histograms_, name, help, std::move(l));
+}
+
+namespace {
+
+std::string escape(std::string_view s)
+{
+	std::string ret;
+	ret.reserve(s.size());
+
+	for (auto c: s) {
+		if (c == '\\' || c == '"')
+			ret.append(1, '\\').append(1, c);
+		else
+		if (c == '\n')
+			ret.append("\\n");
+		else
+			ret.append(1, c);
+	}
+
+	return ret;
+}
+
+std::string format_labels(const labels &l, std::string_view extra_name = {}, std::string_view extra_value = {})
+{
+	if (l.empty() && extra_name.empty())
+		return {};
+
+	std::string ret = "{";
+
+	for (auto &[n, v]: l) {
+		if (ret.size() > 1)
+			ret.append(1, ',');
+
+		ret.append(n).append("=\"").append(escape(v)).append(1, '"');
+	}
+
+	if (!extra_name.empty()) {
+		if (ret.size() > 1)
+			ret.append(1, ',');
+
+		ret.append(extra_name).append("=\"").append(extra_value).append(1, '"');
+	}
+
+	ret.append(1, '}');
+
+	return ret;
+}
+
+std::string to_seconds(std::uint64_t microseconds)
+{
+	return fz::sprintf("%d.%06d", microseconds / 1000000, microseconds % 1000000);
+}
+
+void append_header(std::string &out, const std::string &name, const std::string &help, std::string_view type)
+{
+	out.append("# HELP ").append(name).append(1, ' ').append(escape(help)).append(1, '\n');
+	out.append("# TYPE ").append(name).append(1, ' ').append(type).append(1, '\n');
+}
+
+}
+
+std::string registry::to_text() const
+{
+	std::string out;
+
+	scoped_lock lock(mutex_);
+
+	for (auto &[name, f]: counters_) {
+		append_header(out, name, f.help, "counter");
+
+		for (auto &[l, c]: f.metrics)
+			out.append(name).append(format_labels(l)).append(1, ' ').append(std::to_string(c->value())).append(1, '\n');
+	}
+
+	for (auto &[name, f]: gauges_) {
+		append_header(out, name, f.help, "gauge");
+
+		for (auto &[l, g]: f.metrics)
+			out.append(name).append(format_labels(l)).append(1, ' ').append(std::to_string(g->value())).append(1, '\n');
+	}
+
+	for (auto &[name, f]: histograms_) {
+		append_header(out, name, f.help, "histogram");
+
+		for (auto &[l, h]: f.metrics) {
+			auto s = h->get_snapshot();
+
+			// Only the buckets that hold anything are emitted, the buckets being cumulative nothing gets lost.
+			std::uint64_t cumulative = 0;
+			for (std::size_t i = 0; i < histogram::num_buckets; ++i) {
+				if (!s.counts[i])
+					continue;
+
+				cumulative += s.counts[i];
+				out.append(name).append("_bucket").append(format_labels(l, "le", to_seconds(histogram::bucket_upper_bound(i)))).append(1, ' ').append(std::to_string(cumulative)).append(1, '\n');
+			}
+
+			out.append(name).append("_bucket").append(format_labels(l, "le", "+Inf")).append(1, ' ').append(std::to_string(s.count)).append(1, '\n');
+			out.append(name).append("_sum").append(format_labels(l)).append(1, ' ').append(to_seconds(s.sum)).append(1, '\n');
+			out.append(name).append("_count").append(format_labels(l)).append(1, ' ').append(std::to_string(s.count)).append(1, '\n');
+		}
+	}
+
+	return out;
+}
+
+}
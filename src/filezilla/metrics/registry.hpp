@@ -0,0 +1,217 @@
+#ifndef FZ_METRICS_REGISTRY_HPP
+#define FZ_METRICS_REGISTRY_HPP
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
+
+namespace fz::metrics {
+
+/*
+In-process metrics, meant to be scraped by external tools.
+
+Updating a metric is a matter of a few relaxed atomic operations and nothing else happens
+until somebody asks for a snapshot of the registry, so they can stay enabled at all times.
+Looking a metric up in the registry, on the other hand, involves locking: the hot paths
+must get hold of the metrics they update once and for all, and keep the references around.
+Metrics, once created, live as long as the registry does.
+*/
+
+using labels = std::vector<std::pair<std::string, std::string>>;
+
+namespace detail {
+
+	//! Each thread gets its own cell of the striped counters, assigned round robin.
+	std::size_t this_thread_cell_index() noexcept;
+
+}
+
+//! A monotonically increasing count. Increments are spread over several cache lines, so that threads don't contend over them.
+class counter
+{
+public:
+	static constexpr std::size_t num_cells = 8;
+
+	void add(std::uint64_t n = 1) noexcept
+	{
+		cells_[detail::this_thread_cell_index() % num_cells].value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	std::uint64_t value() const noexcept;
+
+private:
+	struct alignas(64) cell
+	{
+		std::atomic<std::uint64_t> value{};
+	};
+
+	std::array<cell, num_cells> cells_{};
+};
+
+//! A value that can go up and down.
+class gauge
+{
+public:
+	//! Adds to the gauge on construction, subtracts the same amount on destruction.
+	class holder
+	{
+	public:
+		holder() noexcept = default;
+		explicit holder(gauge &g, std::int64_t n = 1) noexcept;
+		~holder();
+
+		holder(holder &&rhs) noexcept;
+		holder &operator=(holder &&rhs) noexcept;
+
+		holder(const holder &) = delete;
+		holder &operator=(const holder &) = delete;
+
+	private:
+		gauge *gauge_{};
+		std::int64_t n_{};
+	};
+
+	void add(std::int64_t n = 1) noexcept
+	{
+		value_.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	void sub(std::int64_t n = 1) noexcept
+	{
+		value_.fetch_sub(n, std::memory_order_relaxed);
+	}
+
+	void set(std::int64_t n) noexcept
+	{
+		value_.store(n, std::memory_order_relaxed);
+	}
+
+	std::int64_t value() const noexcept
+	{
+		return value_.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<std::int64_t> value_{};
+};
+
+/*
+A latency histogram, HDR style: values are in microseconds and each power of two is split into
+sub_buckets linear buckets, which keeps the relative error within 1/sub_buckets over the whole range.
+*/
+class histogram
+{
+public:
+	static constexpr std::size_t sub_bucket_bits = 3;
+	static constexpr std::size_t sub_buckets = 1 << sub_bucket_bits;
+	static constexpr std::size_t num_buckets = sub_buckets + (64 - sub_bucket_bits) * sub_buckets;
+
+	struct snapshot
+	{
+		std::array<std::uint64_t, num_buckets> counts{};
+		std::uint64_t count{};
+		std::uint64_t sum{};
+
+		//! \returns the upper bound of the bucket holding the value at the given quantile, in microseconds.
+		std::uint64_t quantile(double q) const noexcept;
+	};
+
+	void record(std::uint64_t microseconds) noexcept
+	{
+		buckets_[bucket_index(microseconds)].fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(microseconds, std::memory_order_relaxed);
+	}
+
+	void record(duration d) noexcept
+	{
+		auto us = d.get_microseconds();
+		record(us > 0 ? std::uint64_t(us) : 0);
+	}
+
+	//! Records the time elapsed since the given time point.
+	void record_since(const monotonic_clock &start) noexcept
+	{
+		record(monotonic_clock::now() - start);
+	}
+
+	snapshot get_snapshot() const noexcept;
+
+	static constexpr std::size_t bucket_index(std::uint64_t v) noexcept
+	{
+		if (v < sub_buckets)
+			return std::size_t(v);
+
+		std::size_t msb = 63;
+		while (!(v >> msb))
+			--msb;
+
+		auto shift = msb - sub_bucket_bits;
+		return sub_buckets + shift * sub_buckets + std::size_t((v >> shift) & (sub_buckets - 1));
+	}
+
+	//! \returns the biggest value that falls in the bucket with the given index.
+	static constexpr std::uint64_t bucket_upper_bound(std::size_t i) noexcept
+	{
+		if (i < sub_buckets)
+			return i;
+
+		auto shift = (i - sub_buckets) / sub_buckets;
+		auto sub = (i - sub_buckets) % sub_buckets;
+		auto lower = std::uint64_t(sub_buckets + sub) << shift;
+
+		return lower + ((std::uint64_t(1) << shift) - 1);
+	}
+
+private:
+	std::array<std::atomic<std::uint64_t>, num_buckets> buckets_{};
+	std::atomic<std::uint64_t> sum_{};
+};
+
+class registry
+{
+public:
+	//! The registry the server's subsystems register their metrics with.
+	static registry &global();
+
+	registry() = default;
+	registry(const registry &) = delete;
+	registry &operator=(const registry &) = delete;
+
+	//! \returns the metric with the given name and labels, creating it if it doesn't exist yet.
+	//! A name must always be used for metrics of the same kind.
+	counter &get_counter(std::string_view name, std::string_view help, labels l = {});
+	gauge &get_gauge(std::string_view name, std::string_view help, labels l = {});
+
+	//! Histograms are exported in seconds, hence their name should end with _seconds.
+	histogram &get_histogram(std::string_view name, std::string_view help, labels l = {});
+
+	//! \returns all the metrics, in the Prometheus text exposition format.
+	std::string to_text() const;
+
+private:
+	template <typename T>
+	struct family
+	{
+		std::string help;
+		std::map<labels, std::unique_ptr<T>> metrics;
+	};
+
+	template <typename T>
+	T &get(std::map<std::string, family<T>, std::less<>> &families, std::string_view name, std::string_view help, labels &&l);
+
+	mutable fz::mutex mutex_;
+
+	std::map<std::string, family<counter>, std::less<>> counters_;
+	std::map<std::string, family<gauge>, std::less<>> gauges_;
+	std::map<std::string, family<histogram>, std::less<>> histograms_;
+};
+
+}
+
+#endif // FZ_METRICS_REGISTRY_HPP
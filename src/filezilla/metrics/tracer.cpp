@@ -0,0 +1,148 @@
+#include <libfilezilla/format.hpp>
+
+#include "tracer.hpp"
+
+namespace fz::metrics {
+
+tracer &tracer::global()
+{
+	static tracer t;
+	return t;
+}
+
+tracer::tracer(options opts)
+{
+	set_options(std::move(opts));
+}
+
+void tracer::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	auto capacity = std::max<std::size_t>(opts.capacity(), 1);
+
+	if (capacity != ring_.size()) {
+		ring_.clear();
+		ring_.resize(capacity);
+		next_ = 0;
+		wrapped_ = false;
+	}
+
+	sample_one_in_.store(opts.sample_one_in(), std::memory_order_relaxed);
+}
+
+std::uint64_t tracer::sample() noexcept
+{
+	auto one_in = sample_one_in_.load(std::memory_order_relaxed);
+	if (!one_in)
+		return 0;
+
+	auto n = sample_counter_.fetch_add(1, std::memory_order_relaxed);
+	if (n % one_in)
+		return 0;
+
+	// Ids must never be 0, which means "not traced".
+	return n + 1;
+}
+
+std::int64_t tracer::now() const noexcept
+{
+	return (monotonic_clock::now() - epoch_).get_microseconds();
+}
+
+void tracer::record(const span &s)
+{
+	scoped_lock lock(mutex_);
+
+	ring_[next_] = s;
+
+	if (++next_ == ring_.size()) {
+		next_ = 0;
+		wrapped_ = true;
+	}
+}
+
+std::string tracer::to_chrome_json() const
+{
+	std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	scoped_lock lock(mutex_);
+
+	std::size_t begin = wrapped_ ? next_ : 0;
+	std::size_t count = wrapped_ ? ring_.size() : next_;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		auto &s = ring_[(begin + i) % ring_.size()];
+
+		if (i > 0)
+			out.append(1, ',');
+
+		// Names and commands are literals of our own making, they need no escaping.
+		out.append(fz::sprintf("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%d,\"dur\":%d,\"args\":{\"command\":\"%s\",\"command_id\":%d",
+			std::string(s.name), s.is_command ? "command" : "phase", s.session_id, s.start, s.duration, std::string(s.command), s.command_id));
+
+		if (s.reply)
+			out.append(fz::sprintf(",\"reply\":%d", s.reply));
+
+		out.append("}}");
+	}
+
+	out.append("]}");
+
+	return out;
+}
+
+void command_trace::begin(std::uint64_t session_id, std::string_view command)
+{
+	end(0);
+
+	auto &t = tracer::global();
+
+	if (auto id = t.sample()) {
+		command_.name = command;
+		command_.command = command;
+		command_.session_id = session_id;
+		command_.command_id = id;
+		command_.start = t.now();
+		command_.duration = 0;
+		command_.is_command = true;
+
+		phase_ = command_;
+		phase_.name = {};
+		phase_.is_command = false;
+	}
+}
+
+void command_trace::do_phase(std::string_view name)
+{
+	auto &t = tracer::global();
+	auto now = t.now();
+
+	if (!phase_.name.empty()) {
+		phase_.duration = now - phase_.start;
+		t.record(phase_);
+	}
+
+	phase_.name = name;
+	phase_.start = now;
+}
+
+void command_trace::do_end(int reply)
+{
+	auto &t = tracer::global();
+	auto now = t.now();
+
+	if (!phase_.name.empty()) {
+		phase_.duration = now - phase_.start;
+		t.record(phase_);
+	}
+
+	command_.duration = now - command_.start;
+	command_.reply = reply;
+	t.record(command_);
+
+	command_ = {};
+	phase_ = {};
+}
+
+}
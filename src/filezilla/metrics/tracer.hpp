@@ -0,0 +1,123 @@
+#ifndef FZ_METRICS_TRACER_HPP
+#define FZ_METRICS_TRACER_HPP
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
+
+#include "../util/options.hpp"
+
+namespace fz::metrics {
+
+/*
+Records the lifecycle of a sample of the FTP commands, broken down into phases, so that one can tell
+where the time went when a command is slow: in the filesystem, in setting the data connection up,
+in the transfer itself, and so forth.
+
+Spans are kept in a fixed size ring buffer, the oldest ones being overwritten, and can be exported
+in the Chrome trace event format, which both chrome://tracing and Perfetto can load.
+
+Whether a command is traced is decided when it starts. Commands that aren't traced cost a branch.
+*/
+class tracer
+{
+public:
+	struct options: util::options<options, tracer>
+	{
+		//! One command every sample_one_in gets traced. 0 disables tracing altogether.
+		opt<std::uint32_t> sample_one_in = o(0);
+
+		//! The number of spans the ring buffer can hold.
+		opt<std::size_t> capacity = o(std::size_t(16*1024));
+
+		options() {}
+	};
+
+	struct span
+	{
+		//! Both name and command must be string literals, or anyway have static storage.
+		std::string_view name;
+		std::string_view command;
+
+		std::uint64_t session_id{};
+		std::uint64_t command_id{};
+
+		//! Microseconds since the tracer came to life.
+		std::int64_t start{};
+		std::int64_t duration{};
+
+		//! The final reply code of the command, if known. Always 0 for the phases.
+		int reply{};
+
+		bool is_command{};
+	};
+
+	static tracer &global();
+
+	tracer(options opts = {});
+
+	void set_options(options opts);
+
+	//! \returns the id the command must be traced with, or 0 if it mustn't be traced.
+	std::uint64_t sample() noexcept;
+
+	std::int64_t now() const noexcept;
+
+	void record(const span &s);
+
+	//! \returns the spans currently held in the ring buffer, in the Chrome trace event format.
+	std::string to_chrome_json() const;
+
+private:
+	monotonic_clock epoch_ = monotonic_clock::now();
+
+	std::atomic<std::uint32_t> sample_one_in_{};
+	std::atomic<std::uint64_t> sample_counter_{};
+
+	mutable fz::mutex mutex_;
+	std::vector<span> ring_;
+	std::size_t next_{};
+	bool wrapped_{};
+};
+
+//! Keeps track of the phases of a single command. The phases of a command are consecutive and don't overlap.
+class command_trace
+{
+public:
+	//! Starts tracing a new command, if the tracer decides so. The previous command, if still being traced, gets ended with reply 0.
+	void begin(std::uint64_t session_id, std::string_view command);
+
+	//! Closes the current phase, if any, and opens a new one.
+	void phase(std::string_view name)
+	{
+		if (command_.command_id)
+			do_phase(name);
+	}
+
+	//! Closes the current phase and the command.
+	void end(int reply)
+	{
+		if (command_.command_id)
+			do_end(reply);
+	}
+
+	explicit operator bool() const
+	{
+		return command_.command_id != 0;
+	}
+
+private:
+	void do_phase(std::string_view name);
+	void do_end(int reply);
+
+	tracer::span command_;
+	tracer::span phase_;
+};
+
+}
+
+#endif // FZ_METRICS_TRACER_HPP
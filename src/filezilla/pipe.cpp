@@ -113,12 +113,17 @@ namespace fz {
 		);
 	}
 
-	void pipe::clear()
+	void pipe::clear(std::size_t max_retained_capacity)
 	{
 		set_consumer(nullptr);
 		set_adder(nullptr);
 
-		buffer_.lock()->resize(0);
+		auto buffer = buffer_.lock();
+
+		if (buffer->capacity() > max_retained_capacity)
+			*buffer = fz::buffer();
+		else
+			buffer->resize(0);
 	}
 
 	void pipe::done(error_type error) {
@@ -52,7 +52,8 @@ namespace fz {
 
 		void dump_state(logger_interface &logger);
 
-		void clear();
+		//! Clears the buffer, releasing its memory if its capacity exceeds the given one.
+		void clear(std::size_t max_retained_capacity = std::numeric_limits<std::size_t>::max());
 
 	protected:
 		void done(error_type error);
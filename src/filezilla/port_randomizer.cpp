@@ -1,13 +1,79 @@
 #include "port_randomizer.hpp"
+#include "hostaddress.hpp"
+#include "util/bits.hpp"
 
+#include <algorithm>
 #include <random>
+#include <functional>
 
 namespace fz {
 
+namespace {
+
+constexpr std::uint64_t leases_mask = 0xFFFF;
+constexpr std::uint64_t connecting_bit = std::uint64_t(1) << 16;
+constexpr unsigned expiry_shift = 32;
+
+constexpr std::uint64_t leases_of(std::uint64_t state)
+{
+	return state & leases_mask;
+}
+
+constexpr bool is_connecting(std::uint64_t state)
+{
+	return state & connecting_bit;
+}
+
+constexpr std::uint32_t expiry_of(std::uint64_t state)
+{
+	return std::uint32_t(state >> expiry_shift);
+}
+
+constexpr std::uint64_t with_expiry(std::uint64_t state, std::uint32_t expiry)
+{
+	return (state & ((std::uint64_t(1) << expiry_shift) - 1)) | (std::uint64_t(expiry) << expiry_shift);
+}
+
+constexpr bool is_free(std::uint64_t state, std::uint32_t now)
+{
+	return leases_of(state) == 0 && !is_connecting(state) && expiry_of(state) <= now;
+}
+
+// Invokes f over each set bit of the bitmap whose position lies within [lo, hi], in increasing order, until f returns true.
+template <typename Bitmap, typename F>
+int scan_bits(const Bitmap &bm, int lo, int hi, const F &f)
+{
+	if (lo > hi)
+		return 0;
+
+	for (std::size_t w = std::size_t(lo) / 64, last = std::size_t(hi) / 64; w <= last; ++w) {
+		auto bits = bm[w].load(std::memory_order_relaxed);
+
+		if (w == std::size_t(lo) / 64)
+			bits &= ~std::uint64_t(0) << (std::size_t(lo) % 64);
+
+		if (w == last && std::size_t(hi) % 64 != 63)
+			bits &= (std::uint64_t(1) << (std::size_t(hi) % 64 + 1)) - 1;
+
+		while (bits) {
+			int p = int(w * 64 + util::count_trailing_zeros(bits));
+
+			if (f(p))
+				return p;
+
+			bits &= bits - 1;
+		}
+	}
+
+	return 0;
+}
+
+}
+
 port_randomizer::port_randomizer(port_manager & manager, std::string const& peer_ip, int min_port, int max_port)
 	: min_(min_port)
 	, max_(max_port)
-	, peer_ip_(peer_ip)
+	, peer_(port_manager::peer_fingerprint(peer_ip))
 	, manager_(manager)
 {
 	if (min_ > max_) {
@@ -28,119 +94,235 @@ port_randomizer::port_randomizer(port_manager & manager, std::string const& peer
 
 	// Start with a random port in the range
 	std::random_device rd;
-	first_port_ = std::uniform_int_distribution<int>(min_, max_)(rd);
+	next_port_ = std::uniform_int_distribution<int>(min_, max_)(rd);
 }
 
 port_lease port_randomizer::get_port()
 {
-	return port_lease(do_get_port(), peer_ip_, manager_);
+	return port_lease(do_get_port(), manager_);
 }
 
 int port_randomizer::do_get_port()
 {
-	auto now = fz::monotonic_clock::now();
+	// Prefer a free port, then relax the requirements.
+	// Reusing a port with another peer should not be a problem other than when using server-to-server transfers.
+	// Reusing a port with the same peer can be problematic in case peer port is the same due to the socket pair's TIME_WAIT state.
+	for (auto how: { port_manager::reuse::none, port_manager::reuse::other_peer, port_manager::reuse::same_peer }) {
+		if (int p = manager_.lease(min_, max_, next_port_, peer_, how)) {
+			// Subsequent attempts, if any, start from the following port.
+			next_port_ = p < max_ ? p + 1 : min_;
+			return p;
+		}
+	}
+
+	return 0;
+}
+
+port_manager::port_manager(fz::duration time_wait, fz::duration wheel_tick)
+	: epoch_(fz::monotonic_clock::now())
+	, time_wait_seconds_(std::uint32_t(std::max<std::int64_t>(time_wait.get_seconds(), 0)))
+	, wheel_tick_seconds_(std::uint32_t(std::max<std::int64_t>(wheel_tick.get_seconds(), 1)))
+	, wheel_size_(time_wait_seconds_ / wheel_tick_seconds_ + 2)
+	, slots_(new slot[num_ports])
+	, free_(new bitmap())
+	, wheel_(new bitmap[wheel_size_]())
+{
+	for (auto &w: *free_)
+		w.store(~std::uint64_t(0), std::memory_order_relaxed);
+
+	// Port 0 is never leased.
+	free_->front().store(~std::uint64_t(1), std::memory_order_relaxed);
+}
+
+port_manager::~port_manager() = default;
+
+std::uint64_t port_manager::peer_fingerprint(std::string const& ip)
+{
+	hostaddress h(ip, hostaddress::format::ipvx);
+
+	if (auto v4 = h.ipv4())
+		return v4->to_uint32();
+
+	if (auto v6 = h.ipv6()) {
+		auto hi = v6->high_to_uint64();
+		auto lo = v6->low_to_uint64();
+
+		return hi ^ (lo + 0x9e3779b97f4a7c15 + (hi << 6) + (hi >> 2));
+	}
+
+	return std::hash<std::string>()(ip);
+}
+
+std::uint32_t port_manager::seconds_since_epoch() const
+{
+	// Start from 1, so that a zeroed expiry is always in the past.
+	return std::uint32_t((fz::monotonic_clock::now() - epoch_).get_seconds()) + 1;
+}
+
+int port_manager::lease(int min, int max, int start, std::uint64_t peer, reuse how)
+{
+	auto now = seconds_since_epoch();
+
+	advance_wheel(now);
+
+	auto claim = [&](int p) {
+		return try_claim(p, peer, now, how);
+	};
+
+	if (how == reuse::none) {
+		if (int p = scan_bits(*free_, start, max, claim))
+			return p;
+
+		return scan_bits(*free_, min, start - 1, claim);
+	}
+
+	// No free ports left: look at all the ports in the range.
+	for (int p = start; p <= max; ++p) {
+		if (claim(p))
+			return p;
+	}
+
+	for (int p = min; p < start; ++p) {
+		if (claim(p))
+			return p;
+	}
+
+	return 0;
+}
+
+bool port_manager::try_claim(int p, std::uint64_t peer, std::uint32_t now, reuse how)
+{
+	auto &s = slots_[std::size_t(p)];
+	auto state = s.state.load(std::memory_order_acquire);
 
 	while (true) {
-		if (!prev_port_) {
-			prev_port_ = first_port_;
-		}
-		else {
-			++prev_port_;
-			if (prev_port_ < min_ || prev_port_ > max_) {
-				prev_port_ = min_;
-			}
-			if (prev_port_ == first_port_) {
-				// Wraparound, relax requirements
-				if (!allow_reuse_other_) {
-					// Should not be a problem other than when using server-to-server transfers
-					allow_reuse_other_ = true;
-				}
-				else if (!allow_reuse_same_) {
-					// This can be problematic in case peer port is the same due to the socket pair's TIME_WAIT state.
-					allow_reuse_same_ = true;
-				}
-				else {
-					// Give up
+		bool can_claim = false;
+
+		if (!is_connecting(state)) {
+			switch (how) {
+				case reuse::none:
+					can_claim = is_free(state, now);
+					break;
+
+				case reuse::other_peer:
+					// A port of the same peer still in TIME_WAIT is no better than one in use by it: leave both to the last resort.
+					can_claim = s.peer.load(std::memory_order_relaxed) != peer || is_free(state, now);
+					break;
+
+				case reuse::same_peer:
+					can_claim = true;
 					break;
-				}
 			}
 		}
 
-		fz::scoped_lock l(manager_.mutex_[prev_port_]);
+		if (!can_claim || leases_of(state) == leases_mask) {
+			if (how == reuse::none && !is_free(state, now)) {
+				// The free bitmap was stale.
+				mark_busy(p);
 
-		if (!manager_.connecting_[prev_port_].exchange(1)) {
-			if (!allow_reuse_other_ && !allow_reuse_same_) {
-				manager_.prune(prev_port_, now);
+				// The port might have become free in the meanwhile, though.
+				if (is_free(s.state.load(std::memory_order_acquire), now))
+					mark_free(p);
 			}
 
-			auto& es = manager_.entries_[prev_port_];
-			auto it = std::find_if(es.begin(), es.end(), [&](port_manager::entry const& e){ return e.peer_ == peer_ip_; });
-			if (it != es.end()) {
-				if (allow_reuse_same_) {
-					++it->leases_;
-					return prev_port_;
-				}
-			}
-			else if (es.empty() || allow_reuse_other_) {
-				port_manager::entry e;
-				e.leases_ = 1;
-				e.peer_ = peer_ip_;
-				es.push_back(e);
-				return prev_port_;
-			}
-			manager_.connecting_[prev_port_] = 0;
+			return false;
 		}
+
+		if (s.state.compare_exchange_weak(state, (state + 1) | connecting_bit, std::memory_order_acq_rel, std::memory_order_acquire))
+			break;
 	}
 
-	return 0;
-}
+	s.peer.store(peer, std::memory_order_relaxed);
+	mark_busy(p);
 
+	return true;
+}
 
-void port_manager::release(int p, std::string const& peer, bool connected)
+void port_manager::release(int p, bool connected)
 {
-	if (p && p < 65536) {
-		{
-			fz::scoped_lock l(mutex_[p]);
+	if (p <= 0 || p >= int(num_ports))
+		return;
 
-			auto& es = entries_[p];
-			auto it = std::find_if(es.begin(), es.end(), [&](entry const& e) { return e.peer_ == peer; });
-			if (it != es.end() && it->leases_) {
-				--it->leases_;
-				it->expiry_ = fz::monotonic_clock::now() + fz::duration::from_minutes(4); // 4 minute TIME_WAIT
-			}
-		}
+	auto &s = slots_[std::size_t(p)];
+	auto expiry = seconds_since_epoch() + time_wait_seconds_;
+	auto state = s.state.load(std::memory_order_acquire);
+	std::uint64_t new_state;
 
-		if (!connected) {
-			connecting_[p] = 0;
-		}
-	}
+	do {
+		new_state = state;
+
+		if (leases_of(new_state))
+			new_state = with_expiry(new_state - 1, expiry);
+
+		if (!connected)
+			new_state &= ~connecting_bit;
+	} while (!s.state.compare_exchange_weak(state, new_state, std::memory_order_acq_rel, std::memory_order_acquire));
+
+	if (leases_of(new_state) == 0 && leases_of(state) != 0)
+		schedule_expiry(p, expiry);
 }
 
+void port_manager::set_connected(int p)
+{
+	if (p > 0 && p < int(num_ports))
+		slots_[std::size_t(p)].state.fetch_and(~connecting_bit, std::memory_order_acq_rel);
+}
 
-void port_manager::set_connected(int p, const std::string &)
+void port_manager::mark_free(int p)
 {
-	if (p && p < 65536) {
-		connecting_[p] = 0;
-	}
+	(*free_)[std::size_t(p) / word_bits].fetch_or(std::uint64_t(1) << (std::size_t(p) % word_bits), std::memory_order_release);
 }
 
+void port_manager::mark_busy(int p)
+{
+	(*free_)[std::size_t(p) / word_bits].fetch_and(~(std::uint64_t(1) << (std::size_t(p) % word_bits)), std::memory_order_release);
+}
 
-void port_manager::prune(int port, const fz::monotonic_clock &now)
+void port_manager::schedule_expiry(int p, std::uint32_t expiry)
 {
-	auto const predicate = [&now](entry const& e) {
-		return !e.leases_ && e.expiry_ < now;
-	};
+	// The bucket is processed only once its whole time slice has elapsed, hence strictly after the expiry.
+	auto tick = expiry / wheel_tick_seconds_ + 1;
+	auto &bucket = wheel_[tick % wheel_size_];
 
-	entries_[port].erase(
-		std::remove_if(entries_[port].begin(), entries_[port].end(), predicate),
-		entries_[port].end()
-	);
+	bucket[std::size_t(p) / word_bits].fetch_or(std::uint64_t(1) << (std::size_t(p) % word_bits), std::memory_order_release);
 }
 
+void port_manager::advance_wheel(std::uint32_t now)
+{
+	auto current = now / wheel_tick_seconds_;
+	auto last = wheel_tick_.load(std::memory_order_acquire);
+
+	// Only one thread gets to process the elapsed buckets, the others just go on.
+	if (current <= last || !wheel_tick_.compare_exchange_strong(last, current, std::memory_order_acq_rel))
+		return;
+
+	auto num_ticks = std::min<std::uint32_t>(current - last, std::uint32_t(wheel_size_));
+
+	for (auto tick = current - num_ticks + 1; tick <= current; ++tick) {
+		auto &bucket = wheel_[tick % wheel_size_];
+
+		for (std::size_t w = 0; w < num_words; ++w) {
+			auto bits = bucket[w].exchange(0, std::memory_order_acq_rel);
+
+			while (bits) {
+				int p = int(w * word_bits + util::count_trailing_zeros(bits));
+				auto state = slots_[std::size_t(p)].state.load(std::memory_order_acquire);
+
+				if (is_free(state, now))
+					mark_free(p);
+				else
+				if (leases_of(state) == 0 && !is_connecting(state))
+					// Not expired yet: it's been released again after being scheduled.
+					schedule_expiry(p, expiry_of(state));
+
+				bits &= bits - 1;
+			}
+		}
+	}
+}
 
 port_lease::port_lease(port_lease && lease)
 	: port_(lease.port_)
-	, peer_ip_(std::move(lease.peer_ip_))
 	, port_manager_(lease.port_manager_)
 	, connected_(lease.connected_)
 {
@@ -150,10 +332,9 @@ port_lease::port_lease(port_lease && lease)
 port_lease& port_lease::operator=(port_lease && lease)
 {
 	if (port_manager_)
-		port_manager_->release(port_, peer_ip_, connected_);
+		port_manager_->release(port_, connected_);
 
 	port_ = lease.port_;
-	peer_ip_ = std::move(lease.peer_ip_);
 	port_manager_ = lease.port_manager_;
 	connected_ = lease.connected_;
 	lease.port_ = 0;
@@ -163,12 +344,11 @@ port_lease& port_lease::operator=(port_lease && lease)
 port_lease::~port_lease()
 {
 	if (port_manager_)
-		port_manager_->release(port_, peer_ip_, connected_);
+		port_manager_->release(port_, connected_);
 }
 
-port_lease::port_lease(int p, std::string const& peer, port_manager & manager)
+port_lease::port_lease(int p, port_manager & manager)
 	: port_(p)
-	, peer_ip_(peer)
 	, port_manager_(&manager)
 {
 }
@@ -177,12 +357,8 @@ void port_lease::set_connected()
 {
 	if (port_manager_ && !connected_) {
 		connected_ = true;
-		port_manager_->set_connected(port_, peer_ip_);
+		port_manager_->set_connected(port_);
 	}
 }
 
-fz::mutex port_manager::mutex_[65536];
-std::vector<port_manager::entry> port_manager::entries_[65536];
-std::atomic_char port_manager::connecting_[65536];
-
 }
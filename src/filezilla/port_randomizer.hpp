@@ -1,12 +1,14 @@
 #ifndef FZ_PORT_RANDOMIZER_HPP
 #define FZ_PORT_RANDOMIZER_HPP
 
-// Ported almost verbatim from old filezilla server's sources.
+// Originally ported from old filezilla server's sources.
 
+#include <array>
 #include <atomic>
+#include <memory>
 #include <string>
 
-#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
 
 /*
 FTP suffers from connection stealing attacks. The only actual solution
@@ -18,7 +20,7 @@ the passive mode port should at least be randomized.
 The randomizer picks a random free port from the assigned passive mode range.
 
 If there is no free port, it picks a used port with a different peer, provided
-said port is not in the listening stage.
+said port is not in the connecting stage.
 
 As last resort, it reuses a busy port from the same peer.
 
@@ -46,10 +48,9 @@ private:
 	friend class port_randomizer;
 	friend class port_manager;
 
-	port_lease(int p, std::string const& peer, port_manager & manager);
+	port_lease(int p, port_manager & manager);
 
 	int port_{};
-	std::string peer_ip_;
 	port_manager * port_manager_{};
 	bool connected_{};
 };
@@ -75,44 +76,89 @@ private:
 	int min_{};
 	int max_{};
 
-	int first_port_{};
-	int prev_port_{};
+	int next_port_{};
 
-	bool allow_reuse_other_{};
-	bool allow_reuse_same_{};
-
-	std::string const peer_ip_;
+	std::uint64_t const peer_;
 
 	port_manager& manager_;
 };
 
+/*
+The manager keeps, for each port, a single 64 bits word holding the number of leases,
+whether the port is in the connecting stage and when its TIME_WAIT period expires,
+plus a fingerprint of the binary address of the last peer it's been leased to.
+All of it is updated with atomic operations, no locks are involved.
+
+Ports that are completely free are also tracked in a bitmap, so that finding one
+only takes a bit scan starting from a random position, regardless of how many
+of the ports in the range are in use.
 
+Ports whose last lease has been released enter the TIME_WAIT state and are put in
+a coarse timing wheel, which gives them back to the free bitmap once the state expires.
+*/
 class port_manager final
 {
 public:
-	port_manager() = default;
+	//! \param time_wait how long a port stays unavailable after its last lease has been released.
+	//! \param wheel_tick the granularity with which ports are given back once their TIME_WAIT state expires.
+	//! Both are rounded to whole seconds, and the tick is at least 1 second.
+	explicit port_manager(fz::duration time_wait = fz::duration::from_seconds(4*60), fz::duration wheel_tick = fz::duration::from_seconds(16));
+	~port_manager();
+
 	port_manager(port_manager const&) = delete;
 	port_manager& operator=(port_manager const&) = delete;
 
+	//! \returns the fingerprint of the binary form of the given ip address, as stored by the manager.
+	static std::uint64_t peer_fingerprint(std::string const& ip);
+
 private:
 	friend class port_lease;
 	friend class port_randomizer;
 
-	void release(int p, const std::string &peer, bool connected);
-	void set_connected(int p, std::string const&);
+	enum class reuse {
+		none,
+		other_peer,
+		same_peer
+	};
 
-	void prune(int port, const fz::monotonic_clock &now);
+	int lease(int min, int max, int start, std::uint64_t peer, reuse how);
+	void release(int p, bool connected);
+	void set_connected(int p);
 
-	struct entry
+	bool try_claim(int p, std::uint64_t peer, std::uint32_t now, reuse how);
+	void schedule_expiry(int p, std::uint32_t expiry);
+	void advance_wheel(std::uint32_t now);
+	void mark_free(int p);
+	void mark_busy(int p);
+
+	std::uint32_t seconds_since_epoch() const;
+
+	static constexpr std::size_t num_ports = 65536;
+	static constexpr std::size_t word_bits = 64;
+	static constexpr std::size_t num_words = num_ports / word_bits;
+
+	using bitmap = std::array<std::atomic<std::uint64_t>, num_words>;
+
+	struct slot
 	{
-		std::string peer_;
-		int leases_{};
-		fz::monotonic_clock expiry_{};
+		// Bits  0-15: number of leases.
+		// Bit     16: the port is in the connecting stage, i.e. not yet set_connected().
+		// Bits 32-63: expiry of the TIME_WAIT state, in seconds since the manager's epoch.
+		std::atomic<std::uint64_t> state{};
+
+		// Fingerprint of the peer the port has last been leased to.
+		std::atomic<std::uint64_t> peer{};
 	};
 
-	static fz::mutex mutex_[65536];
-	static std::vector<entry> entries_[65536];
-	static std::atomic_char connecting_[65536];
+	fz::monotonic_clock const epoch_;
+	std::uint32_t const time_wait_seconds_;
+	std::uint32_t const wheel_tick_seconds_;
+	std::size_t const wheel_size_;
+
+	std::unique_ptr<slot[]> slots_;
+	std::unique_ptr<bitmap> free_;
+	std::unique_ptr<bitmap[]> wheel_;
+	std::atomic<std::uint32_t> wheel_tick_{};
 };
 
 }
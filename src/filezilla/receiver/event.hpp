@@ -3,6 +3,7 @@
 
 #include <libfilezilla/event.hpp>
 #include "../util/traits.hpp"
+#include "../util/small_object_pool.hpp"
 
 /*
  *  ***** !ATTENTION! *****
@@ -18,7 +19,8 @@
 
 namespace fz {
 
-class receiver_event_values_base
+// The events are allocated and freed for each and every asynchronous operation: have them recycled.
+class receiver_event_values_base: public util::pool_allocated
 {
 public:
 	virtual ~receiver_event_values_base(){}
@@ -32,6 +32,12 @@ public:
 	std::enable_if_t<trait::has_message_v<any_message, Message> && std::is_constructible_v<Message, Args...>, int>
 	broadcast(Args &&... args);
 
+	//! Like broadcast, but the message is only sent to those sessions for which \param pred returns true.
+	//! \param pred is invoked with a reference to each session, while the session list is locked.
+	template <typename Message, typename Pred, typename... Args>
+	std::enable_if_t<trait::has_message_v<any_message, Message> && std::is_constructible_v<Message, Args...> && std::is_invocable_r_v<bool, Pred, session &>, int>
+	broadcast_if(Pred && pred, Args &&... args);
+
 	template <typename Message, typename... Args>
 	std::enable_if_t<trait::has_message_v<any_message, Message> && std::is_constructible_v<Message, Args...>, std::pair<int, typename session::id>>
 	send_to_random_client(Args &&... args);
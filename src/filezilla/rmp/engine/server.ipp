@@ -57,6 +57,14 @@ template <typename AnyMessage>
 template <typename Message, typename... Args>
 std::enable_if_t<trait::has_message_v<typename engine<AnyMessage>::any_message, Message> && std::is_constructible_v<Message, Args...>, int>
 engine<AnyMessage>::server::broadcast(Args &&... args)
+{
+	return broadcast_if<Message>([](session &) { return true; }, std::forward<Args>(args)...);
+}
+
+template <typename AnyMessage>
+template <typename Message, typename Pred, typename... Args>
+std::enable_if_t<trait::has_message_v<typename engine<AnyMessage>::any_message, Message> && std::is_constructible_v<Message, Args...> && std::is_invocable_r_v<bool, Pred, typename engine<AnyMessage>::session &>, int>
+engine<AnyMessage>::server::broadcast_if(Pred && pred, Args &&... args)
 {
 	typename session::template serialized_data<Message> serialized_data;
 	int err = ENOTCONN;
@@ -64,6 +72,9 @@ engine<AnyMessage>::server::broadcast(Args &&... args)
 	tcp_server_.iterate_over_sessions([&](tcp::session &tcp_session) {
 		auto &rmp_session = static_cast<engine::session &>(tcp_session);
 
+		if (!pred(rmp_session))
+			return true;
+
 		if (tcp_server_.get_number_of_sessions() == 1) {
 			// Avoid unnecessary copy into intermediate buffer (held by serialized_data) if only one admin is connected.
 			err = rmp_session.template send<Message>(std::forward<Args>(args)...);
@@ -1,10 +1,13 @@
 #include <typeinfo>
+#include <map>
+#include <tuple>
 
 #include <libfilezilla/logger.hpp>
 #include <libfilezilla/tls_info.hpp>
 #include <libfilezilla/recursive_remove.hpp>
 #include <libfilezilla/hash.hpp>
 #include <libfilezilla/util.hpp>
+#include <libfilezilla/mutex.hpp>
 
 #include "util/filesystem.hpp"
 #include "util/io.hpp"
@@ -219,6 +222,8 @@ securable_socket::cert_info securable_socket::cert_info::generate_selfsigned(con
 			info.remove();
 			info = {};
 		}
+		else
+			credentials::reload_all();
 	}
 
 	if (!success)
@@ -409,6 +414,7 @@ bool securable_socket::cert_info::resolve_paths(logger_interface *logger)
 			&& (key.empty() || util::io::write(info.key_path().open(fz::file::writing, fz::file::current_user_and_admins_only | fz::file::empty), key))
 		) {
 			*this = std::move(info);
+			credentials::reload_all();
 		}
 		else {
 			fz::remove_file(info.certs_path());
@@ -464,6 +470,79 @@ bool securable_socket::cert_info::resolve_paths(logger_interface *logger)
 	return true;
 }
 
+namespace {
+
+struct credentials_cache
+{
+	using key_type = std::tuple<native_string, native_string, native_string>;
+
+	fz::mutex mutex;
+	std::map<key_type, std::shared_ptr<const securable_socket::credentials>> map;
+	std::size_t generation{};
+
+	static credentials_cache &instance()
+	{
+		static credentials_cache c;
+		return c;
+	}
+};
+
+}
+
+std::shared_ptr<const securable_socket::credentials> securable_socket::credentials::get(const cert_info &ci, logger_interface &logger)
+{
+	auto &cache = credentials_cache::instance();
+	auto key = credentials_cache::key_type(ci.key_path().str(), ci.certs_path().str(), ci.password());
+
+	std::size_t generation;
+
+	{
+		scoped_lock lock(cache.mutex);
+
+		if (auto it = cache.map.find(key); it != cache.map.end())
+			return it->second;
+
+		generation = cache.generation;
+	}
+
+	// The files are read without holding the lock, so that the other threads needing already cached credentials aren't held up.
+	auto creds = std::make_shared<credentials>();
+
+	creds->certs_ = util::io::read(ci.certs_path()).to_view();
+	if (creds->certs_.empty()) {
+		logger.log_u(logmsg::error, L"Could not read the certificates file \"%s\".", ci.certs_path());
+		return {};
+	}
+
+	if (ci.key_path() == ci.certs_path())
+		creds->key_ = creds->certs_;
+	else
+	if ((creds->key_ = util::io::read(ci.key_path()).to_view()).empty()) {
+		logger.log_u(logmsg::error, L"Could not read the key file \"%s\".", ci.key_path());
+		return {};
+	}
+
+	creds->password_ = ci.password();
+
+	scoped_lock lock(cache.mutex);
+
+	// If the files have been rewritten in the meanwhile, what has been read might be stale: don't cache it.
+	if (generation != cache.generation)
+		return creds;
+
+	return cache.map.try_emplace(std::move(key), std::move(creds)).first->second;
+}
+
+void securable_socket::credentials::reload_all()
+{
+	auto &cache = credentials_cache::instance();
+
+	scoped_lock lock(cache.mutex);
+
+	cache.map.clear();
+	cache.generation += 1;
+}
+
 securable_socket::securer::securer(securable_socket &owner,
 								   bool make_server, tls_ver min_tls_ver,
 								   const securable_socket::cert_info *cert_info,
@@ -509,14 +588,18 @@ securable_socket::securer::securer(securable_socket &owner,
 			owner_.tls_layer_ = new fz::tls_layer(owner_.event_loop_, owner_.event_handler_, owner_.socket_stack_->top(), trust_store, owner_.logger_);
 			owner_.tls_layer_->set_min_tls_ver(min_tls_ver);
 			owner_.tls_layer_->set_unexpected_eof_cb(owner_.eof_cb_);
+			owner_.is_server_ = make_server;
+			owner_.session_parameters_.clear();
 
 			owner_.securable_state_ = securable_socket_state::about_to_secure;
 
 			if (cert_info) {
-				owner_.logger_.log_u(logmsg::debug_debug, L"calling tls_layer_->set_certificate_file(\"%s\", \"%s\", \"****\")",
+				owner_.logger_.log_u(logmsg::debug_debug, L"calling tls_layer_->set_certificate() with the credentials from \"%s\", \"%s\"",
 														cert_info->key_path(), cert_info->certs_path());
 
-				if (!owner_.tls_layer_->set_certificate_file(cert_info->key_path(), cert_info->certs_path(), cert_info->password())) {
+				auto creds = credentials::get(*cert_info, owner_.logger_);
+
+				if (!creds || !owner_.tls_layer_->set_certificate(creds->key(), creds->certs(), creds->password())) {
 					owner_.securable_state_ = securable_socket_state::failed_setting_certificate_file;
 					delete owner_.tls_layer_;
 					owner_.tls_layer_ = nullptr;
@@ -540,7 +623,7 @@ securable_socket::securer::~securer()
 
 		auto get_session_parameters = [this] {
 			if (socket_to_get_tls_session_from_)
-				return socket_to_get_tls_session_from_->tls_layer_->get_session_parameters();
+				return socket_to_get_tls_session_from_->get_session_parameters();
 			return std::vector<uint8_t>{};
 		};
 
@@ -589,6 +672,19 @@ int securable_socket::new_session_ticket()
 	return tls_layer_->new_session_ticket();
 }
 
+bool securable_socket::resumed_session() const
+{
+	return is_secure() && tls_layer_->resumed_session();
+}
+
+const std::vector<uint8_t> &securable_socket::get_session_parameters() const
+{
+	if (!is_server_ || session_parameters_.empty())
+		session_parameters_ = tls_layer_->get_session_parameters();
+
+	return session_parameters_;
+}
+
 std::string securable_socket::get_alpn() const
 {
 	if (get_securable_state() == securable_socket_state::secured)
@@ -220,6 +220,40 @@ public:
 		tls_ver min_tls_ver = tls_ver::v1_2;
 	};
 
+	//! The contents of the key and certificates files a cert_info refers to.
+	//! They're read from disk once and then shared, read-only, by all the TLS layers that make use of them,
+	//! rather than being read anew for each control and data connection.
+	class credentials
+	{
+	public:
+		//! \returns the cached credentials for the given cert_info, loading them first if needed. Null if the files couldn't be read.
+		static std::shared_ptr<const credentials> get(const cert_info &ci, logger_interface &logger);
+
+		//! Makes the following get() calls read the files anew. Must be invoked whenever certificate files get (re)written.
+		//! The TLS layers that already got hold of the previous credentials keep using them.
+		static void reload_all();
+
+		const std::string &key() const
+		{
+			return key_;
+		}
+
+		const std::string &certs() const
+		{
+			return certs_;
+		}
+
+		const native_string &password() const
+		{
+			return password_;
+		}
+
+	private:
+		std::string key_;
+		std::string certs_;
+		native_string password_;
+	};
+
 	struct session_info {
 		using algorithm_warnings_t = tls_session_info::algorithm_warnings_t;
 
@@ -297,6 +331,9 @@ public:
 
 	int new_session_ticket();
 
+	//! \returns true if the socket is secure and its TLS session has been resumed from another one.
+	bool resumed_session() const;
+
 	std::string get_alpn() const;
 
 	void set_unexpected_eof_cb(std::function<bool()> cb);
@@ -398,6 +435,8 @@ public:
 	int shutdown_read() override;
 
 private:
+	const std::vector<std::uint8_t> &get_session_parameters() const;
+
 	event_loop &event_loop_;
 	event_handler *event_handler_{};
 	logger_interface &logger_;
@@ -405,6 +444,11 @@ private:
 	std::unique_ptr<socket_stack> socket_stack_{};
 	tls_layer *tls_layer_{};
 	securable_socket_state securable_state_{securable_socket_state::insecure};
+	bool is_server_{};
+
+	// On the server side the session parameters don't change for as long as the tls layer lives,
+	// yet serializing them is not cheap: cache them, since they're needed by each data connection that resumes the session.
+	mutable std::vector<std::uint8_t> session_parameters_{};
 
 	std::function<bool()> eof_cb_;
 };
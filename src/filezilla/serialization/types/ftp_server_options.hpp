@@ -2,6 +2,7 @@
 #define FZ_SERIALIZATION_TYPES_FTP_SERVER_OPTIONS_HPP
 
 #include "../../serialization/types/optional.hpp"
+#include "../../serialization/types/time.hpp"
 #include "../../ftp/server.hpp"
 
 namespace fz::serialization {
@@ -47,6 +48,62 @@ void serialize(Archive &ar, struct ftp::session::options::pasv &o)
 	);
 }
 
+template <typename Archive>
+void serialize(Archive &ar, adaptive_buffer_size::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.min_size,
+				   "min_size"),
+				   "The size, in bytes, the buffers of each transfer start with."),
+
+		value_info(optional_nvp(o.max_size,
+				   "max_size"),
+				   "The size, in bytes, the buffers of each transfer can grow up to."),
+
+		value_info(optional_nvp(o.target_latency,
+				   "target_latency"),
+				   "The buffers grow so to be able to hold as much data as the transfer moves in this amount of time, in milliseconds.")
+	);
+}
+
+template <typename Archive>
+void serialize(Archive &ar, buffer_operator::file_writer::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.chunk_size,
+				   "chunk_size"),
+				   "Uploaded data is written to disk in chunks of this size, in bytes. The value 0 means data is written as soon as it's received."),
+
+		value_info(optional_nvp(o.flush_behind,
+				   "flush_behind"),
+				   "If set to true, uploaded data is written back to disk as soon as each chunk is complete, rather than being left in the system's cache.")
+	);
+}
+
+template <typename Archive>
+void serialize(Archive &ar, buffer_operator::file_reader::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.min_read_ahead,
+				   "min_read_ahead"),
+				   "For mount points in streaming mode, the amount of data, in bytes, read ahead when a download starts. It doubles as the download proceeds."),
+
+		value_info(optional_nvp(o.max_read_ahead,
+				   "max_read_ahead"),
+				   "For mount points in streaming mode, the maximum amount of data, in bytes, read ahead of a download."),
+
+		value_info(optional_nvp(o.drop_behind_threshold,
+				   "drop_behind_threshold"),
+				   "For mount points in streaming mode, files at least this big, in bytes, are dropped from the system's cache as they're downloaded.")
+	);
+}
+
 template <typename Archive>
 void serialize(Archive &ar, struct ftp::session::options &o)
 {
@@ -59,7 +116,68 @@ void serialize(Archive &ar, struct ftp::session::options &o)
 
 		value_info(optional_nvp(o.tls,
 				   "tls"),
-				   "TLS certificate data.")
+				   "TLS certificate data."),
+
+		value_info(optional_nvp(o.data_buffers,
+				   "data_buffers"),
+				   "Sizing of the data transfers' buffers."),
+
+		value_info(optional_nvp(o.uploads,
+				   "uploads"),
+				   "How uploaded files are written to disk."),
+
+		value_info(optional_nvp(o.downloads,
+				   "downloads"),
+				   "How downloaded files are read from disk.")
+	);
+}
+
+template <typename Archive>
+void serialize(Archive &ar, tls_handshake_throttler::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.max_concurrent(),
+				   "max_concurrent"),
+				   "Maximum number of TLS handshakes that can be in progress at the same time. Further handshakes wait for their turn. "
+				   "The value 0 means no limit."),
+
+		value_info(optional_nvp(o.max_queued(),
+				   "max_queued"),
+				   "Maximum number of TLS handshakes that can wait for their turn. Further handshakes are refused.")
+	);
+}
+
+template <typename Archive>
+void serialize(Archive &ar, hash_engine::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.num_threads(),
+				   "num_threads"),
+				   "Number of threads devoted to computing the digests requested by the HASH and XCRC/XMD5/XSHA commands."),
+
+		value_info(optional_nvp(o.cache_capacity(),
+				   "cache_capacity"),
+				   "Maximum number of digests kept in the cache. The value 0 disables caching.")
+	);
+}
+
+template <typename Archive>
+void serialize(Archive &ar, small_file_cache::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.max_file_size(),
+				   "max_file_size"),
+				   "Files up to this size, in bytes, can be kept in memory and served from there when downloaded."),
+
+		value_info(optional_nvp(o.capacity(),
+				   "capacity"),
+				   "Maximum amount of memory, in bytes, devoted to the small files kept in memory. The value 0 disables the cache.")
 	);
 }
 
@@ -79,7 +197,24 @@ void serialize(Archive &ar, ftp::server::options &o)
 
 		value_info(optional_nvp(o.welcome_message(),
 				   "welcome_message"),
-				   "Additional welcome message.")
+				   "Additional welcome message."),
+
+		value_info(optional_nvp(o.tls_handshakes(),
+				   "tls_handshakes"),
+				   "Limits to the number of TLS handshakes of the control connections."),
+
+		value_info(optional_nvp(o.data_buffers_memory_budget(),
+				   "data_buffers_memory_budget"),
+				   "Maximum amount of memory, in bytes, the buffers of all the data transfers can grow to. "
+				   "The minimum size of each transfer's buffers is always granted. The value 0 means no limit."),
+
+		value_info(optional_nvp(o.hashing(),
+				   "hashing"),
+				   "Computation and caching of the files' digests."),
+
+		value_info(optional_nvp(o.small_files(),
+				   "small_files"),
+				   "Caching in memory of small, frequently downloaded files.")
 	);
 }
 
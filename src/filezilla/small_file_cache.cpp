@@ -0,0 +1,166 @@
+#include <libfilezilla/libfilezilla.hpp>
+
+#ifdef FZ_WINDOWS
+#	include <libfilezilla/glue/windows.hpp>
+#else
+#	include <sys/stat.h>
+#endif
+
+#include "metrics/registry.hpp"
+
+#include "small_file_cache.hpp"
+
+namespace fz {
+
+namespace {
+
+struct counters
+{
+	metrics::counter &hits = metrics::registry::global().get_counter("fz_small_file_cache_requests_total", "Requests for the content of small files, by whether it was found in the cache.", {{"result", "hit"}});
+	metrics::counter &misses = metrics::registry::global().get_counter("fz_small_file_cache_requests_total", "Requests for the content of small files, by whether it was found in the cache.", {{"result", "miss"}});
+};
+
+counters &get_counters()
+{
+	static counters c;
+	return c;
+}
+
+}
+
+small_file_cache::small_file_cache(options opts)
+{
+	set_options(std::move(opts));
+}
+
+void small_file_cache::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = std::move(opts);
+	trim();
+}
+
+std::shared_ptr<const small_file_cache::region> small_file_cache::get(file &f)
+{
+	identity id;
+	if (!identify(f, id))
+		return nullptr;
+
+	key k{id.device, id.inode};
+
+	{
+		scoped_lock lock(mutex_);
+
+		if (opts_.capacity() == 0 || id.size < 0 || std::uint64_t(id.size) > opts_.max_file_size())
+			return nullptr;
+
+		if (auto it = files_.find(k); it != files_.end()) {
+			if (it->second.size == id.size && it->second.mtime == id.mtime) {
+				lru_.splice(lru_.end(), lru_, it->second.lru_it);
+				get_counters().hits.add();
+
+				return it->second.data;
+			}
+		}
+	}
+
+	get_counters().misses.add();
+
+	// The file is small, it's read right away, without holding the lock.
+	auto data = read(f, id.size);
+	if (!data)
+		return nullptr;
+
+	scoped_lock lock(mutex_);
+
+	auto [it, inserted] = files_.try_emplace(k);
+
+	if (inserted)
+		it->second.lru_it = lru_.insert(lru_.end(), k);
+	else {
+		used_ -= it->second.data ? it->second.data->size() : 0;
+		lru_.splice(lru_.end(), lru_, it->second.lru_it);
+	}
+
+	it->second.size = id.size;
+	it->second.mtime = id.mtime;
+	it->second.data = data;
+	used_ += data->size();
+
+	trim();
+
+	return data;
+}
+
+bool small_file_cache::identify(file &f, identity &id)
+{
+	if (!f.opened())
+		return false;
+
+#ifdef FZ_WINDOWS
+	BY_HANDLE_FILE_INFORMATION info{};
+	if (!GetFileInformationByHandle(f.fd(), &info))
+		return false;
+
+	id.device = info.dwVolumeSerialNumber;
+	id.inode = std::uint64_t(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+	id.size = std::int64_t(std::uint64_t(info.nFileSizeHigh) << 32 | info.nFileSizeLow);
+	id.mtime = std::int64_t(std::uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32 | info.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat st{};
+	if (fstat(f.fd(), &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+
+	id.device = std::uint64_t(st.st_dev);
+	id.inode = std::uint64_t(st.st_ino);
+	id.size = std::int64_t(st.st_size);
+#	ifdef FZ_MAC
+	id.mtime = std::int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#	else
+	id.mtime = std::int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#	endif
+#endif
+
+	return true;
+}
+
+std::shared_ptr<const small_file_cache::region> small_file_cache::read(file &f, std::int64_t size)
+{
+	auto pos = f.seek(0, file::current);
+	if (pos < 0 || f.seek(0, file::begin) != 0)
+		return nullptr;
+
+	auto data = std::make_shared<region>(std::size_t(size));
+
+	std::int64_t total = 0;
+	while (total < size) {
+		auto read = f.read(data->data() + total, size - total);
+		if (read <= 0)
+			break;
+
+		total += read;
+	}
+
+	// The file changed size while being read: it's not worth caching.
+	std::uint8_t probe;
+	bool ok = total == size && f.read(&probe, 1) == 0;
+
+	if (f.seek(pos, file::begin) != pos || !ok)
+		return nullptr;
+
+	return data;
+}
+
+void small_file_cache::trim()
+{
+	while (used_ > opts_.capacity() && !lru_.empty()) {
+		auto it = files_.find(lru_.front());
+		used_ -= it->second.data->size();
+
+		files_.erase(it);
+		lru_.pop_front();
+	}
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef FZ_SMALL_FILE_CACHE_HPP
+#define FZ_SMALL_FILE_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <libfilezilla/file.hpp>
+#include <libfilezilla/mutex.hpp>
+
+#include "util/options.hpp"
+
+namespace fz {
+
+/*
+Keeps the content of small, frequently downloaded files in memory, shared by all the FTP sessions,
+so that serving them again doesn't take any reads.
+
+Files are identified by their device and inode, or their Windows equivalents, as found out from the already opened file,
+which means that the cache can't be used to bypass any permission checks: whoever asks for a file's content
+must have been able to open it in the first place. An entry is valid for as long as the file's size and modification time don't change.
+*/
+class small_file_cache
+{
+public:
+	struct options: util::options<options, small_file_cache>
+	{
+		//! Files bigger than this, in bytes, are never cached.
+		opt<std::size_t> max_file_size = o(std::size_t(256*1024));
+
+		//! The maximum amount of memory, in bytes, devoted to the cache. 0 disables the cache.
+		opt<std::size_t> capacity = o(std::size_t(0));
+
+		options() {}
+	};
+
+	using region = std::vector<std::uint8_t>;
+
+	small_file_cache(options opts = {});
+
+	void set_options(options opts);
+
+	//! \returns the whole content of \param f, either from the cache, or read from the file and then cached.
+	//! \returns nullptr if the cache is disabled, the file is too big, or it couldn't be read.
+	//! The file's position is left untouched.
+	std::shared_ptr<const region> get(file &f);
+
+private:
+	struct identity
+	{
+		std::uint64_t device{};
+		std::uint64_t inode{};
+		std::int64_t size{-1};
+		std::int64_t mtime{};
+	};
+
+	using key = std::pair<std::uint64_t, std::uint64_t>;
+
+	struct cached_file
+	{
+		std::int64_t size{};
+		std::int64_t mtime{};
+		std::shared_ptr<const region> data;
+		std::list<key>::iterator lru_it{};
+	};
+
+	static bool identify(file &f, identity &id);
+	static std::shared_ptr<const region> read(file &f, std::int64_t size);
+
+	void trim();
+
+	fz::mutex mutex_;
+	options opts_;
+
+	std::map<key, cached_file> files_;
+	std::list<key> lru_;
+	std::size_t used_{};
+};
+
+}
+
+#endif // FZ_SMALL_FILE_CACHE_HPP
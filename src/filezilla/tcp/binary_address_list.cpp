@@ -174,6 +174,68 @@ inline auto remove_and_maybe_split = [] (auto &list, const auto *host) -> bool {
 	return true;
 };
 
+// Sorts the ranges and merges those that overlap or are adjacent, which makes the binary searches over them exact.
+inline auto coalesce = [](auto &list) {
+	if (list.empty())
+		return;
+
+	std::sort(list.begin(), list.end(), [](const auto &lhs, const auto &rhs) {
+		return lhs.from < rhs.from;
+	});
+
+	auto last = list.begin();
+
+	for (auto it = std::next(list.begin()); it != list.end(); ++it) {
+		auto after_last = last->to;
+		increment(after_last);
+
+		if (!(last->to < it->from) || after_last == it->from) {
+			if (last->to < it->to)
+				last->to = it->to;
+		}
+		else
+			*++last = *it;
+	}
+
+	list.erase(std::next(last), list.end());
+};
+
+// Both lists must have been coalesced.
+inline auto subtract = [](auto &list, const auto &rhs) {
+	std::decay_t<decltype(list)> res;
+
+	auto r = rhs.begin();
+
+	for (auto range: list) {
+		// Skip the ranges to subtract that end before this one begins.
+		while (r != rhs.end() && r->to < range.from)
+			++r;
+
+		bool all_gone = false;
+
+		for (auto cur = r; cur != rhs.end() && !(range.to < cur->from); ++cur) {
+			if (range.from < cur->from) {
+				auto to = cur->from;
+				decrement(to);
+				res.emplace_back(range.from, to);
+			}
+
+			if (!(cur->to < range.to)) {
+				all_gone = true;
+				break;
+			}
+
+			range.from = cur->to;
+			increment(range.from);
+		}
+
+		if (!all_gone)
+			res.push_back(range);
+	}
+
+	list = std::move(res);
+};
+
 template <address_type Family>
 struct family2host;
 
@@ -356,6 +418,51 @@ std::size_t binary_address_list::size() const
 	return ipv4_list_.size() + ipv6_list_.size();
 }
 
+binary_address_list &binary_address_list::merge_with(const binary_address_list &rhs)
+{
+	if (&rhs == this)
+		return *this;
+
+	scoped_read_lock rhs_lock(rhs.mutex_);
+	scoped_write_lock self_lock(mutex_);
+
+	ipv4_list_.insert(ipv4_list_.end(), rhs.ipv4_list_.begin(), rhs.ipv4_list_.end());
+	ipv6_list_.insert(ipv6_list_.end(), rhs.ipv6_list_.begin(), rhs.ipv6_list_.end());
+
+	detail::coalesce(ipv4_list_);
+	detail::coalesce(ipv6_list_);
+
+	return *this;
+}
+
+binary_address_list &binary_address_list::subtract(const binary_address_list &rhs)
+{
+	if (&rhs == this) {
+		scoped_write_lock self_lock(mutex_);
+
+		ipv4_list_.clear();
+		ipv6_list_.clear();
+
+		return *this;
+	}
+
+	scoped_read_lock rhs_lock(rhs.mutex_);
+	scoped_write_lock self_lock(mutex_);
+
+	auto rhs_ipv4_list = rhs.ipv4_list_;
+	auto rhs_ipv6_list = rhs.ipv6_list_;
+
+	detail::coalesce(ipv4_list_);
+	detail::coalesce(ipv6_list_);
+	detail::coalesce(rhs_ipv4_list);
+	detail::coalesce(rhs_ipv6_list);
+
+	detail::subtract(ipv4_list_, rhs_ipv4_list);
+	detail::subtract(ipv6_list_, rhs_ipv6_list);
+
+	return *this;
+}
+
 template <typename ForwardIt, typename Sentinel, typename ErrorHandler>
 bool convert(ForwardIt it, const Sentinel end, binary_address_list &res, const ErrorHandler &on_error)
 {
@@ -27,6 +27,12 @@ public:
 	bool remove(std::string_view address, address_type family) override;
 	std::size_t size() const override;
 
+	//! Adds all the addresses contained in rhs.
+	binary_address_list &merge_with(const binary_address_list &rhs);
+
+	//! Removes all the addresses contained in rhs.
+	binary_address_list &subtract(const binary_address_list &rhs);
+
 	/****************/
 
 	using on_convert_error_type = std::function<bool (std::size_t idx, const std::string_view &)>;
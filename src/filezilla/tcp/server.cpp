@@ -1,4 +1,5 @@
 #include "../tcp/server.hpp"
+#include "../metrics/registry.hpp"
 
 namespace fz::tcp {
 
@@ -115,11 +116,18 @@ void server::operator ()(const event_base &ev)
 
 void server::on_connected_event(tcp::listener &listener, std::unique_ptr<socket> &socket)
 {
+	static auto &accepted = metrics::registry::global().get_counter("fz_tcp_accepted_connections_total", "Number of connections accepted by the listeners.");
+	static auto &refused = metrics::registry::global().get_counter("fz_tcp_refused_connections_total", "Number of accepted connections for which no session could be started.");
+
+	accepted.add();
+
 	int error = 0;
 	auto id = context_.next_session_id();
 	auto session = session_factory_.make_session(*this, id, std::move(socket), listener.get_user_data(), error);
 
-	if (session) {
+	if (!session)
+		refused.add();
+	else {
 		scoped_lock lock(mutex_);
 		sessions_.insert({id, std::move(session)});
 		num_sessions_ += 1;
@@ -66,7 +66,13 @@ std::unique_ptr<session> session::factory::base::make_session(event_handler &tar
 		}
 	}
 
-	return make_session(target_handler, pool_.get_loop(), id, std::move(socket), user_data, error);
+	auto &loop = pool_.get_loop();
+	auto session = make_session(target_handler, loop, id, std::move(socket), user_data, error);
+
+	if (session)
+		session->sessions_in_loop_ = metrics::gauge::holder(pool_.get_sessions_gauge(loop));
+
+	return session;
 }
 
 namespace {
@@ -44,6 +44,10 @@ protected:
 	event_handler &target_handler_;
 	id id_;
 	peer_info peer_info_;
+
+private:
+	friend factory;
+	metrics::gauge::holder sessions_in_loop_;
 };
 
 class session::factory
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cassert>
+
+#include "timer_wheel.hpp"
+
+namespace fz {
+
+bool timer_wheel::entry::is_armed() const
+{
+	scoped_lock lock(wheel_.mutex_);
+
+	return armed_;
+}
+
+void timer_wheel::entry::disarm()
+{
+	// Taking the lock also waits for the callback, in case it's running in the wheel's loop right now.
+	scoped_lock lock(wheel_.mutex_);
+
+	if (armed_)
+		wheel_.unlink(*this);
+}
+
+timer_wheel::timer_wheel(event_loop &loop, duration tick, std::size_t num_slots)
+	: event_handler(loop)
+	, tick_(tick > duration() ? tick : duration::from_milliseconds(1))
+	, slots_(std::max(num_slots, std::size_t(1)) + 1)
+	, expired_slot_(slots_.size() - 1)
+{
+}
+
+timer_wheel::~timer_wheel()
+{
+	remove_handler();
+
+	scoped_lock lock(mutex_);
+
+	for (auto head: slots_) {
+		for (auto e = head; e; e = e->next_)
+			e->armed_ = false;
+	}
+}
+
+std::size_t timer_wheel::size() const
+{
+	scoped_lock lock(mutex_);
+
+	return size_;
+}
+
+void timer_wheel::arm(entry &e, duration timeout)
+{
+	assert(&e.wheel_ == this);
+
+	scoped_lock lock(mutex_);
+
+	e.disarm();
+
+	if (!timer_id_) {
+		last_tick_ = monotonic_clock::now();
+		timer_id_ = add_timer(tick_, false);
+	}
+
+	// Account for the part of the current tick that has already elapsed, so that the entry never expires early.
+	// That's measured in whole milliseconds, rounded down, hence up to one more millisecond might have elapsed.
+	auto ticks = std::max(((monotonic_clock::now() - last_tick_) + timeout + tick_).get_milliseconds() / tick_.get_milliseconds(), std::int64_t(1));
+	auto num_slots = std::int64_t(expired_slot_);
+
+	e.rounds_ = std::size_t((ticks - 1) / num_slots);
+	link(e, std::size_t((std::int64_t(cursor_) + ticks) % num_slots));
+}
+
+void timer_wheel::operator()(const event_base &ev)
+{
+	dispatch<timer_event>(ev, this, &timer_wheel::on_timer_event);
+}
+
+void timer_wheel::on_timer_event(timer_id id)
+{
+	scoped_lock lock(mutex_);
+
+	if (id != timer_id_)
+		return;
+
+	// The loop might have been too busy to deliver some ticks in time: catch up with them.
+	auto now = monotonic_clock::now();
+	auto elapsed = std::max((now - last_tick_).get_milliseconds() / tick_.get_milliseconds(), std::int64_t(1));
+	last_tick_ += duration::from_milliseconds(tick_.get_milliseconds() * elapsed);
+
+	for (; elapsed > 0; --elapsed) {
+		cursor_ = (cursor_ + 1) % expired_slot_;
+
+		for (auto e = slots_[cursor_]; e;) {
+			auto next = e->next_;
+
+			if (e->rounds_ > 0)
+				e->rounds_ -= 1;
+			else {
+				unlink(*e);
+				link(*e, expired_slot_);
+			}
+
+			e = next;
+		}
+	}
+
+	// The callbacks can arm and disarm entries at will, the expired ones included.
+	while (auto e = slots_[expired_slot_]) {
+		unlink(*e);
+		e->on_expiry_();
+	}
+
+	if (size_ == 0) {
+		stop_timer(timer_id_);
+		timer_id_ = 0;
+	}
+}
+
+void timer_wheel::link(entry &e, std::size_t slot)
+{
+	e.armed_ = true;
+	e.slot_ = slot;
+	e.prev_ = nullptr;
+	e.next_ = slots_[slot];
+
+	if (e.next_)
+		e.next_->prev_ = &e;
+
+	slots_[slot] = &e;
+	size_ += 1;
+}
+
+void timer_wheel::unlink(entry &e)
+{
+	if (e.prev_)
+		e.prev_->next_ = e.next_;
+	else
+		slots_[e.slot_] = e.next_;
+
+	if (e.next_)
+		e.next_->prev_ = e.prev_;
+
+	e.armed_ = false;
+	e.prev_ = e.next_ = nullptr;
+	size_ -= 1;
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef FZ_TIMER_WHEEL_HPP
+#define FZ_TIMER_WHEEL_HPP
+
+#include <functional>
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
+
+namespace fz {
+
+/*
+A coarse grained timer service, meant for the timeouts of the sessions, which are many, rarely expire
+and don't need to be precise.
+
+Rather than each session keeping a timer of its own in the event loop, all the sessions running in the same loop
+share a single timer, ticking at a fixed pace, and their timeouts are kept in the slots of a hashed wheel:
+arming and disarming a timeout is O(1) and no heap is involved. An entry expires no earlier than asked for,
+and at most one tick later. The wheel's own timer only runs while there are entries armed.
+
+Entries can be armed, disarmed and destroyed from any thread. Their callback is invoked from within the thread
+of the loop the wheel belongs to, with the wheel locked: disarming an entry waits for its callback to return,
+if it's running, hence objects owning entries should disarm them first thing in their destructor.
+Entries must not outlive the wheel they were made for.
+*/
+class timer_wheel: private event_handler
+{
+public:
+	class entry
+	{
+	public:
+		entry(timer_wheel &wheel, std::function<void()> on_expiry)
+			: wheel_(wheel)
+			, on_expiry_(std::move(on_expiry))
+		{}
+
+		~entry()
+		{
+			disarm();
+		}
+
+		entry(const entry &) = delete;
+		entry &operator=(const entry &) = delete;
+
+		bool is_armed() const;
+		void disarm();
+
+	private:
+		friend timer_wheel;
+
+		timer_wheel &wheel_;
+		std::function<void()> on_expiry_;
+
+		bool armed_{};
+		entry *prev_{};
+		entry *next_{};
+		std::size_t slot_{};
+		std::size_t rounds_{};
+	};
+
+	explicit timer_wheel(event_loop &loop, duration tick = duration::from_seconds(1), std::size_t num_slots = 512);
+	~timer_wheel() override;
+
+	//! Makes the entry, which must have been made for this wheel, expire once \param timeout has elapsed.
+	//! If the entry was already armed, the previous timeout is forgotten.
+	void arm(entry &e, duration timeout);
+
+	//! \returns the number of entries currently armed.
+	std::size_t size() const;
+
+private:
+	void operator()(const event_base &ev) override;
+	void on_timer_event(timer_id id);
+
+	void link(entry &e, std::size_t slot);
+	void unlink(entry &e);
+
+	mutable fz::mutex mutex_{true};
+
+	const duration tick_;
+
+	// The last slot holds the entries that have expired, until their callback is invoked.
+	std::vector<entry *> slots_;
+	const std::size_t expired_slot_;
+
+	std::size_t cursor_{};
+	std::size_t size_{};
+	monotonic_clock last_tick_;
+	timer_id timer_id_{};
+};
+
+}
+
+#endif // FZ_TIMER_WHEEL_HPP
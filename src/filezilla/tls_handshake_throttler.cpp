@@ -0,0 +1,108 @@
+#include "tls_handshake_throttler.hpp"
+
+namespace fz {
+
+tls_handshake_throttler::tls_handshake_throttler(options opts)
+	: opts_(std::move(opts))
+{
+}
+
+void tls_handshake_throttler::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = std::move(opts);
+
+	// The limit might have been raised.
+	grant_queued();
+}
+
+tls_handshake_throttler::slot::state tls_handshake_throttler::acquire(slot &s, event_handler &handler)
+{
+	scoped_lock lock(mutex_);
+
+	if (s.owner_)
+		return s.state_;
+
+	s.handler_ = &handler;
+
+	if (opts_.max_concurrent() == 0 || (in_progress_ < opts_.max_concurrent() && queue_.empty())) {
+		++in_progress_;
+		s.owner_ = this;
+		s.state_ = slot::granted;
+	}
+	else
+	if (queue_.size() < opts_.max_queued()) {
+		s.owner_ = this;
+		s.state_ = slot::queued;
+		s.it_ = queue_.insert(queue_.end(), &s);
+	}
+	else
+		s.state_ = slot::refused;
+
+	return s.state_;
+}
+
+std::pair<std::uint32_t, std::uint32_t> tls_handshake_throttler::get_load() const
+{
+	scoped_lock lock(mutex_);
+
+	return { in_progress_, std::uint32_t(queue_.size()) };
+}
+
+void tls_handshake_throttler::release(slot &s)
+{
+	scoped_lock lock(mutex_);
+
+	if (s.owner_ != this)
+		return;
+
+	if (s.state_ == slot::granted) {
+		--in_progress_;
+		grant_queued();
+	}
+	else
+	if (s.state_ == slot::queued)
+		queue_.erase(s.it_);
+
+	s.owner_ = nullptr;
+	s.state_ = slot::none;
+}
+
+void tls_handshake_throttler::grant_queued()
+{
+	while (!queue_.empty() && (opts_.max_concurrent() == 0 || in_progress_ < opts_.max_concurrent())) {
+		auto s = queue_.front();
+		queue_.pop_front();
+
+		++in_progress_;
+		s->state_ = slot::granted;
+
+		// If the handler is being removed, the event gets discarded and the slot will be released by its destructor.
+		s->handler_->send_event<granted_event>(s);
+	}
+}
+
+tls_handshake_throttler::slot::~slot()
+{
+	release();
+}
+
+void tls_handshake_throttler::slot::release()
+{
+	// The owner is only ever changed by the thread the slot belongs to.
+	if (owner_)
+		owner_->release(*this);
+}
+
+tls_handshake_throttler::slot::state tls_handshake_throttler::slot::get_state() const
+{
+	if (owner_) {
+		scoped_lock lock(owner_->mutex_);
+		return state_;
+	}
+
+	return state_;
+}
+
+}
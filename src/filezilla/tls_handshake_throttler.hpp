@@ -0,0 +1,103 @@
+#ifndef FZ_TLS_HANDSHAKE_THROTTLER_HPP
+#define FZ_TLS_HANDSHAKE_THROTTLER_HPP
+
+#include <cstdint>
+#include <list>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/mutex.hpp>
+
+#include "util/options.hpp"
+
+namespace fz {
+
+/*
+Full TLS handshakes are expensive, because of the asymmetric cryptography involved,
+and they run on the event loop of the session that performs them. A burst of new
+secure connections would therefore stall the transfers of all the other sessions
+that share the same loops.
+
+The throttler bounds the number of full handshakes that can be in progress at the same time.
+Handshakes exceeding the limit wait in a bounded queue for their turn; once the queue is full,
+further handshakes are refused, so that the server sheds load rather than stalling.
+
+Resumed handshakes, as performed by the data connections, are cheap and need not be throttled.
+*/
+class tls_handshake_throttler
+{
+public:
+	struct options: util::options<options, tls_handshake_throttler>
+	{
+		//! Maximum number of handshakes allowed to be in progress at the same time. 0 means no limit.
+		opt<std::uint32_t> max_concurrent = o(0);
+
+		//! Maximum number of handshakes allowed to wait for their turn. Further handshakes are refused.
+		opt<std::uint32_t> max_queued = o(0);
+
+		options() {}
+	};
+
+	class slot;
+
+	//! Sent to the handler of a queued slot, once it has been granted.
+	using granted_event = simple_event<tls_handshake_throttler, slot *>;
+
+	class slot
+	{
+	public:
+		enum state: std::uint8_t {
+			none,
+			granted,
+			queued,
+			refused
+		};
+
+		slot() = default;
+		~slot();
+
+		slot(const slot &) = delete;
+		slot &operator=(const slot &) = delete;
+
+		//! Gives the slot back, letting the next queued one, if any, proceed.
+		void release();
+
+		state get_state() const;
+
+	private:
+		friend tls_handshake_throttler;
+
+		tls_handshake_throttler *owner_{};
+		event_handler *handler_{};
+		state state_{none};
+		std::list<slot *>::iterator it_{};
+	};
+
+	//! The throttler must outlive all the slots that have acquired a permission from it.
+	tls_handshake_throttler(options opts = {});
+
+	void set_options(options opts);
+
+	//! Asks for the permission to perform a handshake.
+	//! \returns slot::granted if the handshake can proceed right away.
+	//! \returns slot::queued if the handshake must wait: a \ref granted_event will be sent to the handler when it's its turn.
+	//! \returns slot::refused if the handshake must not be performed at all.
+	//! The permission lasts until the slot is released or destroyed.
+	slot::state acquire(slot &s, event_handler &handler);
+
+	//! \returns the number of handshakes in progress and the number of the queued ones.
+	std::pair<std::uint32_t, std::uint32_t> get_load() const;
+
+private:
+	void release(slot &s);
+	void grant_queued();
+
+	mutable fz::mutex mutex_;
+
+	options opts_;
+	std::uint32_t in_progress_{};
+	std::list<slot *> queue_;
+};
+
+}
+
+#endif // FZ_TLS_HANDSHAKE_THROTTLER_HPP
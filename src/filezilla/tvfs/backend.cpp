@@ -5,4 +5,24 @@ namespace fz::tvfs {
 backend::~backend()
 {}
 
+metrics::histogram &backend::latency_of(op o)
+{
+	static auto make = [](std::string_view name) -> metrics::histogram & {
+		return metrics::registry::global().get_histogram("fz_tvfs_backend_op_duration_seconds", "Time taken by the filesystem backend to perform an operation.", {{"op", std::string(name)}});
+	};
+
+	static metrics::histogram *histograms[] = {
+		&make("open_file"),
+		&make("open_directory"),
+		&make("rename"),
+		&make("remove_file"),
+		&make("remove_directory"),
+		&make("info"),
+		&make("mkdir"),
+		&make("set_mtime")
+	};
+
+	return *histograms[std::size_t(o)];
+}
+
 }
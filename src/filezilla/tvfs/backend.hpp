@@ -9,6 +9,7 @@
 #include <libfilezilla/local_filesys.hpp>
 
 #include "../receiver.hpp"
+#include "../metrics/registry.hpp"
 
 namespace fz::tvfs {
 
@@ -135,6 +136,21 @@ public:
 	virtual void info(const native_string &path, bool follow_links, receiver_handle<info_response> r) = 0;
 	virtual void mkdir(const native_string &path, bool recurse, mkdir_permissions permissions, receiver_handle<mkdir_response> r) = 0;
 	virtual void set_mtime(const native_string &path, const datetime &mtime, receiver_handle<set_mtime_response> r) = 0;
+
+	enum class op
+	{
+		open_file,
+		open_directory,
+		rename,
+		remove_file,
+		remove_directory,
+		info,
+		mkdir,
+		set_mtime
+	};
+
+	//! \returns the histogram the time taken by the given operation is recorded into, by whoever issues it.
+	static metrics::histogram &latency_of(op o);
 };
 
 
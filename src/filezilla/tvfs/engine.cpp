@@ -124,7 +124,9 @@ void engine::async_open_file(file &out_file, std::string_view tvfs_path, file::m
 	// Moving the receiver_handle is safe, because it's used only by async_receive(), which sits on the left side of the
 	// >> operator, which evaluates left-to-right: so first async_receive(r) takes place, then std::move(r).
 	return backend_->open_file(resolved_path.native_path, mode, rest == 0 ? file::empty : file::existing, async_receive(r)
-	>> [&out_file, r = std::move(r), path = std::move(resolved_path.tvfs_path), rest, mode](auto res, auto &fd) mutable {
+	>> [&out_file, r = std::move(r), path = std::move(resolved_path.tvfs_path), rest, mode, start = monotonic_clock::now()](auto res, auto &fd) mutable {
+		backend::latency_of(backend::op::open_file).record_since(start);
+
 		if (!res)
 			return r(res, std::move(path));
 
@@ -181,7 +183,8 @@ void engine::async_make_directory(std::string tvfs_path, receiver_handle<complet
 		return r(result{result::noperm}, std::move(resolved_path.tvfs_path));
 
 	return backend_->mkdir(resolved_path.native_path, false, mkdir_permissions::normal, async_receive(r)
-	>> [r = std::move(r), path = std::move(resolved_path.tvfs_path)](auto res) {
+	>> [r = std::move(r), path = std::move(resolved_path.tvfs_path), start = monotonic_clock::now()](auto res) {
+		backend::latency_of(backend::op::mkdir).record_since(start);
 		return r(res, std::move(path));
 	});
 }
@@ -196,7 +199,9 @@ void engine::async_set_mtime(std::string_view tvfs_path, entry_time mtime, recei
 			return r(result{result::noperm}, std::move(e));
 
 		auto native_name = e.native_name_;
-		return backend_->set_mtime(native_name, mtime, async_receive(r) >> [r = std::move(r), e = std::move(e), mtime](auto res) mutable {
+		return backend_->set_mtime(native_name, mtime, async_receive(r) >> [r = std::move(r), e = std::move(e), mtime, start = monotonic_clock::now()](auto res) mutable {
+			backend::latency_of(backend::op::set_mtime).record_since(start);
+
 			if (res)
 				e.mtime_ = mtime;
 
@@ -216,7 +221,8 @@ void engine::async_remove_file(std::string_view tvfs_path, receiver_handle<compl
 		return r(result{result::noperm}, std::move(resolved_path.tvfs_path));
 
 	return backend_->remove_file(resolved_path.native_path, async_receive(r)
-	>> [r = std::move(r), path = std::move(resolved_path.tvfs_path)] (auto res) {
+	>> [r = std::move(r), path = std::move(resolved_path.tvfs_path), start = monotonic_clock::now()] (auto res) {
+		backend::latency_of(backend::op::remove_file).record_since(start);
 		r(res, std::move(path));
 	});
 }
@@ -232,7 +238,8 @@ void engine::async_remove_directory(std::string_view tvfs_path, receiver_handle<
 		return r(result{result::noperm}, std::move(resolved_path.tvfs_path));
 
 	return backend_->remove_directory(resolved_path.native_path, async_receive(r)
-	>> [r = std::move(r), path = std::move(resolved_path.tvfs_path)] (auto res) {
+	>> [r = std::move(r), path = std::move(resolved_path.tvfs_path), start = monotonic_clock::now()] (auto res) {
+		backend::latency_of(backend::op::remove_directory).record_since(start);
 		r(res, std::move(path));
 	});
 }
@@ -244,13 +251,15 @@ void engine::async_remove_entry(entry entry, receiver_handle<completion_event> r
 
 	if (entry.type_ == entry_type::file)
 		return backend_->remove_file(entry.native_name_, async_receive(r)
-		>> [r = std::move(r), path = std::move(entry.name_)] (auto res) {
+		>> [r = std::move(r), path = std::move(entry.name_), start = monotonic_clock::now()] (auto res) {
+			backend::latency_of(backend::op::remove_file).record_since(start);
 			r(res, std::move(path));
 		});
 	else
 	if (entry.type_ == entry_type::dir)
 		return backend_->remove_directory(entry.native_name_, async_receive(r)
-		>> [r = std::move(r), path = std::move(entry.name_)] (auto res) {
+		>> [r = std::move(r), path = std::move(entry.name_), start = monotonic_clock::now()] (auto res) {
+			backend::latency_of(backend::op::remove_directory).record_since(start);
 			r(res, std::move(path));
 		});
 
@@ -272,7 +281,8 @@ void engine::async_rename(std::string_view from, std::string_view to, receiver_h
 		return r(result{result::noperm}, resolved_from.tvfs_path);
 
 	return backend_->rename(resolved_from.native_path, resolved_to.native_path, async_receive(r)
-	>> [r = std::move(r), path = std::move(resolved_from.tvfs_path)](auto res) {
+	>> [r = std::move(r), path = std::move(resolved_from.tvfs_path), start = monotonic_clock::now()](auto res) {
+		backend::latency_of(backend::op::rename).record_since(start);
 		r(res, std::move(path));
 	});
 }
@@ -300,6 +310,11 @@ const util::fs::unix_path &engine::get_current_directory() const
 	return current_directory_;
 }
 
+mount_point::flags_t engine::get_mount_flags(std::string_view tvfs_path)
+{
+	return resolve_path(tvfs_path).node.flags;
+}
+
 void engine::set_mount_tree(std::shared_ptr<mount_tree> mt) noexcept
 {
 	mount_tree_ = mt ? std::move(mt) : std::make_shared<mount_tree>();
@@ -338,7 +353,7 @@ resolved_path engine::resolve_path(std::string_view path)
 	if (perms & permissions::write)
 		perms |= permissions::remove | permissions::rename;
 
-	return { std::move(canonical_path), std::move(native_path), { perms, std::move(children)} };
+	return { std::move(canonical_path), std::move(native_path), { perms, std::move(children), node.flags } };
 }
 
 
@@ -46,6 +46,9 @@ public:
 
 	[[nodiscard]] const util::fs::unix_path &get_current_directory() const;
 
+	//! \returns the flags of the mount point \param tvfs_path lies in.
+	[[nodiscard]] mount_point::flags_t get_mount_flags(std::string_view tvfs_path);
+
 private:
 	resolved_path resolve_path(std::string_view path);
 
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <algorithm>
 
 #include "../util/filesystem.hpp"
 
@@ -41,9 +42,11 @@ void resolved_path::async_to_entry(std::shared_ptr<backend> i, receiver_handle<e
 	auto native_name = e.native_name_;
 
 	return i->info(native_name, true, async_receive(r)
-		>> [r = std::move(r), e = std::move(e), is_mountpoint = bool(node.children)]
+		>> [r = std::move(r), e = std::move(e), is_mountpoint = bool(node.children), start = monotonic_clock::now()]
 	(auto res, auto is_link, auto type, auto size, auto mtime, auto &) mutable
 	{
+		backend::latency_of(backend::op::info).record_since(start);
+
 		if (is_link)
 			e.type_ = local_filesys::type::link;
 
@@ -63,6 +66,36 @@ void resolved_path::async_to_entry(std::shared_ptr<backend> i, receiver_handle<e
 entry::entry()
 {}
 
+entry::time_fields entry::get_time_fields(const entry_time &t)
+{
+	auto ms = (t - entry_time(0, entry_time::milliseconds)).get_milliseconds();
+
+	// Floor divisions, so that times before the epoch get broken down properly too.
+	auto secs = ms / 1000 - (ms % 1000 < 0);
+	auto days = secs / 86400 - (secs % 86400 < 0);
+	auto secs_of_day = int(secs - days * 86400);
+
+	// Converts days since the epoch into the proleptic gregorian calendar date.
+	// See http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+	days += 719468;
+	auto era = (days >= 0 ? days : days - 146096) / 146097;
+	auto doe = days - era * 146097;
+	auto yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+	auto doy = doe - (365*yoe + yoe/4 - yoe/100);
+	auto mp = (5*doy + 2)/153;
+	auto month = int(mp < 10 ? mp+3 : mp-9);
+	auto year = int(yoe + era * 400 + (month <= 2));
+
+	return {
+		year,
+		month,
+		int(doy - (153*mp+2)/5 + 1),
+		secs_of_day / 3600,
+		secs_of_day / 60 % 60,
+		secs_of_day % 60
+	};
+}
+
 void entry::fixup_perms(permissions parent_perms)
 {
 	if (type_ == local_filesys::dir) {
@@ -195,9 +228,11 @@ void entries_iterator::async_begin_iteration(traversal_mode mode, resolved_path
 
 			if (must_attempt_to_open_directory) {
 				return backend_->open_directory(resolved_.native_path, async_receive(r)
-					>> [r = std::move(r), list_mounts, &logger, can_list_mounts, this]
+					>> [r = std::move(r), list_mounts, &logger, can_list_mounts, this, start = monotonic_clock::now()]
 				(auto result, auto &fd) mutable
 				{
+					backend::latency_of(backend::op::open_directory).record_since(start);
+
 					if (result)
 						result = lf_.begin_find_files(fd.release(), false, false);
 
@@ -222,9 +257,8 @@ void entries_iterator::async_begin_iteration(traversal_mode mode, resolved_path
 	});
 }
 
-void entries_iterator::async_next_to_entry(receiver_handle<entry_result> r)
+bool entries_iterator::read_next_local_entry(entry &e)
 {
-	entry e;
 	bool is_link;
 
 	e.perms_ = resolved_.node.perms;
@@ -234,7 +268,15 @@ void entries_iterator::async_next_to_entry(receiver_handle<entry_result> r)
 		if (!lf_.get_next_file(e.native_name_, is_link, e.type_, &e.size_, &e.mtime_, nullptr))
 			break;
 
-		e.name_ = to_utf8(e.native_name_);
+		if constexpr (std::is_same_v<native_string, std::string>) {
+			// Most names are plain ASCII, which needs no conversion at all.
+			if (std::all_of(e.native_name_.begin(), e.native_name_.end(), [](unsigned char c) { return c < 0x80; }))
+				e.name_ = e.native_name_;
+			else
+				e.name_ = to_utf8(e.native_name_);
+		}
+		else
+			e.name_ = to_utf8(e.native_name_);
 
 		// If conversion to utf8 failed, there's no way we can show this entry to the user. Skip it.
 		if (e.name_.empty()) {
@@ -244,60 +286,94 @@ void entries_iterator::async_next_to_entry(receiver_handle<entry_result> r)
 
 		e.native_name_ = fz::util::fs::native_path_view(resolved_.native_path) / e.native_name_;
 
-		auto fixup = [perms = resolved_.node.perms](auto &e, auto &r) {
-			e.fixup_perms(perms);
-			return r(result{result::ok}, std::move(e));
-		};
+		// The info of links is about the links themselves, the caller must get the info of their targets from the backend.
+		if (e.type_ != local_filesys::type::link)
+			e.fixup_perms(resolved_.node.perms);
 
-		if (e.type_ == local_filesys::type::link) {
-			auto path = e.native_name_;
-			return backend_->info(path, true, async_receive(r)
-				>> [e = std::move(e), r = std::move(r), fixup]
-			(auto, auto, auto, auto size, auto mtime, auto) mutable
-			{
-				e.size_ = size;
-				e.mtime_ = mtime;
-
-				return fixup(e, r);
-			});
-		}
-
-		return fixup(e, r);
+		return true;
 	}
 
-	return r(result{result::other}, std::move(e));
+	e.type_ = local_filesys::unknown;
+	return false;
 }
 
-void entries_iterator::async_load_next_entry(receiver_handle<> r)
+bool entries_iterator::accept_entry(entry &e)
 {
-	auto iterate_over_mount_nodes = [this] {
-		if (mount_nodes_it_ == resolved_.node.children->cend())
-			next_entry_ = {};
-		else
-			next_entry_ = {*(*mount_nodes_it_)++};
-	};
+	// If the entry is also found in the virtual nodes, skip it.
+	if (e && resolved_.node.children && resolved_.node.children->find(e.name()))
+		return false;
 
-	if (mount_nodes_it_) {
-		iterate_over_mount_nodes();
-		return r();
+	if (!e && resolved_.node.children && (resolved_.node.perms & permissions::list_mounts)) {
+		mount_nodes_it_ = resolved_.node.children->cbegin();
+		load_next_mount_node();
 	}
+	else
+		next_entry_ = std::move(e);
+
+	return true;
+}
+
+void entries_iterator::load_next_mount_node()
+{
+	if (mount_nodes_it_ == resolved_.node.children->cend())
+		next_entry_ = {};
+	else
+		next_entry_ = {*(*mount_nodes_it_)++};
+}
 
-	return async_next_to_entry(async_reentrant_receive(r) >> [this, r = std::move(r), iterate_over_mount_nodes](auto &&self, auto, auto &entry) {
-		// If the entry is also found in the virtual nodes, skip it.
-		if (entry && resolved_.node.children && resolved_.node.children->find(entry.name()))
-			return async_next_to_entry(std::move(self));
+bool entries_iterator::try_load_next_entry(entry &link)
+{
+	// Skipping entries, as well as loading the ones whose info is already at hand, happens right here:
+	// only links need a round trip to the backend, and thus an event.
+	while (true) {
+		if (mount_nodes_it_) {
+			load_next_mount_node();
+			return true;
+		}
 
-		if (!entry && resolved_.node.children && (resolved_.node.perms & permissions::list_mounts)) {
-			mount_nodes_it_ = resolved_.node.children->cbegin();
-			iterate_over_mount_nodes();
+		entry e;
+
+		if (read_next_local_entry(e) && e.type_ == local_filesys::type::link) {
+			link = std::move(e);
+			return false;
 		}
-		else
-			next_entry_ = std::move(entry);
 
-		return r();
+		if (accept_entry(e))
+			return true;
+	}
+}
+
+void entries_iterator::async_load_link_entry(entry &&link, receiver_handle<> r)
+{
+	auto path = link.native_name_;
+
+	return backend_->info(path, true, async_receive(r)
+		>> [this, e = std::move(link), r = std::move(r), start = monotonic_clock::now()]
+	(auto, auto, auto, auto size, auto mtime, auto) mutable
+	{
+		backend::latency_of(backend::op::info).record_since(start);
+
+		e.size_ = size;
+		e.mtime_ = mtime;
+		e.fixup_perms(resolved_.node.perms);
+
+		if (accept_entry(e))
+			return r();
+
+		return async_load_next_entry(std::move(r));
 	});
 }
 
+void entries_iterator::async_load_next_entry(receiver_handle<> r)
+{
+	entry link;
+
+	if (try_load_next_entry(link))
+		return r();
+
+	return async_load_link_entry(std::move(link), std::move(r));
+}
+
 entry entries_iterator::next() {
 	entry out_next_entry;
 
@@ -308,7 +384,13 @@ entry entries_iterator::next() {
 
 void entries_iterator::async_next(receiver_handle<entry_result> r)
 {
-	return async_load_next_entry(async_receive(r) >> [r = std::move(r), next_entry = std::move(next_entry_)]() mutable {
+	auto next_entry = std::move(next_entry_);
+	entry link;
+
+	if (try_load_next_entry(link))
+		return r(result{result::ok}, std::move(next_entry));
+
+	return async_load_link_entry(std::move(link), async_receive(r) >> [r = std::move(r), next_entry = std::move(next_entry)]() mutable {
 		return r(result{result::ok}, std::move(next_entry));
 	});
 }
@@ -461,14 +543,13 @@ void entry_stats::operator()(fz::util::buffer_streamer &bs) const {
 		};
 
 		if (e_.mtime()) {
-			auto six_months_ago = datetime::now() - duration::from_days(30*6);
-			auto tm = e_.mtime().get_tm(datetime::zone::utc);
+			auto f = entry::get_time_fields(e_.mtime());
 
-			bs << months[tm.tm_mon] << ' ' << bs.dec(tm.tm_mday, 2, '0') << ' ';
-			if (e_.mtime() < six_months_ago)
-				bs << bs.dec(1900+tm.tm_year, 5);
+			bs << months[f.month-1] << ' ' << bs.dec(f.day, 2, '0') << ' ';
+			if (e_.mtime() < ctx_.recent_threshold_)
+				bs << bs.dec(f.year, 5);
 			else
-				bs << bs.dec(tm.tm_hour, 2, '0') << ':' << bs.dec(tm.tm_min, 2, '0');
+				bs << bs.dec(f.hour, 2, '0') << ':' << bs.dec(f.minute, 2, '0');
 		}
 		else
 			bs << "??? ?? ?????"sv;
@@ -478,4 +559,14 @@ void entry_stats::operator()(fz::util::buffer_streamer &bs) const {
 	bs << perms << " 1 ftp ftp "sv << bs.dec(e_.size() >= 0 ? e_.size() : 0, 15) << ' ' << date << ' ' << e_.name();
 }
 
+entry_stats::context::context()
+{
+	reset();
+}
+
+void entry_stats::context::reset()
+{
+	recent_threshold_ = datetime::now() - duration::from_days(30*6);
+}
+
 }
@@ -71,16 +71,29 @@ public:
 
 	bool can_rename() const;
 
+	//! The calendar fields of an entry time, in UTC.
+	struct time_fields {
+		int year;
+		int month; //!< 1 to 12
+		int day;   //!< 1 to 31
+		int hour;
+		int minute;
+		int second;
+	};
+
+	//! Like datetime::get_tm(), but with no need to go through the C library, which matters when listing big directories.
+	static time_fields get_time_fields(const entry_time &t);
+
 	static auto timeval(const entry_time &t) {
 		return [&t](util::buffer_streamer &bs) {
-			auto tm = t.get_tm(entry_time::zone::utc);
+			auto f = get_time_fields(t);
 
-			bs << bs.dec(1900+tm.tm_year, 4);
-			bs << bs.dec(tm.tm_mon+1, 2, '0');
-			bs << bs.dec(tm.tm_mday, 2, '0');
-			bs << bs.dec(tm.tm_hour, 2, '0');
-			bs << bs.dec(tm.tm_min, 2, '0');
-			bs << bs.dec(tm.tm_sec, 2, '0');
+			bs << bs.dec(f.year, 4);
+			bs << bs.dec(f.month, 2, '0');
+			bs << bs.dec(f.day, 2, '0');
+			bs << bs.dec(f.hour, 2, '0');
+			bs << bs.dec(f.minute, 2, '0');
+			bs << bs.dec(f.second, 2, '0');
 
 			if (t.get_accuracy() == t.milliseconds)
 				bs << '.' << bs.dec(t.get_milliseconds(), 3, '0');
@@ -116,6 +129,7 @@ public:
 	struct node_t {
 		permissions perms{};
 		mount_tree::shared_const_nodes children{};
+		mount_point::flags_t flags{};
 	} node;
 
 	void async_to_entry(std::shared_ptr<backend> i, receiver_handle<entry_result> r);
@@ -149,7 +163,11 @@ private:
 	friend class engine;
 
 	void async_begin_iteration(traversal_mode mode, resolved_path &&resolved_path, std::shared_ptr<backend> backend, logger_interface &logger, receiver_handle<completion_event> r);
-	void async_next_to_entry(receiver_handle<entry_result> r);
+	bool read_next_local_entry(entry &e);
+	bool accept_entry(entry &e);
+	void load_next_mount_node();
+	bool try_load_next_entry(entry &link);
+	void async_load_link_entry(entry &&link, receiver_handle<> r);
 	void async_load_next_entry(receiver_handle<> r);
 
 	local_filesys lf_;
@@ -205,14 +223,31 @@ private:
 
 class entry_stats {
 public:
-	entry_stats(const entry &e)
+	//! State shared by all the entries of a listing.
+	class context {
+	public:
+		context();
+
+		//! To be invoked at the beginning of each listing.
+		void reset();
+
+	private:
+		friend entry_stats;
+
+		// Entries modified before this time show the year, rather than the time of the day.
+		entry_time recent_threshold_;
+	};
+
+	entry_stats(const entry &e, const context &ctx)
 		: e_{e}
+		, ctx_{ctx}
 	{}
 
 	void operator()(util::buffer_streamer &bs) const;
 
 private:
 	const entry &e_;
+	const context &ctx_;
 };
 
 class entry_name {
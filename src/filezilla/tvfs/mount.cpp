@@ -12,6 +12,19 @@
 
 namespace fz::tvfs {
 
+namespace {
+
+// Directories removed from outside the server get recreated, at the latest, this long after.
+const auto autocreate_interval = duration::from_minutes(5);
+
+int64_t monotonic_milliseconds()
+{
+	static const auto epoch = monotonic_clock::now();
+	return (monotonic_clock::now() - epoch).get_milliseconds();
+}
+
+}
+
 const mount_tree::node *tvfs::mount_tree::nodes::find(std::string_view name) const noexcept
 {
 	for (const auto &v: *this) {
@@ -147,36 +160,47 @@ mount_tree::placeholders &tvfs::mount_tree::get_placeholders()
 	return placeholders_;
 }
 
+bool mount_tree::autocreated_within(duration d) const
+{
+	auto at = autocreated_at_.load(std::memory_order_relaxed);
+	return at >= 0 && monotonic_milliseconds() - at < d.get_milliseconds();
+}
+
+
+using shared_ok = std::shared_ptr<bool>;
 
-static void async_autocreate_directory(mount_tree::shared_const_node n, std::shared_ptr<backend> b, receiver_handle<> r);
-static void async_autocreate_directories(mount_tree::shared_const_nodes ns, std::shared_ptr<backend> b, receiver_handle<> r);
+static void async_autocreate_directory(mount_tree::shared_const_node n, std::shared_ptr<backend> b, shared_ok ok, receiver_handle<> r);
+static void async_autocreate_directories(mount_tree::shared_const_nodes ns, std::shared_ptr<backend> b, shared_ok ok, receiver_handle<> r);
 
-static void async_autocreate_directories(mount_tree::shared_const_nodes ns, std::shared_ptr<backend> b, receiver_handle<> r)
+static void async_autocreate_directories(mount_tree::shared_const_nodes ns, std::shared_ptr<backend> b, shared_ok ok, receiver_handle<> r)
 {
 	if (ns->empty())
 		return r();
 
 	auto cur = ns->begin();
 
-	return async_autocreate_directory(mount_tree::shared_const_node(ns, &cur->second), b, async_reentrant_receive(r)
-	>> [r = std::move(r), cur, ns, b] (auto && self) mutable {
+	return async_autocreate_directory(mount_tree::shared_const_node(ns, &cur->second), b, ok, async_reentrant_receive(r)
+	>> [r = std::move(r), cur, ns, b, ok] (auto && self) mutable {
 		if (++cur != ns->end())
-			return async_autocreate_directory(mount_tree::shared_const_node(ns, &cur->second), b, std::move(self));
+			return async_autocreate_directory(mount_tree::shared_const_node(ns, &cur->second), b, ok, std::move(self));
 
 		return r();
 	});
 }
 
-static void async_autocreate_directory(mount_tree::shared_const_node n, std::shared_ptr<backend> b, receiver_handle<> r)
+static void async_autocreate_directory(mount_tree::shared_const_node n, std::shared_ptr<backend> b, shared_ok ok, receiver_handle<> r)
 {
 	if ((n->flags & mount_point::autocreate) && !n->target.empty()) {
 		return b->mkdir(n->target, true, mkdir_permissions::normal, async_receive(r)
-		>> [r = std::move(r), b, n](auto) mutable {
-			return async_autocreate_directories(mount_tree::shared_const_nodes(n, &n->children), std::move(b), std::move(r));
+		>> [r = std::move(r), b, n, ok](auto res) mutable {
+			if (!res)
+				*ok = false;
+
+			return async_autocreate_directories(mount_tree::shared_const_nodes(n, &n->children), std::move(b), std::move(ok), std::move(r));
 		});
 	}
 
-	return async_autocreate_directories(mount_tree::shared_const_nodes(n, &n->children), std::move(b), std::move(r));
+	return async_autocreate_directories(mount_tree::shared_const_nodes(n, &n->children), std::move(b), std::move(ok), std::move(r));
 }
 
 
@@ -185,12 +209,25 @@ void async_autocreate_directories(std::shared_ptr<mount_tree> mt, std::shared_pt
 	if (!mt)
 		return r();
 
+	// The tree may be shared with other users, which might have just gone through the same directories.
+	if (mt->autocreated_within(autocreate_interval))
+		return r();
+
 	if (!b) {
 		thread_local auto static_b = std::make_shared<backends::local_filesys>(logger::null);
 		b = static_b;
 	}
 
-	return async_autocreate_directory(mount_tree::shared_const_node(mt, &mt->root_), std::move(b), std::move(r));
+	auto ok = std::make_shared<bool>(true);
+	auto started_at = monotonic_milliseconds();
+
+	return async_autocreate_directory(mount_tree::shared_const_node(mt, &mt->root_), std::move(b), ok, async_receive(r)
+	>> [r = std::move(r), mt, ok, started_at]() mutable {
+		if (*ok)
+			mt->autocreated_at_ = started_at;
+
+		return r();
+	});
 }
 
 }
@@ -1,10 +1,12 @@
 #ifndef FZ_TVFS_MOUNT_HPP
 #define FZ_TVFS_MOUNT_HPP
 
+#include <atomic>
 #include <string>
 #include <memory>
 
 #include <libfilezilla/string.hpp>
+#include <libfilezilla/time.hpp>
 
 #include "permissions.hpp"
 #include "canonicalized_path_elements.hpp"
@@ -32,7 +34,11 @@ struct mount_point {
 	} recursive = apply_permissions_recursively_and_allow_structure_modification;
 
 	enum flags_t: std::uint8_t {
-		autocreate = 1
+		autocreate = 1,
+
+		//! Files are read with a large read-ahead, and big ones are dropped from the system's cache as they're sent,
+		//! which suits mount points holding big files that are downloaded from start to end.
+		streaming = 2
 	} flags = {};
 
 	FZ_ENUM_BITOPS_FRIEND_DEFINE_FOR(flags_t)
@@ -80,13 +86,20 @@ public:
 	void set_placeholders(placeholders placeholders);
 	placeholders &get_placeholders();
 
+	//! Whether all the directories to be autocreated have been found or created within the given amount of time.
+	bool autocreated_within(duration d) const;
+
 private:
 	friend void async_autocreate_directories(std::shared_ptr<mount_tree> mt, std::shared_ptr<backend> b, receiver_handle<> r);
 
 	node root_{permissions::list_mounts};
 	placeholders placeholders_;
+
+	// Milliseconds since an arbitrary monotonic epoch, or -1. Trees can be shared among users logging in on different threads.
+	std::atomic<int64_t> autocreated_at_{-1};
 };
 
+//! Creates the directories of the mount points flagged as autocreate, unless that's been done successfully in the last few minutes.
 void async_autocreate_directories(std::shared_ptr<mount_tree> mt, std::shared_ptr<backend> b, receiver_handle<> r);
 
 }
@@ -209,7 +209,7 @@ struct buffer_traits<Buffer, std::enable_if_t<
 
 			auto written_digits = std::distance(begin, end);
 			if (min_width > written_digits)
-				b.append(written_digits-min_width, fill);
+				b.append(std::size_t(min_width-written_digits), fill);
 
 			if (prefix && fill == ' ')
 				b.append(1, prefix);
@@ -232,14 +232,17 @@ struct buffer_traits<fz::buffer>
 				b.append(prefix);
 
 			auto written_digits = std::distance(begin, end);
-			while (min_width-- > written_digits)
-				b.append(fill);
+			if (min_width > written_digits) {
+				auto padding = std::size_t(min_width - written_digits);
+				std::fill_n(b.get(padding), padding, fill);
+				b.add(padding);
+			}
 
 			if (prefix && fill == ' ')
 				b.append(prefix);
 
-			std::copy(begin, end, b.get(written_digits));
-			b.add(written_digits);
+			std::copy(begin, end, b.get(std::size_t(written_digits)));
+			b.add(std::size_t(written_digits));
 		}
 	};
 };
@@ -268,6 +271,33 @@ integral_op_result convert(T value, Buffer &b, uintmax_t scale = 1, unsigned cha
 
 	value /= scale;
 
+	if (base == 10) {
+		// Decimal is by far the most used base: emit two digits at a time, dividing by a constant.
+		static constexpr char digit_pairs[] =
+			"0001020304050607080910111213141516171819"
+			"2021222324252627282930313233343536373839"
+			"4041424344454647484950515253545556575859"
+			"6061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+
+		while (value >= 100) {
+			auto pair = std::size_t(value % 100) * 2;
+			value /= 100;
+
+			*--integral_it = CharT(digit_pairs[pair+1]);
+			*--integral_it = CharT(digit_pairs[pair]);
+		}
+
+		if (value >= 10) {
+			auto pair = std::size_t(value) * 2;
+
+			*--integral_it = CharT(digit_pairs[pair+1]);
+			*--integral_it = CharT(digit_pairs[pair]);
+		}
+		else
+			*--integral_it = CharT('0'+value);
+	}
+	else
 	do {
 		auto digit = value % base;
 		auto ascii_digit = (base <= 10 || digit < 10) ? CharT('0'+digit) : CharT('a'+(digit-10));
@@ -4,6 +4,7 @@
 #include <libfilezilla/event_handler.hpp>
 
 #include "../util/traits.hpp"
+#include "../util/small_object_pool.hpp"
 
 namespace fz::util {
 
@@ -46,7 +47,7 @@ auto invoke_later(Func && func, Arg && arg, Args &&... args) -> decltype(std::in
 
 class invoker_handler;
 
-class invoker_event: public event_base
+class invoker_event: public event_base, public pool_allocated
 {
 public:
 	virtual void operator()() const = 0;
@@ -4,6 +4,13 @@
 #include <libfilezilla/buffer.hpp>
 #include <libfilezilla/local_filesys.hpp>
 
+#ifdef FZ_WINDOWS
+#	include <libfilezilla/glue/windows.hpp>
+#else
+#	include <fcntl.h>
+#	include <sys/uio.h>
+#endif
+
 #include "io.hpp"
 #include "filesystem.hpp"
 #include "../logger/file.hpp"
@@ -247,4 +254,99 @@ bool copy_dir(native_string_view in, native_string_view out, mkdir_permissions p
 	return success;
 }
 
+bool preallocate(file &file, int64_t offset, int64_t size)
+{
+	if (!file.opened() || offset < 0 || size <= 0)
+		return false;
+
+#if defined(FZ_WINDOWS)
+	FILE_ALLOCATION_INFO info{};
+	info.AllocationSize.QuadPart = offset + size;
+
+	return SetFileInformationByHandle(file.fd(), FileAllocationInfo, &info, sizeof(info)) != 0;
+#elif defined(FALLOC_FL_KEEP_SIZE)
+	int res;
+	do {
+		res = fallocate(file.fd(), FALLOC_FL_KEEP_SIZE, offset, size);
+	} while (res == -1 && errno == EINTR);
+
+	return res == 0;
+#else
+	return false;
+#endif
+}
+
+void start_writeback(file &file, int64_t offset, int64_t size)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+	if (file.opened() && offset >= 0 && size > 0)
+		sync_file_range(file.fd(), offset, size, SYNC_FILE_RANGE_WRITE);
+#else
+	(void)file;
+	(void)offset;
+	(void)size;
+#endif
+}
+
+void drop_from_cache(file &file, int64_t offset, int64_t size)
+{
+#ifdef POSIX_FADV_DONTNEED
+	if (file.opened() && offset >= 0 && size > 0)
+		posix_fadvise(file.fd(), offset, size, POSIX_FADV_DONTNEED);
+#else
+	(void)file;
+	(void)offset;
+	(void)size;
+#endif
+}
+
+void advise_sequential(file &file)
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+	if (file.opened())
+		posix_fadvise(file.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+	(void)file;
+#endif
+}
+
+void prefetch(file &file, int64_t offset, int64_t size)
+{
+#ifdef POSIX_FADV_WILLNEED
+	if (file.opened() && offset >= 0 && size > 0)
+		posix_fadvise(file.fd(), offset, size, POSIX_FADV_WILLNEED);
+#else
+	(void)file;
+	(void)offset;
+	(void)size;
+#endif
+}
+
+int64_t read_cached(file &file, void *data, int64_t size)
+{
+#ifdef RWF_NOWAIT
+	if (!file.opened() || size < 0)
+		return -1;
+
+	iovec iov{data, std::size_t(size)};
+
+	// An offset of -1 makes preadv2 use, and update, the current position.
+	ssize_t res;
+	do {
+		res = preadv2(file.fd(), &iov, 1, -1, RWF_NOWAIT);
+	} while (res == -1 && errno == EINTR);
+
+	if (res == -1)
+		return errno == EAGAIN ? 0 : -1;
+
+	return res;
+#else
+	(void)file;
+	(void)data;
+	(void)size;
+
+	return -1;
+#endif
+}
+
 }
@@ -114,5 +114,30 @@ bool copy(native_string_view in, native_string_view out, fz::file::creation_flag
 //! Destination is created if it doesn't exist yet, with the passed in flags.
 bool copy_dir(native_string_view in, native_string_view out, mkdir_permissions permissions = mkdir_permissions::normal, int *error = nullptr);
 
+//! Reserves disk space for \param size bytes of \param file starting at \param offset, without changing the file's size.
+//! \returns true if the space got reserved, false if it couldn't or the platform doesn't support it.
+bool preallocate(fz::file &file, int64_t offset, int64_t size);
+
+//! Makes the system start writing back the given range of \param file, without waiting for it to be done.
+//! Does nothing on platforms that don't support it.
+void start_writeback(fz::file &file, int64_t offset, int64_t size);
+
+//! Lets the system drop the given range of \param file from its cache, once it's been written back.
+//! Does nothing on platforms that don't support it.
+void drop_from_cache(fz::file &file, int64_t offset, int64_t size);
+
+//! Tells the system that \param file is going to be read sequentially, so that it can read ahead more aggressively.
+//! Does nothing on platforms that don't support it.
+void advise_sequential(fz::file &file);
+
+//! Makes the system start reading the given range of \param file into its cache, without waiting for it to be done.
+//! Does nothing on platforms that don't support it.
+void prefetch(fz::file &file, int64_t offset, int64_t size);
+
+//! Reads up to \param size bytes from the current position of \param file into \param data, but only as much as is already in the system's cache.
+//! \returns the amount of bytes read, which is 0 if none are cached or the end of the file has been reached,
+//! or -1 on error or if the platform doesn't support it.
+int64_t read_cached(fz::file &file, void *data, int64_t size);
+
 }
 #endif // FZ_UTIL_IO_HPP
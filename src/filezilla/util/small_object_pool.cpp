@@ -0,0 +1,198 @@
+#include <atomic>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include <libfilezilla/mutex.hpp>
+
+#include "small_object_pool.hpp"
+
+namespace fz::util {
+
+namespace {
+
+using stats_array = std::array<small_object_pool::stats, small_object_pool::num_size_classes+1>;
+
+struct free_block
+{
+	free_block *next;
+};
+
+struct thread_cache;
+
+struct registry
+{
+	fz::mutex mutex_;
+	std::vector<thread_cache *> caches_;
+
+	// The stats of the threads that have exited.
+	stats_array retired_{};
+};
+
+registry &get_registry()
+{
+	static registry r;
+	return r;
+}
+
+struct thread_cache
+{
+	struct size_class
+	{
+		free_block *head{};
+		std::size_t count{};
+
+		// Only ever written to by the owning thread, they're atomic so that they can be read by any other.
+		std::atomic<std::uint64_t> allocations{};
+		std::atomic<std::uint64_t> heap_allocations{};
+		std::atomic<std::uint64_t> cached_blocks{};
+	};
+
+	thread_cache();
+	~thread_cache();
+
+	static void increment(std::atomic<std::uint64_t> &counter, std::uint64_t amount = 1)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	void add_to(stats_array &stats) const
+	{
+		for (std::size_t i = 0; i < classes.size(); ++i) {
+			stats[i].allocations += classes[i].allocations.load(std::memory_order_relaxed);
+			stats[i].heap_allocations += classes[i].heap_allocations.load(std::memory_order_relaxed);
+			stats[i].cached_blocks += classes[i].cached_blocks.load(std::memory_order_relaxed);
+		}
+	}
+
+	std::array<size_class, small_object_pool::num_size_classes+1> classes;
+};
+
+// Objects can be freed by the destructors of other thread locals, after the cache has gone: those go straight to the heap.
+thread_local thread_cache *current_cache{};
+thread_local bool cache_destroyed{};
+
+thread_cache::thread_cache()
+{
+	auto &r = get_registry();
+
+	scoped_lock lock(r.mutex_);
+	r.caches_.push_back(this);
+
+	current_cache = this;
+}
+
+thread_cache::~thread_cache()
+{
+	current_cache = nullptr;
+	cache_destroyed = true;
+
+	for (std::size_t i = 0; i < small_object_pool::num_size_classes; ++i) {
+		auto &c = classes[i];
+
+		while (c.head) {
+			auto b = c.head;
+			c.head = b->next;
+			::operator delete(b);
+		}
+
+		c.count = 0;
+		c.cached_blocks.store(0, std::memory_order_relaxed);
+	}
+
+	auto &r = get_registry();
+
+	scoped_lock lock(r.mutex_);
+	r.caches_.erase(std::remove(r.caches_.begin(), r.caches_.end(), this), r.caches_.end());
+	add_to(r.retired_);
+}
+
+thread_cache *get_cache()
+{
+	if (!current_cache && !cache_destroyed) {
+		static thread_local thread_cache cache;
+		(void)cache;
+	}
+
+	return current_cache;
+}
+
+constexpr std::size_t class_of(std::size_t size)
+{
+	return size == 0 ? 0 : (size - 1) / small_object_pool::granularity;
+}
+
+}
+
+void *small_object_pool::allocate(std::size_t size)
+{
+	auto idx = class_of(size);
+	auto cache = get_cache();
+
+	if (idx >= num_size_classes) {
+		if (cache) {
+			thread_cache::increment(cache->classes[num_size_classes].allocations);
+			thread_cache::increment(cache->classes[num_size_classes].heap_allocations);
+		}
+
+		return ::operator new(size);
+	}
+
+	if (cache) {
+		auto &c = cache->classes[idx];
+
+		thread_cache::increment(c.allocations);
+
+		if (auto b = c.head) {
+			c.head = b->next;
+			c.count -= 1;
+			c.cached_blocks.store(c.count, std::memory_order_relaxed);
+			return b;
+		}
+
+		thread_cache::increment(c.heap_allocations);
+	}
+
+	// All blocks of a class have the same size, so that they can be used for any object of that class.
+	return ::operator new((idx + 1) * granularity);
+}
+
+void small_object_pool::deallocate(void *p, std::size_t size) noexcept
+{
+	if (!p)
+		return;
+
+	auto idx = class_of(size);
+
+	if (idx < num_size_classes) {
+		if (auto cache = get_cache()) {
+			auto &c = cache->classes[idx];
+
+			if (c.count < max_cached_blocks) {
+				auto b = ::new (p) free_block{c.head};
+				c.head = b;
+				c.count += 1;
+				c.cached_blocks.store(c.count, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	::operator delete(p);
+}
+
+std::array<small_object_pool::stats, small_object_pool::num_size_classes+1> small_object_pool::get_stats()
+{
+	auto &r = get_registry();
+
+	scoped_lock lock(r.mutex_);
+
+	auto stats = r.retired_;
+
+	for (auto c: r.caches_)
+		c->add_to(stats);
+
+	return stats;
+}
+
+}
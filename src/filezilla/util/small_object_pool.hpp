@@ -0,0 +1,64 @@
+#ifndef FZ_UTIL_SMALL_OBJECT_POOL_HPP
+#define FZ_UTIL_SMALL_OBJECT_POOL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace fz::util {
+
+/*
+Recycles the memory of small objects that get allocated and freed at a high pace,
+like the events carrying the results of the asynchronous operations.
+
+Each thread, which in practice means each event loop, keeps a bounded cache of free blocks
+for each size class, so that in the steady state no trip to the heap is needed, nor any locking.
+A block freed by a thread other than the one that allocated it just goes into the cache of the former.
+Objects bigger than max_object_size are allocated from the heap as usual.
+*/
+class small_object_pool
+{
+public:
+	static constexpr std::size_t granularity = 32;
+	static constexpr std::size_t max_object_size = 512;
+	static constexpr std::size_t num_size_classes = max_object_size / granularity;
+
+	//! The maximum number of free blocks each thread keeps for each size class.
+	static constexpr std::size_t max_cached_blocks = 256;
+
+	struct stats
+	{
+		//! The number of allocations performed.
+		std::uint64_t allocations{};
+
+		//! The number of allocations that couldn't be satisfied by the cache and had to resort to the heap.
+		std::uint64_t heap_allocations{};
+
+		//! The number of free blocks currently in the caches.
+		std::uint64_t cached_blocks{};
+	};
+
+	static void *allocate(std::size_t size);
+	static void deallocate(void *p, std::size_t size) noexcept;
+
+	//! \returns the stats of each size class, summed over all the threads. The last element is for the objects too big to be pooled.
+	static std::array<stats, num_size_classes+1> get_stats();
+};
+
+//! Objects of classes derived from this one get allocated from the small_object_pool.
+struct pool_allocated
+{
+	static void *operator new(std::size_t size)
+	{
+		return small_object_pool::allocate(size);
+	}
+
+	static void operator delete(void *p, std::size_t size) noexcept
+	{
+		small_object_pool::deallocate(p, size);
+	}
+};
+
+}
+
+#endif // FZ_UTIL_SMALL_OBJECT_POOL_HPP
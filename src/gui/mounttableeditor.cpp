@@ -99,7 +99,8 @@ bool MountTableEditor::Create(wxWindow* parent, wxWindowID winid, const wxPoint&
 					}},
 					{ 0, recursive_ = new wxCheckBox(p, wxID_ANY, _S("Apply permissions to su&bdirectories")) },
 					{ 0, modify_structure_ = new wxCheckBox(p, wxID_ANY, _S("Wri&table directory structure")) },
-					{ 0, autocreate_ = new wxCheckBox(p, wxID_ANY, _S("&Create native directory if it does not exist")) }
+					{ 0, autocreate_ = new wxCheckBox(p, wxID_ANY, _S("&Create native directory if it does not exist")) },
+					{ 0, streaming_ = new wxCheckBox(p, wxID_ANY, _S("Optimi&ze for downloading large files")) }
 				};
 			};
 
@@ -184,6 +185,15 @@ bool MountTableEditor::Create(wxWindow* parent, wxWindowID winid, const wxPoint&
 		}
 	};
 
+	auto on_streaming_change = [](bool v, fz::tvfs::mount_point *mp) {
+		if (mp) {
+			if (v)
+				mp->flags |= fz::tvfs::mount_point::streaming;
+			else
+				mp->flags &= ~fz::tvfs::mount_point::streaming;
+		}
+	};
+
 	auto on_access_change = [this, on_recursive_change, on_modify_structure_change](fz::tvfs::mount_point::access_t v, fz::tvfs::mount_point *mp) {
 		if (mp)
 			mp->access = v;
@@ -227,6 +237,7 @@ bool MountTableEditor::Create(wxWindow* parent, wxWindowID winid, const wxPoint&
 			modify_structure_->SetValue(mp->recursive == fz::tvfs::mount_point::apply_permissions_recursively_and_allow_structure_modification);
 			recursive_->SetValue(mp->recursive != fz::tvfs::mount_point::do_not_apply_permissions_recursively);
 			autocreate_->SetValue(mp->flags & fz::tvfs::mount_point::autocreate);
+			streaming_->SetValue(mp->flags & fz::tvfs::mount_point::streaming);
 
 			on_modify_structure_change(modify_structure_->GetValue(), mp);
 			on_recursive_change(recursive_->GetValue(), mp);
@@ -268,6 +279,12 @@ bool MountTableEditor::Create(wxWindow* parent, wxWindowID winid, const wxPoint&
 		on_autocreate_change(ev.GetInt(), grid_->GetCurrentMountPoint());
 	});
 
+	streaming_->Bind(wxEVT_CHECKBOX, [this, on_streaming_change](wxCommandEvent &ev) {
+		ev.Skip();
+
+		on_streaming_change(ev.GetInt(), grid_->GetCurrentMountPoint());
+	});
+
 	grid_->Bind(wxEVT_GRID_SELECT_CELL, [select_row](wxGridEvent &ev) {
 		ev.Skip();
 		select_row(ev.GetRow());
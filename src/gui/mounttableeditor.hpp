@@ -40,6 +40,7 @@ private:
 	wxCheckBox *recursive_{};
 	wxCheckBox *modify_structure_{};
 	wxCheckBox *autocreate_{};
+	wxCheckBox *streaming_{};
 	wxButton *remove_button_{};
 	wxButton *add_button_{};
 	wxSimplebook *perms_{};
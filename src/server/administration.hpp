@@ -12,6 +12,7 @@
 #include "../filezilla/serialization/types/network_interface.hpp"
 #include "../filezilla/serialization/types/json.hpp"
 #include "../filezilla/serialization/types/update.hpp"
+#include "../filezilla/serialization/types/containers.hpp"
 
 #include "../filezilla/authentication/file_based_authenticator.hpp"
 #include "../filezilla/acme/daemon.hpp"
@@ -24,6 +25,7 @@
 #include "../server/server_settings.hpp"
 
 #include "../filezilla/debug.hpp"
+#include "../filezilla/enum_bitops.hpp"
 
 #ifndef ENABLE_ADMIN_DEBUG
 #   define ENABLE_ADMIN_DEBUG 0
@@ -36,7 +38,7 @@ namespace administration {
 
 	// Increase this number any time a new message is added/removed/changed
 	// Remember, though, that the admin_login message must come always FIRST and CANNOT be removed (but it can be changed), since it's the only one that does the version check.
-	static constexpr version_t protocol_version { 47 };
+	static constexpr version_t protocol_version { 51 };
 
 	using admin_login = command <versioned<protocol_version, struct admin_login_tag> (std::string password), response(
 		fz::util::fs::path_format,
@@ -88,6 +90,62 @@ namespace administration {
 
 	using log = message <struct log_tag (fz::datetime dt, fz::ftp::session::id session_id, fz::logmsg::type type, std::string module, std::wstring msg)>;
 
+	//! Describes which of the notifications the server sends out to an administration client.
+	//! By default, all of them are sent.
+	struct event_filter {
+		enum class events: std::uint32_t {
+			none            = 0,
+			session_start   = 1 << 0, //!< session::start and session::stop
+			user_name       = 1 << 1, //!< session::user_name
+			entry_open      = 1 << 2, //!< session::entry_open and session::entry_close
+			entry_progress  = 1 << 3, //!< session::entry_written and session::entry_read
+			protocol_info   = 1 << 4, //!< session::protocol_info
+			log             = 1 << 5, //!< log
+			listener_status = 1 << 6, //!< listener_status
+
+			all = ~std::uint32_t(0)
+		};
+
+		FZ_ENUM_BITOPS_FRIEND_DEFINE_FOR(events)
+
+		struct session_id_range {
+			fz::ftp::session::id first{};
+			fz::ftp::session::id last{};
+
+			template <typename Archive>
+			void serialize(Archive &ar)
+			{
+				ar(FZ_NVP(first), FZ_NVP(last));
+			}
+		};
+
+		//! The kinds of events the client is interested in.
+		events subscribed = events::all;
+
+		//! Only sessions logged in with one of these user names are notified about. Empty means any session.
+		std::vector<std::string> user_names{};
+
+		//! Only sessions whose id is within one of these ranges, bounds included, are notified about. Empty means any session.
+		std::vector<session_id_range> session_ids{};
+
+		//! Only log messages of these types are forwarded.
+		fz::logmsg::type log_types = fz::logmsg::type(~0);
+
+		//! Only one in \ref sample_one_in of the high frequency events (entry_progress and log) is sent. 0 and 1 mean all of them.
+		std::uint32_t sample_one_in = 1;
+
+		//! At most this many high frequency events (entry_progress and log) are sent each second. 0 means no cap.
+		std::uint32_t max_events_per_second = 0;
+
+		template <typename Archive>
+		void serialize(Archive &ar)
+		{
+			ar(FZ_NVP(subscribed), FZ_NVP(user_names), FZ_NVP(session_ids), FZ_NVP(log_types), FZ_NVP(sample_one_in), FZ_NVP(max_events_per_second));
+		}
+	};
+
+	using set_event_filter = command <struct set_event_filter_tag (event_filter filter), response ()>;
+
 	using server_status   = message <struct server_status_tag (bool is_online)>;
 	using listener_status = message <struct listener_status_tag (fz::datetime datetime, fz::tcp::address_info address_info, fz::tcp::listener::status status)>;
 
@@ -102,6 +160,10 @@ namespace administration {
 	using set_ip_filters        = command <struct set_ip_filters_tag             (fz::tcp::binary_address_list disallowed_ips, fz::tcp::binary_address_list allowed_ips), response ()>;
 	using set_ftp_options       = command <struct set_ftp_options_tag            (fz::ftp::server::options ftp_options), response()>;
 	using get_ftp_options       = command <struct get_ftp_options_tag            (bool export_cert), response(fz::ftp::server::options ftp_options, fz::securable_socket::cert_info::extra tls_extra_certs_info)>;
+	using get_tls_handshake_stats = command <struct get_tls_handshake_stats_tag  (), response(std::vector<fz::ftp::server::tls_handshake_stats> stats)>;
+	using get_metrics           = command <struct get_metrics_tag                (), response(std::string metrics_text)>;
+	using set_trace_sampling    = command <struct set_trace_sampling_tag         (std::uint32_t sample_one_in), response()>;
+	using get_traces            = command <struct get_traces_tag                 (), response(std::string chrome_trace_json)>;
 	using set_protocols_options = command <struct set_protocols_options_tag      (server_settings::protocols_options), response()>;
 	using get_protocols_options = command <struct get_protocols_options_tag      (), response(server_settings::protocols_options)>;
 	using set_admin_options     = command <struct set_admin_options_tag          (server_settings::admin_options admin_options), response()>;
@@ -191,6 +253,8 @@ namespace administration {
 
 		acknowledge_queue_full, acknowledge_queue_full::response,
 
+		set_event_filter,      set_event_filter::response,
+
 		ban_ip,                ban_ip::response,
 		set_server_status,     set_server_status::response,
 		end_sessions,          end_sessions::response,
@@ -200,6 +264,10 @@ namespace administration {
 		set_ip_filters,        set_ip_filters::response,
 		set_ftp_options,       set_ftp_options::response,
 		get_ftp_options,       get_ftp_options::response,
+		get_tls_handshake_stats, get_tls_handshake_stats::response,
+		get_metrics,           get_metrics::response,
+		set_trace_sampling,    set_trace_sampling::response,
+		get_traces,            get_traces::response,
 		set_protocols_options, set_protocols_options::response,
 		get_protocols_options, get_protocols_options::response,
 		set_admin_options,     set_admin_options::response,
@@ -13,11 +13,7 @@
 
 #include "administrator/notifier.hpp"
 #include "administrator/update_checker.hpp"
-
-struct administrator::session_data
-{
-	bool is_in_overflow{};
-};
+#include "administrator/session_data.hpp"
 
 administrator::~administrator()
 {
@@ -147,7 +143,7 @@ void administrator::listener_status(const fz::tcp::listener &listener)
 	if (admin_server_.get_number_of_sessions() < 1)
 		return;
 
-	admin_server_.broadcast<administration::listener_status>(fz::datetime::now(), listener.get_address_info(), listener.get_status());
+	admin_server_.broadcast_if<administration::listener_status>(session_data::accepting(session_data::events::listener_status), fz::datetime::now(), listener.get_address_info(), listener.get_status());
 }
 
 bool administrator::handle_new_admin_settings()
@@ -299,6 +295,20 @@ auto administrator::operator ()(administration::acknowledge_queue_full::response
 	}
 }
 
+auto administrator::operator()(administration::set_event_filter &&v, administration::engine::session &session)
+{
+	auto && [filter] = std::move(v).tuple();
+
+	// The filter is also used when broadcasting from the ftp sessions' threads, which happens with the admin sessions list locked.
+	if (auto s = admin_server_.get_session(session.get_id()))
+		s->get_user_data<session_data>().set_filter(std::move(filter));
+
+	session.send(v.success());
+
+	// Send the info of the ftp sessions that match the new filter, like it happens after login.
+	operator()(administration::session::solicit_info{}, session);
+}
+
 /**********************************************************************/
 
 void administrator::reload_config()
@@ -336,6 +346,13 @@ void administrator::reload_config()
 		set_acme_options(std::move(server_settings.acme));
 		set_ip_filters(std::move(disallowed_ips), std::move(allowed_ips), false);
 		set_updates_options(std::move(server_settings.update_checker));
+		fz::metrics::tracer::global().set_options(server_settings.metrics.tracer_options());
+
+		// Restarting the exporter would drop the scrapes in progress: only do it if the port has actually changed.
+		if (auto port = server_settings.metrics.local_port; port != server_settings_.lock()->metrics.local_port)
+			metrics_exporter_.set_port(port);
+
+		server_settings_.lock()->metrics = std::move(server_settings.metrics);
 
 		logger_.log_u(fz::logmsg::status, L"Successfully reloaded configuration.");
 	});
@@ -352,6 +369,7 @@ administrator::administrator(fz::tcp::server_context &context,
 							 fz::authentication::file_based_authenticator &authenticator,
 							 fz::util::xml_archiver<server_settings> &server_settings,
 							 fz::acme::daemon &acme,
+							 fz::metrics::http_exporter &metrics_exporter,
 							 const server_config_paths &config_paths)
 	: forwarder<administrator>(*this)
 	, server_context_(context)
@@ -367,6 +385,7 @@ administrator::administrator(fz::tcp::server_context &context,
 	, authenticator_(authenticator)
 	, server_settings_(server_settings)
 	, acme_(acme)
+	, metrics_exporter_(metrics_exporter)
 	, config_paths_(config_paths)
 	, log_forwarder_(new log_forwarder(*this, 0))
 	#if !defined(WITHOUT_FZ_UPDATE_CHECKER)
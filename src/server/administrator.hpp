@@ -17,6 +17,7 @@
 #include "../filezilla/util/xml_archiver.hpp"
 
 #include "../filezilla/acme/daemon.hpp"
+#include "../filezilla/metrics/http_exporter.hpp"
 
 #include "../filezilla/util/invoke_later.hpp"
 
@@ -40,6 +41,7 @@ public:
 				  fz::authentication::file_based_authenticator &authenticator,
 				  fz::util::xml_archiver<server_settings> &server_settings,
 				  fz::acme::daemon &acme,
+				  fz::metrics::http_exporter &metrics_exporter,
 				  const server_config_paths &config_paths);
 
 	~administrator() override;
@@ -70,6 +72,10 @@ private:
 	auto operator()(administration::set_ip_filters &&v);
 	auto operator()(administration::get_ftp_options &&v);
 	auto operator()(administration::set_ftp_options &&v);
+	auto operator()(administration::get_tls_handshake_stats &&v);
+	auto operator()(administration::get_metrics &&v);
+	auto operator()(administration::set_trace_sampling &&v);
+	auto operator()(administration::get_traces &&v);
 	auto operator()(administration::get_protocols_options &&v);
 	auto operator()(administration::set_protocols_options &&v);
 	auto operator()(administration::get_admin_options &&v);
@@ -79,6 +85,7 @@ private:
 	auto operator()(administration::get_acme_options &&v);
 	auto operator()(administration::set_acme_options &&v);
 	auto operator()(administration::acknowledge_queue_full::response &&v, administration::engine::session &session);
+	auto operator()(administration::set_event_filter &&v, administration::engine::session &session);
 	auto operator()(administration::admin_login &&v, administration::engine::session &session);
 	auto operator()(administration::generate_selfsigned_certificate &&v);
 	auto operator()(administration::upload_certificate &&v);
@@ -132,6 +139,7 @@ private:
 	fz::authentication::file_based_authenticator &authenticator_;
 	fz::util::xml_archiver<server_settings> &server_settings_;
 	fz::acme::daemon &acme_;
+	fz::metrics::http_exporter &metrics_exporter_;
 	const server_config_paths &config_paths_;
 	std::unique_ptr<log_forwarder> log_forwarder_;
 	std::unique_ptr<update_checker> update_checker_;
@@ -35,6 +35,8 @@ void administrator::set_admin_options(server_settings::admin_options &&opts)
 		acme_.set_certificate_used_status(server_settings->admin.tls.cert, true);
 	}
 
+	fz::securable_socket::credentials::reload_all();
+
 	handle_new_admin_settings();
 }
 
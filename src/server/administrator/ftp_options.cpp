@@ -1,4 +1,6 @@
 #include "../administrator.hpp"
+#include "../../filezilla/metrics/registry.hpp"
+#include "../../filezilla/metrics/tracer.hpp"
 
 auto administrator::operator()(administration::set_ftp_options &&v)
 {
@@ -25,6 +27,35 @@ auto administrator::operator()(administration::get_ftp_options &&v)
 	return v.success(ftp_server, ftp_server.sessions().tls.cert.load_extra(&logger_));
 }
 
+auto administrator::operator()(administration::get_tls_handshake_stats &&v)
+{
+	return v.success(ftp_server_.get_tls_handshake_stats());
+}
+
+auto administrator::operator()(administration::get_metrics &&v)
+{
+	return v.success(fz::metrics::registry::global().to_text());
+}
+
+auto administrator::operator()(administration::set_trace_sampling &&v)
+{
+	auto && [sample_one_in] = v.tuple();
+
+	auto server_settings = server_settings_.lock();
+
+	server_settings->metrics.trace_sample_one_in = sample_one_in;
+	fz::metrics::tracer::global().set_options(server_settings->metrics.tracer_options());
+
+	server_settings_.save_later();
+
+	return v.success();
+}
+
+auto administrator::operator()(administration::get_traces &&v)
+{
+	return v.success(fz::metrics::tracer::global().to_chrome_json());
+}
+
 void administrator::set_ftp_options(fz::ftp::server::options &&opts)
 {
 	auto server_settings = server_settings_.lock();
@@ -38,8 +69,15 @@ void administrator::set_ftp_options(fz::ftp::server::options &&opts)
 		acme_.set_certificate_used_status(server_settings->ftp_server.sessions().tls.cert, true);
 	}
 
+	// The certificate files might have been replaced on disk, even if their paths are still the same.
+	fz::securable_socket::credentials::reload_all();
+
 	ftp_server_.set_options(server_settings->ftp_server);
 }
 
 FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_ftp_options);
 FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::set_ftp_options);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_tls_handshake_stats);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_metrics);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::set_trace_sampling);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_traces);
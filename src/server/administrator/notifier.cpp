@@ -1,4 +1,5 @@
 #include "notifier.hpp"
+#include "session_data.hpp"
 #include "debug.hpp"
 #include "../../filezilla/mpl/for_each.hpp"
 
@@ -16,7 +17,7 @@ administrator::notifier::notifier(administrator &administrator, fz::ftp::session
 	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
 
 	if (num_of_sessions > 0)
-		administrator_->admin_server_.broadcast<administration::session::start>(session_id_, start_, peer_ip_, peer_address_type_);
+		administrator_->admin_server_.broadcast_if<administration::session::start>(session_data::accepting(session_data::events::session_start, session_id_, std::string_view(user_name_)), session_id_, start_, peer_ip_, peer_address_type_);
 }
 
 administrator::notifier::~notifier()
@@ -31,7 +32,7 @@ administrator::notifier::~notifier()
 	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
 
 	if (num_of_sessions > 0)
-		administrator_->admin_server_.broadcast<administration::session::stop>(session_id_, fz::monotonic_clock::now()-monotonic_start_);
+		administrator_->admin_server_.broadcast_if<administration::session::stop>(session_data::accepting(session_data::events::session_start, session_id_, std::string_view(user_name_)), session_id_, fz::monotonic_clock::now()-monotonic_start_);
 }
 
 void administrator::notifier::notify_user_name(std::string_view name)
@@ -45,11 +46,42 @@ void administrator::notifier::notify_user_name(std::string_view name)
 
 	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
 
+	auto old_name = std::move(user_name_);
 	user_name_ = name;
 	user_name_set_time_ = fz::monotonic_clock::now()-monotonic_start_;
 
-	if (num_of_sessions > 0)
-		administrator_->admin_server_.broadcast<administration::session::user_name>(session_id_, user_name_set_time_, name);
+	log_forwarder_.set_user_name(name);
+
+	if (num_of_sessions > 0) {
+		auto &server = administrator_->admin_server_;
+
+		// Clients that filter by user name might not have been informed about this session yet, or they might no longer be interested in it.
+		auto starts_matching = [&](administration::engine::session &s) {
+			auto &sd = s.get_user_data<session_data>();
+			return !sd.matches(session_id_, old_name) && sd.matches(session_id_, name);
+		};
+
+		auto stops_matching = [&](administration::engine::session &s) {
+			auto &sd = s.get_user_data<session_data>();
+			return sd.matches(session_id_, old_name) && !sd.matches(session_id_, name);
+		};
+
+		server.broadcast_if<administration::session::start>([&](administration::engine::session &s) {
+			return starts_matching(s) && s.get_user_data<session_data>().accepts(session_data::events::session_start);
+		}, session_id_, start_, peer_ip_, peer_address_type_);
+
+		if (proto_info_) {
+			server.broadcast_if<administration::session::protocol_info>([&](administration::engine::session &s) {
+				return starts_matching(s) && s.get_user_data<session_data>().accepts(session_data::events::protocol_info);
+			}, session_id_, proto_info_set_time_, *proto_info_);
+		}
+
+		server.broadcast_if<administration::session::user_name>(session_data::accepting(session_data::events::user_name, session_id_, name), session_id_, user_name_set_time_, name);
+
+		server.broadcast_if<administration::session::stop>([&](administration::engine::session &s) {
+			return stops_matching(s) && s.get_user_data<session_data>().accepts(session_data::events::session_start);
+		}, session_id_, user_name_set_time_);
+	}
 }
 
 void administrator::notifier::notify_entry_open(std::uint64_t id, std::string_view path, int64_t size)
@@ -69,7 +101,7 @@ void administrator::notifier::notify_entry_open(std::uint64_t id, std::string_vi
 	e.open_time_ = fz::monotonic_clock::now()-monotonic_start_;
 
 	if (num_of_sessions > 0)
-		administrator_->admin_server_.broadcast<administration::session::entry_open>(session_id_, e.open_time_, id, path, size);
+		administrator_->admin_server_.broadcast_if<administration::session::entry_open>(session_data::accepting(session_data::events::entry_open, session_id_, std::string_view(user_name_)), session_id_, e.open_time_, id, path, size);
 }
 
 void administrator::notifier::notify_entry_close(std::uint64_t id, int error)
@@ -87,7 +119,7 @@ void administrator::notifier::notify_entry_close(std::uint64_t id, int error)
 
 	if (num_of_sessions > 0) {
 		auto now = fz::monotonic_clock::now()-monotonic_start_;
-		administrator_->admin_server_.broadcast<administration::session::entry_close>(session_id_, now, id, error);
+		administrator_->admin_server_.broadcast_if<administration::session::entry_close>(session_data::accepting(session_data::events::entry_open, session_id_, std::string_view(user_name_)), session_id_, now, id, error);
 	}
 }
 
@@ -128,7 +160,7 @@ void administrator::notifier::notify_entry_write(std::uint64_t id, std::int64_t
 
 		if (must_report) {
 			e.last_reported_written_time_ = now;
-			administrator_->admin_server_.broadcast<administration::session::entry_written>(session_id_, now, id, e.written, e.size);
+			administrator_->admin_server_.broadcast_if<administration::session::entry_written>(session_data::accepting(session_data::events::entry_progress, session_id_, std::string_view(user_name_)), session_id_, now, id, e.written, e.size);
 		}
 	}
 }
@@ -163,7 +195,7 @@ void administrator::notifier::notify_entry_read(std::uint64_t id, std::int64_t a
 
 		if (must_report) {
 			e.last_reported_read_time_ = now;
-			administrator_->admin_server_.broadcast<administration::session::entry_read>(session_id_, now, id, e.read);
+			administrator_->admin_server_.broadcast_if<administration::session::entry_read>(session_data::accepting(session_data::events::entry_progress, session_id_, std::string_view(user_name_)), session_id_, now, id, e.read);
 		}
 	}
 }
@@ -193,7 +225,7 @@ void administrator::notifier::notify_protocol_info(const protocol_info &info)
 	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
 
 	if (num_of_sessions > 0 && proto_info_)
-		administrator_->admin_server_.broadcast<administration::session::protocol_info>(session_id_, proto_info_set_time_, *proto_info_);
+		administrator_->admin_server_.broadcast_if<administration::session::protocol_info>(session_data::accepting(session_data::events::protocol_info, session_id_, std::string_view(user_name_)), session_id_, proto_info_set_time_, *proto_info_);
 }
 
 
@@ -209,19 +241,31 @@ void administrator::notifier::send_session_info(administration::engine::session
 	if (administrator_->admin_server_.get_number_of_sessions() == 0)
 		return;
 
+	auto &sd = session.get_user_data<session_data>();
+
+	if (!sd.wants(session_data::events::session_start, session_id_, user_name_))
+		return;
+
 	session.send<administration::session::start>(session_id_, start_, peer_ip_, peer_address_type_);
-	session.send<administration::session::user_name>(session_id_, user_name_set_time_, user_name_);
 
-	if (proto_info_)
+	if (sd.wants(session_data::events::user_name, session_id_, user_name_))
+		session.send<administration::session::user_name>(session_id_, user_name_set_time_, user_name_);
+
+	if (proto_info_ && sd.wants(session_data::events::protocol_info, session_id_, user_name_))
 		session.send<administration::session::protocol_info>(session_id_, proto_info_set_time_,*proto_info_);
 
+	if (!sd.wants(session_data::events::entry_open, session_id_, user_name_))
+		return;
+
+	bool wants_progress = sd.wants(session_data::events::entry_progress, session_id_, user_name_);
+
 	for (auto &[id, e]: entries_) {
 		session.send<administration::session::entry_open>(session_id_, e.open_time_, id, e.path, e.size);
 
-		if (e.last_written_time_)
+		if (e.last_written_time_ && wants_progress)
 			session.send<administration::session::entry_written>(session_id_, e.last_written_time_, id, e.written, e.size);
 
-		if (e.last_read_time_)
+		if (e.last_read_time_ && wants_progress)
 			session.send<administration::session::entry_read>(session_id_, e.last_read_time_, id, e.read);
 	}
 }
@@ -254,7 +298,7 @@ void administrator::log_forwarder::do_log(fz::logmsg::type t, const info_list &l
 		fz::scoped_lock lock(mutex_);
 
 		if (administrator_ && administrator_->admin_server_.get_number_of_sessions() > 0)
-			administrator_->admin_server_.broadcast<administration::log>(fz::datetime::now(), session_id_, t, l.as_string, message);
+			administrator_->admin_server_.broadcast_if<administration::log>(session_data::accepting_log(t, session_id_, std::string_view(user_name_)), fz::datetime::now(), session_id_, t, l.as_string, message);
 	}
 
 	modularized::do_log(t, l, std::move(message));
@@ -266,3 +310,10 @@ void administrator::log_forwarder::detach_from_administrator()
 
 	administrator_ = nullptr;
 }
+
+void administrator::log_forwarder::set_user_name(std::string_view name)
+{
+	fz::scoped_lock lock(mutex_);
+
+	user_name_ = name;
+}
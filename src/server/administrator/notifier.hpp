@@ -11,10 +11,12 @@ public:
 	void do_log(fz::logmsg::type t, const info_list &l, std::wstring &&message) override;
 
 	void detach_from_administrator();
+	void set_user_name(std::string_view name);
 
 private:
 	administrator *administrator_;
 	fz::ftp::session::id session_id_;
+	std::string user_name_;
 
 	mutable fz::mutex mutex_;
 };
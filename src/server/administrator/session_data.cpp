@@ -0,0 +1,95 @@
+#include <algorithm>
+
+#include "session_data.hpp"
+
+void administrator::session_data::set_filter(administration::event_filter &&filter)
+{
+	filter_ = std::move(filter);
+
+	sample_counter_ = 0;
+	window_start_ = {};
+	events_in_window_ = 0;
+}
+
+const administration::event_filter &administrator::session_data::get_filter() const
+{
+	return filter_;
+}
+
+bool administrator::session_data::matches(fz::ftp::session::id session_id, std::string_view user_name) const
+{
+	if (!filter_.session_ids.empty()) {
+		bool in_range = std::any_of(filter_.session_ids.begin(), filter_.session_ids.end(), [session_id](const auto &r) {
+			return r.first <= session_id && session_id <= r.last;
+		});
+
+		if (!in_range)
+			return false;
+	}
+
+	if (!filter_.user_names.empty()) {
+		if (user_name.empty())
+			return false;
+
+		if (std::find(filter_.user_names.begin(), filter_.user_names.end(), user_name) == filter_.user_names.end())
+			return false;
+	}
+
+	return true;
+}
+
+bool administrator::session_data::wants(events e, fz::ftp::session::id session_id, std::string_view user_name) const
+{
+	return (filter_.subscribed & e) && matches(session_id, user_name);
+}
+
+bool administrator::session_data::accepts(events e, fz::ftp::session::id session_id, std::string_view user_name)
+{
+	if (!wants(e, session_id, user_name))
+		return false;
+
+	if (e == events::entry_progress)
+		return admits_high_frequency_event();
+
+	return true;
+}
+
+bool administrator::session_data::accepts_log(fz::logmsg::type t, fz::ftp::session::id session_id, std::string_view user_name)
+{
+	if ((filter_.log_types & t) == 0)
+		return false;
+
+	if (!wants(events::log, session_id, user_name))
+		return false;
+
+	return admits_high_frequency_event();
+}
+
+bool administrator::session_data::accepts(events e)
+{
+	return bool(filter_.subscribed & e);
+}
+
+bool administrator::session_data::admits_high_frequency_event()
+{
+	if (filter_.sample_one_in > 1) {
+		if (sample_counter_++ % filter_.sample_one_in != 0)
+			return false;
+	}
+
+	if (filter_.max_events_per_second > 0) {
+		auto now = fz::monotonic_clock::now();
+
+		if (!window_start_ || (now - window_start_) >= fz::duration::from_seconds(1)) {
+			window_start_ = now;
+			events_in_window_ = 0;
+		}
+
+		if (events_in_window_ >= filter_.max_events_per_second)
+			return false;
+
+		++events_in_window_;
+	}
+
+	return true;
+}
@@ -0,0 +1,56 @@
+#ifndef ADMINISTRATOR_SESSION_DATA_HPP
+#define ADMINISTRATOR_SESSION_DATA_HPP
+
+#include "../administrator.hpp"
+
+struct administrator::session_data
+{
+	using events = administration::event_filter::events;
+
+	bool is_in_overflow{};
+
+	void set_filter(administration::event_filter &&filter);
+	const administration::event_filter &get_filter() const;
+
+	//! \returns true if the client is interested in events about the given ftp session.
+	bool matches(fz::ftp::session::id session_id, std::string_view user_name) const;
+
+	//! \returns true if the client subscribed to the given kind of events about the given ftp session.
+	//! It doesn't take sampling and rate capping into account.
+	bool wants(events e, fz::ftp::session::id session_id, std::string_view user_name) const;
+
+	//! \returns true if the event must be sent out to the client.
+	//! High frequency events (entry_progress and log) are also subject to sampling and rate capping,
+	//! hence this function must be invoked exactly once per each such event, whilst the admin sessions list is locked.
+	bool accepts(events e, fz::ftp::session::id session_id, std::string_view user_name);
+	bool accepts_log(fz::logmsg::type t, fz::ftp::session::id session_id, std::string_view user_name);
+	bool accepts(events e);
+
+	//! Convenience functions, to be used as predicates for administration::engine::server::broadcast_if().
+	template <typename... Args>
+	static auto accepting(Args... args)
+	{
+		return [args...](administration::engine::session &s) {
+			return s.get_user_data<session_data>().accepts(args...);
+		};
+	}
+
+	template <typename... Args>
+	static auto accepting_log(Args... args)
+	{
+		return [args...](administration::engine::session &s) {
+			return s.get_user_data<session_data>().accepts_log(args...);
+		};
+	}
+
+private:
+	bool admits_high_frequency_event();
+
+	administration::event_filter filter_{};
+
+	std::uint32_t sample_counter_{};
+	fz::monotonic_clock window_start_{};
+	std::uint32_t events_in_window_{};
+};
+
+#endif // ADMINISTRATOR_SESSION_DATA_HPP
@@ -20,6 +20,8 @@
 #include "../filezilla/build_info.hpp"
 #include "../filezilla/util/username.hpp"
 #include "../filezilla/tls_exit.hpp"
+#include "../filezilla/metrics/http_exporter.hpp"
+#include "../filezilla/metrics/tracer.hpp"
 
 #include "server_settings.hpp"
 #include "administrator.hpp"
@@ -424,8 +426,14 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			ftp_server_options
 		);
 
+		ftp_server.set_hash_index_path((config_paths.for_writing() / fzT("hash_index.txt")).str());
 		ftp_server.start();
 
+		fz::metrics::tracer::global().set_options(settings.metrics.tracer_options());
+
+		fz::metrics::http_exporter metrics_exporter(context, logger);
+		metrics_exporter.set_port(settings.metrics.local_port);
+
 		fz::tls_system_trust_store trust_store(pool);
 		fz::acme::daemon acme(pool, server_loop, logger, trust_store);
 		acme.set_root_path(config_paths.certificates());
@@ -441,6 +449,7 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			file_auth,
 			delayed_settings,
 			acme,
+			metrics_exporter,
 			config_paths
 		);
 
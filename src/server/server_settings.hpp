@@ -20,6 +20,7 @@
 #include "../filezilla/rmp/address_info.hpp"
 
 #include "../filezilla/acme/challenges.hpp"
+#include "../filezilla/metrics/tracer.hpp"
 #include "legacy_options.hpp"
 
 #include "server_config_paths.hpp"
@@ -151,6 +152,37 @@ struct server_settings {
 
 	acme_options acme;
 
+	struct metrics_options {
+		metrics_options() {}
+
+		unsigned int local_port = 0;
+		std::uint32_t trace_sample_one_in = 0;
+		std::uint32_t trace_buffer_size = 16*1024;
+
+		fz::metrics::tracer::options tracer_options() const
+		{
+			return fz::metrics::tracer::options()
+				.sample_one_in(std::uint32_t(trace_sample_one_in))
+				.capacity(std::size_t(trace_buffer_size));
+		}
+
+		template <typename Archive>
+		void serialize(Archive &ar) {
+			using namespace fz::serialization;
+
+			ar(
+				value_info(optional_nvp(local_port, "local_port"),
+					"Port on the loopback interfaces the metrics are served at, in the Prometheus text format, at /metrics. 0 disables the endpoint."),
+				value_info(optional_nvp(trace_sample_one_in, "trace_sample_one_in"),
+					"One FTP command every this many gets its phases traced. 0 disables tracing."),
+				value_info(optional_nvp(trace_buffer_size, "trace_buffer_size"),
+					"Number of trace spans kept in memory, the oldest ones being discarded.")
+			);
+		}
+	};
+
+	metrics_options metrics;
+
 	fz::update::checker::options update_checker = {};
 
 	template <typename Archive>
@@ -184,7 +216,11 @@ struct server_settings {
 
 			value_info(optional_nvp(update_checker,
 					   "update_checker"),
-					   "Update checker options.")
+					   "Update checker options."),
+
+			value_info(optional_nvp(metrics,
+					   "metrics"),
+					   "Metrics export options.")
 		);
 
 		if constexpr (trait::is_input_v<Archive>)
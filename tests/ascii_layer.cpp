@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+#include <libfilezilla/socket.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/ftp/ascii_layer.hpp"
+
+/*
+ * This testsuite asserts the correctness of the ascii_layer class.
+ */
+
+class ascii_layer_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(ascii_layer_test);
+	CPPUNIT_TEST(test_read);
+	CPPUNIT_TEST(test_read_crlf_split_across_reads);
+	CPPUNIT_TEST(test_read_trailing_cr);
+	CPPUNIT_TEST(test_read_would_block_after_cr);
+	CPPUNIT_TEST(test_write);
+	CPPUNIT_TEST(test_write_short);
+	CPPUNIT_TEST(test_write_would_block);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_read();
+	void test_read_crlf_split_across_reads();
+	void test_read_trailing_cr();
+	void test_read_would_block_after_cr();
+	void test_write();
+	void test_write_short();
+	void test_write_would_block();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ascii_layer_test);
+
+namespace {
+
+// Reads are served from a list of chunks, one per read at most, an empty chunk meaning the read would block and no chunks left meaning EOF.
+// Writes are collected, at most max_write bytes at a time, 0 meaning the write would block.
+class mock_socket: public fz::socket_interface
+{
+public:
+	mock_socket(std::deque<std::string> chunks = {})
+		: fz::socket_interface(this)
+		, chunks_(std::move(chunks))
+	{}
+
+	int read(void *buffer, unsigned int size, int &error) override
+	{
+		if (chunks_.empty())
+			return 0;
+
+		auto &chunk = chunks_.front();
+
+		if (chunk.empty()) {
+			chunks_.pop_front();
+			error = EAGAIN;
+			return -1;
+		}
+
+		auto amount = std::min<std::size_t>(size, chunk.size());
+		std::memcpy(buffer, chunk.data(), amount);
+		chunk.erase(0, amount);
+
+		if (chunk.empty())
+			chunks_.pop_front();
+
+		return int(amount);
+	}
+
+	int write(const void *buffer, unsigned int size, int &error) override
+	{
+		if (max_write == 0) {
+			error = EAGAIN;
+			return -1;
+		}
+
+		auto amount = std::min<std::size_t>(size, max_write);
+		written.append(reinterpret_cast<const char *>(buffer), amount);
+		return int(amount);
+	}
+
+	void set_event_handler(fz::event_handler *, fz::socket_event_flag = {}) override {}
+	fz::native_string peer_host() const override { return {}; }
+	int peer_port(int &error) const override { error = ENOTCONN; return -1; }
+	int connect(const fz::native_string &, unsigned int, fz::address_type = fz::address_type::unknown) override { return EINVAL; }
+	fz::socket_state get_state() const override { return fz::socket_state::connected; }
+	int shutdown() override { return 0; }
+	int shutdown_read() override { return 0; }
+	int set_buffer_sizes(int, int) override { return 0; }
+
+	std::size_t max_write = std::size_t(-1);
+	std::string written;
+
+private:
+	std::deque<std::string> chunks_;
+};
+
+// What the layer's reads must produce out of the whole stream: CR's preceding a LF are removed.
+std::string strip_crs(std::string_view in)
+{
+	std::string out;
+
+	for (std::size_t i = 0; i < in.size(); ++i) {
+		if (in[i] != '\r' || i + 1 == in.size() || in[i+1] != '\n')
+			out += in[i];
+	}
+
+	return out;
+}
+
+// What the layer's writes must produce out of the whole stream: LF's not already preceded by a CR get one.
+std::string add_crs(std::string_view in)
+{
+	std::string out;
+
+	for (std::size_t i = 0; i < in.size(); ++i) {
+		if (in[i] == '\n' && (i == 0 || in[i-1] != '\r'))
+			out += '\r';
+
+		out += in[i];
+	}
+
+	return out;
+}
+
+std::deque<std::string> split(std::string_view in, std::size_t chunk_size)
+{
+	std::deque<std::string> chunks;
+
+	for (std::size_t i = 0; i < in.size(); i += chunk_size)
+		chunks.emplace_back(in.substr(i, chunk_size));
+
+	return chunks;
+}
+
+std::string read_all(fz::ftp::ascii_layer &layer, std::size_t read_size)
+{
+	std::string out;
+	std::string buf(read_size, '\0');
+
+	while (true) {
+		int error = 0;
+		int read = layer.read(buf.data(), unsigned(read_size), error);
+
+		if (read < 0) {
+			CPPUNIT_ASSERT_EQUAL(EAGAIN, error);
+			continue;
+		}
+
+		if (read == 0)
+			return out;
+
+		out.append(buf.data(), std::size_t(read));
+	}
+}
+
+void write_all(fz::ftp::ascii_layer &layer, std::string_view in, std::size_t write_size)
+{
+	for (std::size_t pos = 0; pos < in.size();) {
+		int error = 0;
+		int written = layer.write(in.data() + pos, unsigned(std::min(write_size, in.size() - pos)), error);
+
+		// Writing 0 bytes would signal a closed connection.
+		CPPUNIT_ASSERT(written > 0);
+		pos += std::size_t(written);
+	}
+}
+
+const std::string_view texts[] = {
+	"",
+	"line\r\n",
+	"one\r\ntwo\r\nthree",
+	"lone\rcr and lone\nlf",
+	"\r\n\r\n",
+	"\r\r\n\n\n\r\r",
+	"\n",
+	"\r",
+	"a line long enough for the vectorized search to kick in, twice over, and more\r\nand another one, just as long as the first one, for good measure\r\n"
+};
+
+}
+
+void ascii_layer_test::test_read()
+{
+	for (auto text: texts) {
+		for (std::size_t read_size = 1; read_size <= text.size() + 1; ++read_size) {
+			mock_socket socket({std::string(text)});
+			fz::ftp::ascii_layer layer(nullptr, socket);
+
+			CPPUNIT_ASSERT_EQUAL(strip_crs(text), read_all(layer, read_size));
+		}
+	}
+}
+
+void ascii_layer_test::test_read_crlf_split_across_reads()
+{
+	for (auto text: texts) {
+		for (std::size_t chunk_size = 1; chunk_size <= text.size(); ++chunk_size) {
+			for (std::size_t read_size = 1; read_size <= text.size() + 1; ++read_size) {
+				mock_socket socket(split(text, chunk_size));
+				fz::ftp::ascii_layer layer(nullptr, socket);
+
+				CPPUNIT_ASSERT_EQUAL(strip_crs(text), read_all(layer, read_size));
+			}
+		}
+	}
+}
+
+void ascii_layer_test::test_read_trailing_cr()
+{
+	mock_socket socket({"a\r"});
+	fz::ftp::ascii_layer layer(nullptr, socket);
+
+	char buf[16];
+	int error = 0;
+
+	// The CR is held back, for a LF might follow it...
+	CPPUNIT_ASSERT_EQUAL(1, layer.read(buf, sizeof(buf), error));
+	CPPUNIT_ASSERT_EQUAL('a', buf[0]);
+
+	// ...but then EOF comes instead.
+	CPPUNIT_ASSERT_EQUAL(1, layer.read(buf, sizeof(buf), error));
+	CPPUNIT_ASSERT_EQUAL('\r', buf[0]);
+
+	CPPUNIT_ASSERT_EQUAL(0, layer.read(buf, sizeof(buf), error));
+}
+
+void ascii_layer_test::test_read_would_block_after_cr()
+{
+	for (std::size_t read_size: {std::size_t(1), std::size_t(16)}) {
+		mock_socket socket({"a\r", "", "\nb\r", "", "c"});
+		fz::ftp::ascii_layer layer(nullptr, socket);
+
+		char buf[16];
+		std::string out;
+
+		for (int i = 0; i < 16; ++i) {
+			int error = 0;
+			int read = layer.read(buf, unsigned(read_size), error);
+
+			if (read == 0)
+				break;
+
+			if (read < 0)
+				CPPUNIT_ASSERT_EQUAL(EAGAIN, error);
+			else
+				out.append(buf, std::size_t(read));
+		}
+
+		// The held back CR survives the would-block conditions.
+		CPPUNIT_ASSERT_EQUAL(std::string("a\nb\rc"), out);
+	}
+}
+
+void ascii_layer_test::test_write()
+{
+	for (auto text: texts) {
+		for (std::size_t write_size = 1; write_size <= text.size(); ++write_size) {
+			mock_socket socket;
+			fz::ftp::ascii_layer layer(nullptr, socket);
+
+			write_all(layer, text, write_size);
+			CPPUNIT_ASSERT_EQUAL(add_crs(text), socket.written);
+		}
+	}
+}
+
+void ascii_layer_test::test_write_short()
+{
+	// Short writes end, among other places, right after the CR's added before the LF's.
+	for (auto text: texts) {
+		for (std::size_t max_write = 1; max_write <= 2 * text.size(); ++max_write) {
+			for (std::size_t write_size = 1; write_size <= text.size(); ++write_size) {
+				mock_socket socket;
+				socket.max_write = max_write;
+				fz::ftp::ascii_layer layer(nullptr, socket);
+
+				write_all(layer, text, write_size);
+				CPPUNIT_ASSERT_EQUAL(add_crs(text), socket.written);
+			}
+		}
+	}
+}
+
+void ascii_layer_test::test_write_would_block()
+{
+	mock_socket socket;
+	fz::ftp::ascii_layer layer(nullptr, socket);
+
+	int error = 0;
+
+	socket.max_write = 1;
+	CPPUNIT_ASSERT_EQUAL(1, layer.write("a\nb", 3, error));
+
+	socket.max_write = 0;
+	CPPUNIT_ASSERT_EQUAL(-1, layer.write("\nb", 2, error));
+	CPPUNIT_ASSERT_EQUAL(EAGAIN, error);
+
+	// The CR to add before the LF is still owed.
+	socket.max_write = std::size_t(-1);
+	CPPUNIT_ASSERT_EQUAL(2, layer.write("\nb", 2, error));
+	CPPUNIT_ASSERT_EQUAL(std::string("a\r\nb"), socket.written);
+}
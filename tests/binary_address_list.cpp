@@ -0,0 +1,187 @@
+#include "test_utils.hpp"
+
+#include "../src/filezilla/tcp/binary_address_list.hpp"
+
+/*
+ * This testsuite asserts the correctness of the binary_address_list merge_with() and subtract() functions.
+ */
+
+class binary_address_list_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(binary_address_list_test);
+	CPPUNIT_TEST(test_merge_overlapping_and_adjacent);
+	CPPUNIT_TEST(test_merge_at_the_edges);
+	CPPUNIT_TEST(test_subtract_full_coverage);
+	CPPUNIT_TEST(test_subtract_partial_coverage);
+	CPPUNIT_TEST(test_subtract_at_the_edges);
+	CPPUNIT_TEST(test_self);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_merge_overlapping_and_adjacent();
+	void test_merge_at_the_edges();
+	void test_subtract_full_coverage();
+	void test_subtract_partial_coverage();
+	void test_subtract_at_the_edges();
+	void test_self();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(binary_address_list_test);
+
+namespace {
+
+const std::string ipv4_max = "255.255.255.255";
+const std::string ipv6_max = "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff";
+
+fz::tcp::binary_address_list make_list(std::string_view ranges)
+{
+	fz::tcp::binary_address_list list;
+	// Ranges that don't parse would be silently skipped otherwise.
+	CPPUNIT_ASSERT(fz::tcp::convert(ranges, list, [](std::size_t, const std::string_view &) { return false; }));
+
+	return list;
+}
+
+// The expected ranges must be given already coalesced.
+void check_merge(std::string_view lhs, std::string_view rhs, std::string_view expected)
+{
+	auto list = make_list(lhs);
+	list.merge_with(make_list(rhs));
+
+	CPPUNIT_ASSERT_EQUAL(make_list(expected).to_string(), list.to_string());
+}
+
+void check_subtract(std::string_view lhs, std::string_view rhs, std::string_view expected)
+{
+	auto list = make_list(lhs);
+	list.subtract(make_list(rhs));
+
+	CPPUNIT_ASSERT_EQUAL(make_list(expected).to_string(), list.to_string());
+}
+
+}
+
+void binary_address_list_test::test_merge_overlapping_and_adjacent()
+{
+	// Overlapping.
+	check_merge("10.0.0.1-10.0.0.10", "10.0.0.5-10.0.0.20", "10.0.0.1-10.0.0.20");
+
+	// Contained.
+	check_merge("10.0.0.1-10.0.0.20", "10.0.0.5-10.0.0.6", "10.0.0.1-10.0.0.20");
+	check_merge("10.0.0.5-10.0.0.6", "10.0.0.1-10.0.0.20", "10.0.0.1-10.0.0.20");
+
+	// Adjacent, on either side.
+	check_merge("10.0.0.1-10.0.0.10", "10.0.0.11-10.0.0.20", "10.0.0.1-10.0.0.20");
+	check_merge("10.0.0.11-10.0.0.20", "10.0.0.1-10.0.0.10", "10.0.0.1-10.0.0.20");
+
+	// One address apart.
+	check_merge("10.0.0.1-10.0.0.10", "10.0.0.12-10.0.0.20", "10.0.0.1-10.0.0.10 10.0.0.12-10.0.0.20");
+
+	// A range bridging two others, along with a chain of adjacent single addresses.
+	check_merge("10.0.0.30 10.0.0.1-10.0.0.10 10.0.0.32", "10.0.0.31 10.0.0.11-10.0.0.29", "10.0.0.1-10.0.0.32");
+
+	check_merge("2001:db8::1-2001:db8::10", "2001:db8::11-2001:db8::20 2001:db8::15-2001:db8::30", "2001:db8::1-2001:db8::30");
+}
+
+void binary_address_list_test::test_merge_at_the_edges()
+{
+	// The last address is adjacent to the one before it...
+	check_merge("255.255.255.200-255.255.255.254", ipv4_max, "255.255.255.200-" + ipv4_max);
+	check_merge("255.255.255.250-" + ipv4_max, "255.255.255.200-255.255.255.251", "255.255.255.200-" + ipv4_max);
+
+	// ...but not to the first one, which incrementing it would wrap around to.
+	check_merge(ipv4_max, "0.0.0.0", "0.0.0.0 " + ipv4_max);
+	check_merge("0.0.0.0-0.0.0.10", "255.255.255.250-" + ipv4_max, "0.0.0.0-0.0.0.10 255.255.255.250-" + ipv4_max);
+
+	check_merge("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ff00-ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe", ipv6_max, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ff00-" + ipv6_max);
+	check_merge(ipv6_max, "::", ":: " + ipv6_max);
+	check_merge("::-::10", "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fff0-" + ipv6_max, "::-::10 ffff:ffff:ffff:ffff:ffff:ffff:ffff:fff0-" + ipv6_max);
+
+	// Everything.
+	check_merge("0.0.0.0-127.255.255.255", "128.0.0.0-" + ipv4_max, "0.0.0.0-" + ipv4_max);
+	check_merge("*", "10.0.0.1 ::1", "*");
+}
+
+void binary_address_list_test::test_subtract_full_coverage()
+{
+	// Exactly the same range.
+	check_subtract("10.0.0.5-10.0.0.10", "10.0.0.5-10.0.0.10", "");
+
+	// Covered by a bigger one.
+	check_subtract("10.0.0.5-10.0.0.10", "10.0.0.1-10.0.0.20", "");
+
+	// Covered by adjacent or overlapping ones only as a whole.
+	check_subtract("10.0.0.5-10.0.0.10", "10.0.0.1-10.0.0.7 10.0.0.8-10.0.0.20", "");
+	check_subtract("10.0.0.5-10.0.0.10", "10.0.0.6-10.0.0.20 10.0.0.1-10.0.0.8", "");
+
+	// Several ranges covered by a single one.
+	check_subtract("10.0.0.1-10.0.0.10 10.0.0.20-10.0.0.30", "10.0.0.0-10.0.0.40", "");
+
+	check_subtract("2001:db8::5-2001:db8::10", "2001:db8::/64", "");
+
+	// Nothing covered at all.
+	check_subtract("10.0.0.5-10.0.0.10", "10.0.0.1-10.0.0.4 10.0.0.11-10.0.0.20", "10.0.0.5-10.0.0.10");
+	check_subtract("10.0.0.5-10.0.0.10", "2001:db8::/64", "10.0.0.5-10.0.0.10");
+}
+
+void binary_address_list_test::test_subtract_partial_coverage()
+{
+	// The beginning.
+	check_subtract("10.0.0.5-10.0.0.20", "10.0.0.1-10.0.0.9", "10.0.0.10-10.0.0.20");
+	check_subtract("10.0.0.5-10.0.0.20", "10.0.0.5", "10.0.0.6-10.0.0.20");
+
+	// The end.
+	check_subtract("10.0.0.5-10.0.0.20", "10.0.0.15-10.0.0.30", "10.0.0.5-10.0.0.14");
+	check_subtract("10.0.0.5-10.0.0.20", "10.0.0.20", "10.0.0.5-10.0.0.19");
+
+	// The middle.
+	check_subtract("10.0.0.5-10.0.0.20", "10.0.0.8-10.0.0.9", "10.0.0.5-10.0.0.7 10.0.0.10-10.0.0.20");
+
+	// Several holes, made by overlapping ranges too.
+	check_subtract("10.0.0.5-10.0.0.20", "10.0.0.7 10.0.0.10-10.0.0.12 10.0.0.9-10.0.0.11", "10.0.0.5-10.0.0.6 10.0.0.8 10.0.0.13-10.0.0.20");
+
+	// A single range eating into two.
+	check_subtract("10.0.0.1-10.0.0.10 10.0.0.20-10.0.0.30", "10.0.0.5-10.0.0.25", "10.0.0.1-10.0.0.4 10.0.0.26-10.0.0.30");
+
+	check_subtract("2001:db8::1-2001:db8::30", "2001:db8::10-2001:db8::1f", "2001:db8::1-2001:db8::f 2001:db8::20-2001:db8::30");
+
+	// Whatever's left is looked up as usual.
+	auto list = make_list("10.0.0.5-10.0.0.20");
+	list.subtract(make_list("10.0.0.8-10.0.0.9"));
+
+	CPPUNIT_ASSERT(list.contains("10.0.0.7", fz::address_type::ipv4));
+	CPPUNIT_ASSERT(!list.contains("10.0.0.8", fz::address_type::ipv4));
+	CPPUNIT_ASSERT(!list.contains("10.0.0.9", fz::address_type::ipv4));
+	CPPUNIT_ASSERT(list.contains("10.0.0.10", fz::address_type::ipv4));
+}
+
+void binary_address_list_test::test_subtract_at_the_edges()
+{
+	check_subtract("255.255.255.200-" + ipv4_max, ipv4_max, "255.255.255.200-255.255.255.254");
+	check_subtract("255.255.255.200-" + ipv4_max, "255.255.255.250-" + ipv4_max, "255.255.255.200-255.255.255.249");
+	check_subtract("255.255.255.200-" + ipv4_max, "255.255.255.210-255.255.255.220", "255.255.255.200-255.255.255.209 255.255.255.221-" + ipv4_max);
+	check_subtract("0.0.0.0-0.0.0.10", "0.0.0.0", "0.0.0.1-0.0.0.10");
+	check_subtract("0.0.0.0-0.0.0.10", "0.0.0.0-0.0.0.3", "0.0.0.4-0.0.0.10");
+
+	check_subtract("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ff00-" + ipv6_max, ipv6_max, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ff00-ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe");
+	check_subtract("::-::10", "::", "::1-::10");
+
+	// Everything but the first and the last addresses.
+	check_subtract("*", "0.0.0.0 " + ipv4_max + " :: " + ipv6_max, "0.0.0.1-255.255.255.254 ::1-ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe");
+
+	// Everything from everything.
+	check_subtract("*", "*", "");
+	check_subtract("10.0.0.1 ::1", "*", "");
+}
+
+void binary_address_list_test::test_self()
+{
+	auto list = make_list("10.0.0.1-10.0.0.10 2001:db8::1");
+
+	list.merge_with(list);
+	CPPUNIT_ASSERT_EQUAL(make_list("10.0.0.1-10.0.0.10 2001:db8::1").to_string(), list.to_string());
+
+	list.subtract(list);
+	CPPUNIT_ASSERT_EQUAL(std::string(), list.to_string());
+	CPPUNIT_ASSERT(!list.contains("10.0.0.1", fz::address_type::ipv4));
+}
@@ -0,0 +1,363 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/socket.hpp>
+#include <libfilezilla/thread_pool.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/logger/null.hpp"
+#include "../src/filezilla/ftp/commander.hpp"
+
+/*
+ * This testsuite asserts the correctness of the commander class, talking to it through a real control connection.
+ */
+
+class commander_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(commander_test);
+	CPPUNIT_TEST(test_pipelined_commands);
+	CPPUNIT_TEST(test_abor_of_pipelined_command);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_pipelined_commands();
+	void test_abor_of_pipelined_command();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(commander_test);
+
+namespace {
+
+const auto timeout = fz::duration::from_seconds(5);
+
+// How long to wait for something that must not happen, or for the server to act upon what it has just been told.
+const auto settle_time = fz::duration::from_milliseconds(200);
+
+template <typename Predicate>
+bool wait_until(fz::condition &condition, fz::scoped_lock &lock, Predicate &&pred, fz::duration timeout)
+{
+	auto deadline = fz::monotonic_clock::now() + timeout;
+
+	while (!pred()) {
+		auto left = deadline - fz::monotonic_clock::now();
+		if (left <= fz::duration())
+			return false;
+
+		condition.wait(lock, left);
+	}
+
+	return true;
+}
+
+// Holds on to the info requests, so that the test decides when, and in what order, they complete.
+class held_backend final: public fz::tvfs::backend
+{
+public:
+	void open_file(const fz::native_string &, fz::file::mode, fz::file::creation_flags, fz::receiver_handle<open_response> r) override
+	{
+		r(fz::result{fz::result::other}, fz::tvfs::fd_owner());
+	}
+
+	void open_directory(const fz::native_string &, fz::receiver_handle<open_response> r) override
+	{
+		r(fz::result{fz::result::other}, fz::tvfs::fd_owner());
+	}
+
+	void rename(const fz::native_string &, const fz::native_string &, fz::receiver_handle<rename_response> r) override
+	{
+		r(fz::result{fz::result::other});
+	}
+
+	void remove_file(const fz::native_string &, fz::receiver_handle<remove_response> r) override
+	{
+		r(fz::result{fz::result::other});
+	}
+
+	void remove_directory(const fz::native_string &, fz::receiver_handle<remove_response> r) override
+	{
+		r(fz::result{fz::result::other});
+	}
+
+	void info(const fz::native_string &, bool, fz::receiver_handle<info_response> r) override
+	{
+		fz::scoped_lock lock(mutex_);
+		infos_.push_back(std::move(r));
+		condition_.signal(lock);
+	}
+
+	void mkdir(const fz::native_string &, bool, fz::mkdir_permissions, fz::receiver_handle<mkdir_response> r) override
+	{
+		r(fz::result{fz::result::other});
+	}
+
+	void set_mtime(const fz::native_string &, const fz::datetime &, fz::receiver_handle<set_mtime_response> r) override
+	{
+		r(fz::result{fz::result::other});
+	}
+
+	bool wait_for_infos(std::size_t n)
+	{
+		fz::scoped_lock lock(mutex_);
+		return wait_until(condition_, lock, [&]{ return infos_.size() >= n; }, timeout);
+	}
+
+	//! Completes the i-th info request, making it a regular file of the given size.
+	void complete_info(std::size_t i, std::int64_t size)
+	{
+		fz::receiver_handle<info_response> r = [&] {
+			fz::scoped_lock lock(mutex_);
+			return std::move(infos_[i]);
+		}();
+
+		r(fz::result{fz::result::ok}, false, fz::local_filesys::file, size, fz::datetime::now(), 0);
+	}
+
+private:
+	fz::mutex mutex_;
+	fz::condition condition_;
+	std::vector<fz::receiver_handle<info_response>> infos_;
+};
+
+class always_authenticated final: public fz::ftp::controller
+{
+public:
+	fz::address_type get_control_socket_address_family() const override { return fz::address_type::ipv4; }
+	void authenticate_user(std::string_view, const fz::authentication::methods_list &, authenticate_user_response_handler *) override {}
+	void stop_ongoing_user_authentication() override {}
+	bool is_authenticated() const override { return true; }
+	void make_secure(std::string_view, make_secure_response_handler *handler) override { handler->handle_make_secure_response(make_secure_result::failed); }
+	secure_state get_secure_state() const override { return secure_state::insecure; }
+	std::string get_alpn() const override { return {}; }
+	void quit(int) override {}
+	void get_data_local_info(fz::address_type, bool, data_local_info_handler &handler) override { handler.handle_data_local_info(std::nullopt); }
+	void set_data_peer_hostaddress(fz::hostaddress) override {}
+	set_mode_result set_data_mode(data_mode) override { return set_mode_result::not_implemented; }
+	set_mode_result set_data_protection_mode(data_protection_mode) override { return set_mode_result::not_implemented; }
+	void start_data_transfer(fz::buffer_operator::adder_interface &, data_transfer_handler *, bool) override {}
+	void start_data_transfer(fz::buffer_operator::consumer_interface &, data_transfer_handler *, bool) override {}
+	data_connection_status close_data_connection() override { return data_connection_status::not_started; }
+	bool must_downgrade_log_level() override { return false; }
+};
+
+// The client end of the control connection.
+class ftp_client final: public fz::event_handler
+{
+public:
+	ftp_client(fz::event_loop &loop, fz::thread_pool &pool)
+		: fz::event_handler(loop)
+		, socket_(pool, this)
+	{}
+
+	~ftp_client() override
+	{
+		remove_handler();
+	}
+
+	bool connect(unsigned int port)
+	{
+		if (socket_.connect(fzT("127.0.0.1"), port, fz::address_type::ipv4) != 0)
+			return false;
+
+		fz::scoped_lock lock(mutex_);
+		return wait_until(condition_, lock, [&]{ return connected_ || failed_; }, timeout) && !failed_;
+	}
+
+	void send(std::string_view data)
+	{
+		int error = 0;
+		CPPUNIT_ASSERT_EQUAL(int(data.size()), socket_.write(data.data(), static_cast<unsigned int>(data.size()), error));
+	}
+
+	//! Returns the last line of the next reply, or an empty string if none comes within the given time.
+	std::string next_reply(fz::duration within = timeout)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		std::string reply;
+
+		wait_until(condition_, lock, [&] {
+			for (auto eol = received_.find("\r\n"); eol != std::string::npos; eol = received_.find("\r\n")) {
+				auto line = received_.substr(0, eol);
+				received_.erase(0, eol + 2);
+
+				if (line.size() >= 4 && line[3] == ' ') {
+					reply = std::move(line);
+					return true;
+				}
+			}
+
+			return failed_;
+		}, within);
+
+		return reply;
+	}
+
+private:
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::dispatch<fz::socket_event>(ev, this, &ftp_client::on_socket_event);
+	}
+
+	void on_socket_event(fz::socket_event_source *, fz::socket_event_flag type, int error)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		if (error)
+			failed_ = true;
+		else
+		if (type == fz::socket_event_flag::connection)
+			connected_ = true;
+		else
+		if (type == fz::socket_event_flag::read) {
+			char buf[1024];
+
+			while (true) {
+				int read_error = 0;
+				int read = socket_.read(buf, sizeof(buf), read_error);
+
+				if (read <= 0) {
+					if (read == 0 || read_error != EAGAIN)
+						failed_ = true;
+
+					break;
+				}
+
+				received_.append(buf, std::size_t(read));
+			}
+		}
+
+		condition_.signal(lock);
+	}
+
+	fz::socket socket_;
+
+	fz::mutex mutex_;
+	fz::condition condition_;
+	bool connected_{};
+	bool failed_{};
+	std::string received_;
+};
+
+// A commander talking to a client over loopback, looking entries up through a held_backend.
+class harness
+{
+public:
+	harness()
+		: listen_socket_(pool_, nullptr)
+		, client_(loop_, pool_)
+		, tvfs_(fz::logger::null)
+		, hash_engine_(pool_, fz::logger::null)
+		, timer_wheel_(loop_)
+		, notifier_(fz::tcp::session::notifier::factory::none.make_notifier(1, fz::datetime::now(), "127.0.0.1", fz::address_type::ipv4, fz::logger::null))
+	{
+		tvfs_.set_backend(backend_);
+		tvfs_.set_mount_tree(std::make_shared<fz::tvfs::mount_tree>(fz::tvfs::mount_table{
+			{ "/", fzT("/nonexistent"), fz::tvfs::mount_point::read_only }
+		}));
+
+		CPPUNIT_ASSERT(listen_socket_.bind("127.0.0.1"));
+		CPPUNIT_ASSERT_EQUAL(0, listen_socket_.listen(fz::address_type::ipv4));
+
+		int error = 0;
+		int port = listen_socket_.local_port(error);
+		CPPUNIT_ASSERT(port > 0);
+
+		CPPUNIT_ASSERT(client_.connect(unsigned(port)));
+
+		for (auto deadline = fz::monotonic_clock::now() + timeout; !server_socket_ && fz::monotonic_clock::now() < deadline;) {
+			server_socket_ = listen_socket_.accept(error);
+			if (!server_socket_)
+				fz::sleep(fz::duration::from_milliseconds(10));
+		}
+
+		CPPUNIT_ASSERT(server_socket_);
+
+		commander_ = std::make_unique<fz::ftp::commander>(loop_, controller_, tvfs_, hash_engine_, small_file_cache_, timer_wheel_, *notifier_,
+			1, last_activity_, false, fz::ftp::commander::welcome_message_t{}, std::string{}, fz::logger::null);
+
+		commander_->set_socket(server_socket_.get());
+
+		CPPUNIT_ASSERT_EQUAL(std::string("220"), client_.next_reply().substr(0, 3));
+	}
+
+	~harness()
+	{
+		commander_.reset();
+	}
+
+	held_backend &backend() { return *backend_; }
+	ftp_client &client() { return client_; }
+
+private:
+	fz::thread_pool pool_;
+	fz::event_loop loop_{pool_};
+
+	fz::listen_socket listen_socket_;
+	ftp_client client_;
+	std::unique_ptr<fz::socket> server_socket_;
+
+	std::shared_ptr<held_backend> backend_ = std::make_shared<held_backend>();
+	fz::tvfs::engine tvfs_;
+	fz::hash_engine hash_engine_;
+	fz::small_file_cache small_file_cache_;
+	fz::timer_wheel timer_wheel_;
+	std::unique_ptr<fz::tcp::session::notifier> notifier_;
+	always_authenticated controller_;
+	fz::monotonic_clock last_activity_ = fz::monotonic_clock::now();
+
+	std::unique_ptr<fz::ftp::commander> commander_;
+};
+
+}
+
+void commander_test::test_pipelined_commands()
+{
+	harness h;
+
+	h.client().send("SIZE a\r\nSIZE b\r\nSIZE c\r\n");
+
+	// All the entries get looked up at once...
+	CPPUNIT_ASSERT(h.backend().wait_for_infos(3));
+
+	// ...but the replies keep the order of the commands, whatever the order the lookups complete in.
+	h.backend().complete_info(2, 3);
+	h.backend().complete_info(1, 2);
+	CPPUNIT_ASSERT_EQUAL(std::string(), h.client().next_reply(settle_time));
+
+	h.backend().complete_info(0, 1);
+	CPPUNIT_ASSERT_EQUAL(std::string("213 1"), h.client().next_reply());
+	CPPUNIT_ASSERT_EQUAL(std::string("213 2"), h.client().next_reply());
+	CPPUNIT_ASSERT_EQUAL(std::string("213 3"), h.client().next_reply());
+}
+
+void commander_test::test_abor_of_pipelined_command()
+{
+	harness h;
+
+	h.client().send("SIZE a\r\nSIZE b\r\n");
+	CPPUNIT_ASSERT(h.backend().wait_for_infos(2));
+
+	h.backend().complete_info(0, 1);
+	CPPUNIT_ASSERT_EQUAL(std::string("213 1"), h.client().next_reply());
+
+	// Let SIZE b, the last command of the pipeline, become the current one: it's now waiting for its prefetched entry.
+	fz::sleep(settle_time);
+
+	h.client().send("ABOR\r\n");
+
+	// ABOR waits for the pending lookup, rather than replying right away.
+	CPPUNIT_ASSERT_EQUAL(std::string(), h.client().next_reply(settle_time));
+
+	h.backend().complete_info(1, 2);
+	CPPUNIT_ASSERT_EQUAL(std::string("426"), h.client().next_reply().substr(0, 3));
+	CPPUNIT_ASSERT_EQUAL(std::string("226"), h.client().next_reply().substr(0, 3));
+
+	// The aborted command never replies.
+	CPPUNIT_ASSERT_EQUAL(std::string(), h.client().next_reply(settle_time));
+}
@@ -0,0 +1,122 @@
+#include <libfilezilla/buffer.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/buffer_operator/detail/multi_file_frame.hpp"
+
+/*
+ * This testsuite asserts the correctness of the multi_file_frame header functions.
+ */
+
+class multi_file_frame_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(multi_file_frame_test);
+	CPPUNIT_TEST(test_round_trip);
+	CPPUNIT_TEST(test_failed_status);
+	CPPUNIT_TEST(test_partial_header);
+	CPPUNIT_TEST(test_malformed_header);
+	CPPUNIT_TEST(test_long_name);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_round_trip();
+	void test_failed_status();
+	void test_partial_header();
+	void test_malformed_header();
+	void test_long_name();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(multi_file_frame_test);
+
+namespace frame = fz::buffer_operator::detail::multi_file_frame;
+
+void multi_file_frame_test::test_round_trip()
+{
+	for (std::uint64_t data_size: { std::uint64_t(0), std::uint64_t(1), std::uint64_t(0x0102030405060708), ~std::uint64_t(0) }) {
+		fz::buffer b;
+		frame::add_header(b, frame::ok, "/dir/file.txt", data_size);
+
+		// Whatever follows the header is left alone.
+		b.append("data");
+
+		frame::status s = frame::failed;
+		std::string name;
+		std::uint64_t parsed_size = 0;
+		std::size_t header_size = 0;
+
+		CPPUNIT_ASSERT_EQUAL(0, frame::parse_header(b, s, name, parsed_size, header_size));
+		CPPUNIT_ASSERT_EQUAL(frame::ok, s);
+		CPPUNIT_ASSERT_EQUAL(std::string("/dir/file.txt"), name);
+		CPPUNIT_ASSERT(data_size == parsed_size);
+		CPPUNIT_ASSERT_EQUAL(b.size() - 4, header_size);
+	}
+}
+
+void multi_file_frame_test::test_failed_status()
+{
+	fz::buffer b;
+
+	// No data size goes with files that couldn't be opened, whatever the one given.
+	frame::add_header(b, frame::failed, "missing", 1234);
+
+	frame::status s = frame::ok;
+	std::string name;
+	std::uint64_t data_size = 1;
+	std::size_t header_size = 0;
+
+	CPPUNIT_ASSERT_EQUAL(0, frame::parse_header(b, s, name, data_size, header_size));
+	CPPUNIT_ASSERT_EQUAL(frame::failed, s);
+	CPPUNIT_ASSERT_EQUAL(std::string("missing"), name);
+	CPPUNIT_ASSERT(data_size == 0);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(3 + 7), header_size);
+	CPPUNIT_ASSERT_EQUAL(b.size(), header_size);
+}
+
+void multi_file_frame_test::test_partial_header()
+{
+	fz::buffer whole;
+	frame::add_header(whole, frame::ok, "name", 42);
+
+	for (std::size_t size = 0; size < whole.size(); ++size) {
+		fz::buffer b;
+		b.append(whole.get(), size);
+
+		frame::status s;
+		std::string name;
+		std::uint64_t data_size;
+		std::size_t header_size;
+
+		CPPUNIT_ASSERT_EQUAL(ENODATA, frame::parse_header(b, s, name, data_size, header_size));
+	}
+}
+
+void multi_file_frame_test::test_malformed_header()
+{
+	fz::buffer b;
+	frame::add_header(b, frame::ok, "name", 42);
+	b.get()[0] = 2;
+
+	frame::status s;
+	std::string name;
+	std::uint64_t data_size;
+	std::size_t header_size;
+
+	CPPUNIT_ASSERT_EQUAL(EINVAL, frame::parse_header(b, s, name, data_size, header_size));
+}
+
+void multi_file_frame_test::test_long_name()
+{
+	fz::buffer b;
+	frame::add_header(b, frame::ok, std::string(frame::max_name_size + 10, 'x'), 42);
+
+	frame::status s;
+	std::string name;
+	std::uint64_t data_size;
+	std::size_t header_size;
+
+	// Names are truncated to what fits in the header.
+	CPPUNIT_ASSERT_EQUAL(0, frame::parse_header(b, s, name, data_size, header_size));
+	CPPUNIT_ASSERT_EQUAL(std::string(frame::max_name_size, 'x'), name);
+	CPPUNIT_ASSERT(data_size == 42);
+	CPPUNIT_ASSERT_EQUAL(b.size(), header_size);
+}
@@ -0,0 +1,126 @@
+#include <libfilezilla/time.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/port_randomizer.hpp"
+
+/*
+ * This testsuite asserts the correctness of the port_randomizer and port_manager classes.
+ */
+
+class port_randomizer_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(port_randomizer_test);
+	CPPUNIT_TEST(test_lease_and_release);
+	CPPUNIT_TEST(test_reuse_order);
+	CPPUNIT_TEST(test_expiry);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_lease_and_release();
+	void test_reuse_order();
+	void test_expiry();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(port_randomizer_test);
+
+namespace {
+
+const int min_port = 50000;
+const int max_port = 50001;
+
+const std::string peer_a = "10.0.0.1";
+const std::string peer_b = "10.0.0.2";
+
+int other_port(int p)
+{
+	return p == min_port ? max_port : min_port;
+}
+
+}
+
+void port_randomizer_test::test_lease_and_release()
+{
+	fz::port_manager manager;
+	fz::port_randomizer a(manager, peer_a, min_port, max_port);
+
+	auto l1 = a.get_port();
+	CPPUNIT_ASSERT(l1.get_port() == min_port || l1.get_port() == max_port);
+
+	// Free ports come first.
+	auto l2 = a.get_port();
+	CPPUNIT_ASSERT_EQUAL(other_port(l1.get_port()), l2.get_port());
+
+	// Ports in the connecting stage are never leased again.
+	CPPUNIT_ASSERT_EQUAL(0, a.get_port().get_port());
+
+	// Once released, the port can be leased again, if only as last resort while its TIME_WAIT state lasts.
+	int p2 = l2.get_port();
+	l2 = fz::port_lease();
+	CPPUNIT_ASSERT_EQUAL(0, l2.get_port());
+
+	auto l3 = a.get_port();
+	CPPUNIT_ASSERT_EQUAL(p2, l3.get_port());
+
+	// Once connected, the port can be shared with further leases.
+	l1.set_connected();
+	auto l4 = a.get_port();
+	CPPUNIT_ASSERT_EQUAL(l1.get_port(), l4.get_port());
+
+	// Moving a lease transfers it.
+	auto l5 = std::move(l4);
+	CPPUNIT_ASSERT_EQUAL(l1.get_port(), l5.get_port());
+	CPPUNIT_ASSERT_EQUAL(0, l4.get_port());
+}
+
+void port_randomizer_test::test_reuse_order()
+{
+	// The randomizers start from a random port, so try it enough times for each of them to have been tried first.
+	for (int i = 0; i < 32; ++i) {
+		fz::port_manager manager;
+
+		int time_wait_port = [&] {
+			fz::port_randomizer a(manager, peer_a, min_port, max_port);
+			auto l = a.get_port();
+			l.set_connected();
+			return l.get_port();
+		}();
+
+		// The other peer gets the only free port.
+		fz::port_randomizer b(manager, peer_b, min_port, max_port);
+		auto lb = b.get_port();
+		CPPUNIT_ASSERT_EQUAL(other_port(time_wait_port), lb.get_port());
+		lb.set_connected();
+
+		// With no free ports left, a port in use by another peer is preferred to one of our own in TIME_WAIT.
+		fz::port_randomizer a(manager, peer_a, min_port, max_port);
+		CPPUNIT_ASSERT_EQUAL(lb.get_port(), a.get_port().get_port());
+	}
+}
+
+void port_randomizer_test::test_expiry()
+{
+	const auto time_wait = fz::duration::from_seconds(1);
+	const auto tick = fz::duration::from_seconds(1);
+
+	fz::port_manager manager(time_wait, tick);
+
+	int time_wait_port = [&] {
+		fz::port_randomizer a(manager, peer_a, min_port, max_port);
+		auto l = a.get_port();
+		l.set_connected();
+		return l.get_port();
+	}();
+
+	fz::port_randomizer b(manager, peer_b, min_port, max_port);
+	auto lb = b.get_port();
+	lb.set_connected();
+
+	// Until its TIME_WAIT state expires, the port doesn't count as free...
+	CPPUNIT_ASSERT_EQUAL(lb.get_port(), fz::port_randomizer(manager, peer_a, min_port, max_port).get_port().get_port());
+
+	// ...then it's given back, at most a tick later, give or take the rounding to whole seconds.
+	fz::sleep(time_wait + tick + tick);
+	CPPUNIT_ASSERT_EQUAL(time_wait_port, fz::port_randomizer(manager, peer_a, min_port, max_port).get_port().get_port());
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/mutex.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/timer_wheel.hpp"
+
+/*
+ * This testsuite asserts the correctness of the timer_wheel class.
+ */
+
+class timer_wheel_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(timer_wheel_test);
+	CPPUNIT_TEST(test_expiry);
+	CPPUNIT_TEST(test_timeouts_longer_than_a_revolution);
+	CPPUNIT_TEST(test_rearm_and_disarm_from_callback);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_expiry();
+	void test_timeouts_longer_than_a_revolution();
+	void test_rearm_and_disarm_from_callback();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(timer_wheel_test);
+
+namespace {
+
+const auto tick = fz::duration::from_milliseconds(20);
+
+// How late the loop's thread may get to run, on top of the one tick the wheel is allowed to be late by.
+const auto scheduling_allowance = fz::duration::from_milliseconds(200);
+
+class expiries
+{
+public:
+	void add(std::size_t i)
+	{
+		fz::scoped_lock lock(mutex_);
+		list_.emplace_back(i, fz::monotonic_clock::now());
+		condition_.signal(lock);
+	}
+
+	bool wait_for(std::size_t n, fz::duration timeout)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		auto deadline = fz::monotonic_clock::now() + timeout;
+
+		while (list_.size() < n) {
+			auto left = deadline - fz::monotonic_clock::now();
+			if (left <= fz::duration())
+				return false;
+
+			condition_.wait(lock, left);
+		}
+
+		return true;
+	}
+
+	std::vector<std::pair<std::size_t, fz::monotonic_clock>> get()
+	{
+		fz::scoped_lock lock(mutex_);
+		return list_;
+	}
+
+private:
+	fz::mutex mutex_;
+	fz::condition condition_;
+	std::vector<std::pair<std::size_t, fz::monotonic_clock>> list_;
+};
+
+void check_expiries(fz::timer_wheel &wheel, const std::vector<fz::duration> &timeouts)
+{
+	expiries ex;
+	std::vector<std::unique_ptr<fz::timer_wheel::entry>> entries;
+	std::vector<fz::monotonic_clock> armed_at;
+
+	for (std::size_t i = 0; i < timeouts.size(); ++i) {
+		entries.push_back(std::make_unique<fz::timer_wheel::entry>(wheel, [&ex, i]{ ex.add(i); }));
+		armed_at.push_back(fz::monotonic_clock::now());
+		wheel.arm(*entries.back(), timeouts[i]);
+	}
+
+	auto longest = *std::max_element(timeouts.begin(), timeouts.end());
+	CPPUNIT_ASSERT(ex.wait_for(timeouts.size(), longest + tick + scheduling_allowance));
+
+	for (auto &[i, expired_at]: ex.get()) {
+		auto elapsed = expired_at - armed_at[i];
+
+		// Never earlier than requested.
+		CPPUNIT_ASSERT(elapsed >= timeouts[i]);
+
+		// At most one tick later.
+		CPPUNIT_ASSERT(elapsed <= timeouts[i] + tick + scheduling_allowance);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(0), wheel.size());
+}
+
+}
+
+void timer_wheel_test::test_expiry()
+{
+	fz::event_loop loop;
+	fz::timer_wheel wheel(loop, tick, 16);
+
+	check_expiries(wheel, {
+		fz::duration::from_milliseconds(1),
+		fz::duration::from_milliseconds(19),
+		fz::duration::from_milliseconds(20),
+		fz::duration::from_milliseconds(21),
+		fz::duration::from_milliseconds(75),
+		fz::duration::from_milliseconds(150)
+	});
+}
+
+void timer_wheel_test::test_timeouts_longer_than_a_revolution()
+{
+	fz::event_loop loop;
+
+	// A revolution takes 4 ticks.
+	fz::timer_wheel wheel(loop, tick, 4);
+
+	check_expiries(wheel, {
+		fz::duration::from_milliseconds(80),
+		fz::duration::from_milliseconds(81),
+		fz::duration::from_milliseconds(170),
+		fz::duration::from_milliseconds(330)
+	});
+}
+
+void timer_wheel_test::test_rearm_and_disarm_from_callback()
+{
+	fz::event_loop loop;
+	fz::timer_wheel wheel(loop, tick, 4);
+
+	expiries ex;
+	std::size_t times_a = 0;
+
+	fz::timer_wheel::entry b(wheel, [&]{ ex.add(1); });
+
+	fz::timer_wheel::entry a(wheel, [&]{
+		ex.add(0);
+
+		// Disarming another entry from within a callback.
+		b.disarm();
+
+		// Re-arming the very entry that expired.
+		if (++times_a < 3)
+			wheel.arm(a, tick);
+	});
+
+	wheel.arm(b, fz::duration::from_milliseconds(200));
+	wheel.arm(a, tick);
+
+	CPPUNIT_ASSERT(ex.wait_for(3, fz::duration::from_milliseconds(200) + scheduling_allowance));
+
+	// Had b not been disarmed, it would have expired by now.
+	CPPUNIT_ASSERT(!ex.wait_for(4, fz::duration::from_milliseconds(200) + tick + scheduling_allowance));
+
+	for (auto &e: ex.get())
+		CPPUNIT_ASSERT_EQUAL(std::size_t(0), e.first);
+
+	CPPUNIT_ASSERT(!a.is_armed());
+	CPPUNIT_ASSERT(!b.is_armed());
+	CPPUNIT_ASSERT_EQUAL(std::size_t(0), wheel.size());
+}